@@ -5,7 +5,9 @@ import PackageDescription
 let package = Package(
     name: "TelloSwift",
     platforms: [
-        .iOS(.v13)
+        .iOS(.v13),
+        // Only to run the tests with `swift test`
+        .macOS(.v10_15)
     ],
     products: [
         .library(
@@ -18,5 +20,7 @@ let package = Package(
     targets: [
         .target(name: "TelloSwiftObjC", dependencies: [], path: "Sources/TelloSwiftObjC"),
         .target(name: "TelloSwift", dependencies: ["TelloSwiftObjC", .product(name: "Transform", package: "TransformSwift")]),
+        .target(name: "AllocationCounter", dependencies: [], path: "Tests/AllocationCounter"),
+        .testTarget(name: "TelloSwiftTests", dependencies: ["TelloSwift", "AllocationCounter"]),
     ]
 )
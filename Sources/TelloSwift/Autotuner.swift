@@ -0,0 +1,323 @@
+//
+//  Autotuner.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+import simd
+
+/// Relay-feedback autotuner of the position controller gains.
+///
+/// While the drone holds its pose, the autotuner replaces the correction of one axis with a relay:
+/// full positive excitation while the position error is above the hysteresis band and full negative
+/// below it. The drone then oscillates around the target with the ultimate period, and the amplitude
+/// gives the ultimate gain (Åström–Hägglund). The other axes keep holding the pose.
+///
+/// Periods and amplitudes of the latest cycles are kept in fixed-size windows, so the memory is bounded
+/// however long the oscillation takes to settle. The tuning aborts and the relay is removed
+/// when the drone leaves the air, the controller is reset (e.g. canceled, or the position sensor failed),
+/// or the oscillation grows beyond the allowed amplitude.
+///
+/// Tunings that end in the relay complete on the thread that updates the controller, which then returns
+/// to the pose held at the start on its next update.
+public final class Autotuner {
+    /// Axis to tune.
+    public enum Axis: Int {
+        case x
+        case y
+        case z
+        case yaw
+    }
+
+    /// Tuning rule converting the ultimate gain and period to PID gains.
+    public enum Rule {
+        /// Classic Ziegler–Nichols, aggressive.
+        case zieglerNichols
+        /// Tyreus–Luyben, less overshoot and more robust than Ziegler–Nichols.
+        case tyreusLuyben
+        /// Ziegler–Nichols variant without overshoot.
+        case noOvershoot
+    }
+
+    /// Reasons the tuning did not finish.
+    public enum Failure: Error {
+        /// The drone is not in the air.
+        case notFlying
+        /// The current pose is not fully known.
+        case noPose
+        /// The tuning or the controller target was canceled.
+        case canceled
+        /// The position sensor failed.
+        case sensorFailure
+        /// The drone stopped flying.
+        case flightStateChanged
+        /// The oscillation exceeded `maxAmplitude`.
+        case amplitudeExceeded
+        /// The oscillation did not settle in time.
+        case timeout
+    }
+
+    /// Relay and tuning parameters. Distances are in meters for x, y, z and in radians for yaw.
+    public struct Configuration {
+        /// Relay output, in control units.
+        public var relayAmplitude: Double = 0.3
+        /// Half-width of the relay hysteresis band, rejects measurement noise.
+        public var hysteresis: Double = 0.02
+        /// Largest error before aborting.
+        public var maxAmplitude: Double = 0.5
+        /// Number of consistent cycles required. The first cycle is a transient and is skipped.
+        public var cycles: Int = 4
+        /// Largest relative standard deviation of the periods and amplitudes of consistent cycles.
+        public var tolerance: Double = 0.1
+        /// Longest tuning, in seconds.
+        public var timeout: CFTimeInterval = 60.0
+        /// Tuning rule.
+        public var rule: Rule = .tyreusLuyben
+        /// Suggest integral gains. The position loop is integrating, so it does not need them to reach the target.
+        public var integralAction: Bool = false
+
+        public init() {}
+    }
+
+    /// Tuning result.
+    public struct Tuning {
+        public var axis: Axis
+        /// Ultimate gain, control units per meter or radian.
+        public var ultimateGain: Double
+        /// Ultimate period, s.
+        public var ultimatePeriod: Double
+        /// Suggested controller, with deadband and window size of the current one.
+        public var pid: Pid
+    }
+
+    private let controller: PositionController
+    private let flightState: Status<FlightState>
+
+    private let lock = NSLock()
+    private var promise: ((Result<Tuning, Failure>) -> Void)?
+    private var subs: Set<AnyCancellable> = []
+    private var hold = QuadrotorPose()
+
+    // Relay state, accessed on the controller thread under `lock`
+    private var axis: Axis = .x
+    private var current: Pid?
+    private var configuration = Configuration()
+    private var startTime: CFTimeInterval?
+    private var relayHigh = true
+    private var lastRise: CFTimeInterval?
+    private var cycle = 0
+    private var minError = Double.infinity
+    private var maxError = -Double.infinity
+    private var periods = WindowedStatistics<Double>(size: 1)
+    private var amplitudes = WindowedStatistics<Double>(size: 1)
+
+    /// `true` while tuning.
+    public var isTuning: Bool {
+        lock.lock()
+        defer { lock.unlock() }
+        return promise != nil
+    }
+
+    public init(controller: PositionController, flightState: Status<FlightState>) {
+        self.controller = controller
+        self.flightState = flightState
+    }
+
+    /// Tunes an axis while holding the current pose.
+    ///
+    /// Cancels the tuning in progress, if any.
+    ///
+    /// - Parameters:
+    ///   - axis: axis to tune.
+    ///   - current: current controller of the axis, its deadband and window size are kept.
+    ///   - configuration: relay and tuning parameters.
+    /// - Returns: Future with the result, or the reason the tuning was aborted.
+    public func tune(_ axis: Axis, current: Pid, configuration: Configuration = Configuration()) -> Future<Tuning, Failure> {
+        cancel()
+
+        return Future { promise in
+            guard self.flightState.value == .hovering || self.flightState.value == .flying else {
+                promise(.failure(.notFlying))
+                return
+            }
+            guard let pose = self.controller.input.value, pose.x != nil, pose.y != nil, pose.z != nil, pose.yaw != nil else {
+                promise(.failure(.noPose))
+                return
+            }
+
+            self.lock.lock()
+            self.promise = promise
+            self.hold = pose
+            self.axis = axis
+            self.current = current
+            self.configuration = configuration
+            self.startTime = nil
+            self.relayHigh = true
+            self.lastRise = nil
+            self.cycle = 0
+            self.minError = .infinity
+            self.maxError = -.infinity
+            self.periods = WindowedStatistics(size: Swift.max(configuration.cycles, 2))
+            self.amplitudes = WindowedStatistics(size: Swift.max(configuration.cycles, 2))
+            self.lock.unlock()
+
+            // Hold the pose before observing the state, only resets by others abort the tuning
+            self.controller.setTarget(target: pose)
+
+            var subs: Set<AnyCancellable> = []
+            self.controller.state.observation { [weak self] state in
+                if case .reset(let reason) = state {
+                    self?.finish(.failure(reason == .sensorFailure ? .sensorFailure : .canceled), holdPose: .no)
+                }
+            }.store(in: &subs)
+
+            self.flightState.observation { [weak self] state in
+                if state != .hovering && state != .flying {
+                    self?.finish(.failure(.flightStateChanged), holdPose: .no)
+                }
+            }.store(in: &subs)
+
+            self.lock.lock()
+            self.subs = subs
+            self.lock.unlock()
+
+            self.controller.controlOverride = { [weak self] setPoint, measured, time in
+                return self?.relay(setPoint: setPoint, measured: measured, at: time) ?? (.init(repeating: false), .zero)
+            }
+        }
+    }
+
+    /// Aborts the tuning in progress and returns to the pose held at the start.
+    public func cancel() {
+        finish(.failure(.canceled), holdPose: .now)
+    }
+
+    /// Relay output. Called by the controller on every update.
+    private func relay(setPoint: simd_double4, measured: simd_double4, at time: CFTimeInterval) -> (lanes: Pid4Mask, corrections: simd_double4) {
+        lock.lock()
+
+        guard promise != nil else {
+            lock.unlock()
+            return (.init(repeating: false), .zero)
+        }
+
+        let lane = axis.rawValue
+        let error = setPoint[lane] - measured[lane]
+        let start = startTime ?? time
+        startTime = start
+
+        if abs(error) > configuration.maxAmplitude || time - start > configuration.timeout {
+            let failure: Failure = abs(error) > configuration.maxAmplitude ? .amplitudeExceeded : .timeout
+            lock.unlock()
+            finish(.failure(failure), holdPose: .onNextUpdate)
+            return (.init(repeating: false), .zero)
+        }
+
+        minError = Swift.min(minError, error)
+        maxError = Swift.max(maxError, error)
+
+        var result: Tuning?
+        if relayHigh && error < -configuration.hysteresis {
+            relayHigh = false
+        } else if !relayHigh && error > configuration.hysteresis {
+            relayHigh = true
+            result = cycleCompleted(at: time)
+        }
+
+        var lanes = Pid4Mask(repeating: false)
+        lanes[lane] = true
+        let output = relayHigh ? configuration.relayAmplitude : -configuration.relayAmplitude
+
+        lock.unlock()
+
+        if let result = result {
+            finish(.success(result), holdPose: .onNextUpdate)
+            return (.init(repeating: false), .zero)
+        }
+
+        return (lanes, simd_double4(repeating: output))
+    }
+
+    /// Adds a full relay cycle, ending with a rising switch. Returns the result once the cycles are consistent.
+    private func cycleCompleted(at time: CFTimeInterval) -> Tuning? {
+        defer {
+            lastRise = time
+            minError = .infinity
+            maxError = -.infinity
+        }
+
+        guard let rise = lastRise else { return nil }
+
+        cycle += 1
+        // The first cycle starts from rest
+        guard cycle > 1 else { return nil }
+
+        periods.add(time - rise)
+        amplitudes.add((maxError - minError) / 2.0)
+
+        guard periods.isFull,
+              periods.standardDeviation <= configuration.tolerance * periods.mean,
+              amplitudes.standardDeviation <= configuration.tolerance * amplitudes.mean,
+              let current = current else { return nil }
+
+        // Describing function of a relay with hysteresis
+        let a = amplitudes.mean
+        let h = configuration.relayAmplitude
+        let eps = configuration.hysteresis
+        let ku = 4.0 * h / (.pi * (a > eps ? (a * a - eps * eps).squareRoot() : a))
+        let pu = periods.mean
+
+        let kp, ti, td: Double
+        switch configuration.rule {
+        case .zieglerNichols:
+            (kp, ti, td) = (0.6 * ku, pu / 2.0, pu / 8.0)
+        case .tyreusLuyben:
+            (kp, ti, td) = (ku / 2.2, 2.2 * pu, pu / 6.3)
+        case .noOvershoot:
+            (kp, ti, td) = (0.2 * ku, pu / 2.0, pu / 3.0)
+        }
+
+        guard let pid = Pid(p: kp, i: configuration.integralAction ? kp / ti : 0.0, d: kp * td,
+                            deadband: current.deadband, windowSize: current.windowSize) else { return nil }
+
+        return Tuning(axis: axis, ultimateGain: ku, ultimatePeriod: pu, pid: pid)
+    }
+
+    /// When to return to the pose held at the start.
+    private enum HoldPose {
+        case no
+        case now
+        /// From the relay: the target must not change in the middle of the controller update.
+        case onNextUpdate
+    }
+
+    private func finish(_ result: Result<Tuning, Failure>, holdPose: HoldPose) {
+        lock.lock()
+        guard let promise = promise else {
+            lock.unlock()
+            return
+        }
+        self.promise = nil
+        let pose = hold
+        let subs = self.subs
+        self.subs = []
+        lock.unlock()
+
+        controller.controlOverride = nil
+        subs.forEach { $0.cancel() }
+
+        // Back to where the tuning started
+        switch holdPose {
+        case .no:
+            break
+        case .now:
+            controller.setTarget(target: pose)
+        case .onNextUpdate:
+            controller.setTargetOnNextUpdate(pose)
+        }
+
+        promise(result)
+    }
+}
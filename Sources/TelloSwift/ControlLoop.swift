@@ -0,0 +1,156 @@
+//
+//  ControlLoop.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+
+/// Runs a position controller at a fixed rate, independent of the sensor callbacks.
+///
+/// On every tick the loop reads the latest pose snapshot, updates the controller once
+/// and calls `output` in the same tick, with `nil` controls if the controller has nothing to do.
+/// The loop can be driven by its own background timer (`start()`), or stepped manually (`step()`)
+/// with an injected clock, e.g. in simulation.
+public final class ControlLoop {
+    /// Loop timing statistics over the latest `window` ticks, in seconds.
+    public struct Timing {
+        /// Number of ticks in the statistics.
+        public var window: Int
+        /// Mean period between ticks.
+        public var period: CFTimeInterval
+        /// Standard deviation of the period.
+        public var jitter: CFTimeInterval
+        /// Largest deviation of the period from the mean, keeps the sign.
+        public var maxPeriodDeviation: CFTimeInterval
+        /// Mean time from the pose measurement to the output of the controls.
+        public var latency: CFTimeInterval
+        /// Largest time from the pose measurement to the output of the controls.
+        public var maxLatency: CFTimeInterval
+    }
+
+    /// Allowed loop rates, in Hz.
+    public static let rateLimits: ClosedRange<Double> = 20.0...100.0
+
+    /// Loop rate, in Hz.
+    public let rate: Double
+
+    private let clock: () -> CFTimeInterval
+    private let pose: (CFTimeInterval) -> EstimatedState?
+    private let controller: PositionController
+    private let output: (QuadrotorControls?, CFTimeInterval) -> Void
+
+    private let lock = NSLock()
+    private var timer: BackgroundTimer?
+    private var lastTick: CFTimeInterval?
+    private var periods: WindowedStatistics<CFTimeInterval>
+    private var latencies: WindowedStatistics<CFTimeInterval>
+
+    /// Creates a control loop.
+    ///
+    /// - Parameters:
+    ///   - rate: loop rate in Hz, clamped to `rateLimits`.
+    ///   - statisticsWindow: number of ticks to compute timing statistics over.
+    ///   - clock: time source. Defaults to `CACurrentMediaTime()`.
+    ///   - controller: controller to update.
+    ///   - pose: returns the pose to act on at the given time, or `nil` if there is none yet.
+    ///   - output: receives the controls (`nil` if there is no pose or no target) and the time of the tick.
+    public init(rate: Double,
+                statisticsWindow: Int = 100,
+                clock: @escaping () -> CFTimeInterval = CACurrentMediaTime,
+                controller: PositionController,
+                pose: @escaping (CFTimeInterval) -> EstimatedState?,
+                output: @escaping (QuadrotorControls?, CFTimeInterval) -> Void) {
+        self.rate = rate.clamped(to: ControlLoop.rateLimits)
+        self.clock = clock
+        self.controller = controller
+        self.pose = pose
+        self.output = output
+        self.periods = WindowedStatistics(size: statisticsWindow)
+        self.latencies = WindowedStatistics(size: statisticsWindow)
+    }
+
+    deinit {
+        timer?.cancel()
+    }
+
+    /// Starts ticking on a background queue.
+    public func start() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard timer == nil else { return }
+        lastTick = nil
+        timer = BackgroundTimer(repeat: 1.0 / rate) { [weak self] _ in
+            self?.step()
+        }
+    }
+
+    /// Stops ticking.
+    public func stop() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        timer?.cancel()
+        timer = nil
+    }
+
+    /// Runs one tick: reads the pose, updates the controller and outputs the controls.
+    ///
+    /// Called by the timer when the loop is started. Call it directly to step the loop manually.
+    public func step() {
+        let now = clock()
+
+        lock.lock()
+        if let last = lastTick {
+            periods.add(now - last)
+        }
+        lastTick = now
+        lock.unlock()
+
+        guard let state = pose(now),
+              let controls = controller.update(position: state, orientation: state, at: now) else {
+            output(nil, now)
+            return
+        }
+
+        output(controls, now)
+
+        // Measurement to output, including the time spent in this tick
+        let latency = clock() - state.timestamp
+
+        lock.lock()
+        latencies.add(latency)
+        lock.unlock()
+    }
+
+    /// Timing statistics, or `nil` if the loop did not run yet.
+    public var timing: Timing? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let maxPeriod = periods.max, let minPeriod = periods.min else { return nil }
+
+        let mean = periods.mean
+        let maxDev = maxPeriod - mean
+        let minDev = minPeriod - mean
+
+        return Timing(window: periods.count,
+                      period: mean,
+                      jitter: periods.standardDeviation,
+                      maxPeriodDeviation: abs(maxDev) >= abs(minDev) ? maxDev : minDev,
+                      latency: latencies.isEmpty ? 0.0 : latencies.mean,
+                      maxLatency: latencies.max ?? 0.0)
+    }
+
+    /// Clears timing statistics.
+    public func resetTiming() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        lastTick = nil
+        periods.reset()
+        latencies.reset()
+    }
+}
@@ -0,0 +1,126 @@
+//
+//  FlightRecorder.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+import QuartzCore.CoreAnimation
+
+/// Time-stamped sticks commands and sensor data of a flight, for offline analysis.
+///
+/// See `FlightRecorder` to record one and `SystemIdentification` to analyze it.
+/// Recordings are `Codable`, e.g. to save them as JSON and analyze them later.
+public struct FlightRecording: Codable {
+    /// Value with the time it was received or sent at.
+    public struct Sample<T> {
+        /// `CACurrentMediaTime()` time base, in seconds.
+        public var time: CFTimeInterval
+        public var value: T
+
+        public init(time: CFTimeInterval, value: T) {
+            self.time = time
+            self.value = value
+        }
+    }
+
+    /// Sticks commands sent to the drone.
+    public var sticks: [Sample<QuadrotorControls>] = []
+    public var imu: [Sample<Imu>] = []
+    public var mvo: [Sample<Mvo>] = []
+    public var vo: [Sample<Vo>] = []
+
+    public init() {}
+
+    /// `true` if nothing was recorded.
+    public var isEmpty: Bool {
+        return sticks.isEmpty && imu.isEmpty && mvo.isEmpty && vo.isEmpty
+    }
+}
+
+extension FlightRecording.Sample: Codable where T: Codable {}
+
+/// Records sticks commands, IMU, MVO and VO of a `Tello` into a `FlightRecording`.
+///
+/// Samples are time-stamped on the thread they are produced on, before they hop to the main queue.
+public final class FlightRecorder {
+    /// Longest recording, in seconds. Later samples are dropped.
+    public let maxDuration: CFTimeInterval
+
+    /// `true` while recording.
+    public var isRecording: Bool {
+        lock.lock()
+        defer { lock.unlock() }
+        return startTime != nil
+    }
+
+    private let fixedClock: (() -> CFTimeInterval)?
+    private var clock: () -> CFTimeInterval = CACurrentMediaTime
+    private let lock = NSLock()
+    private var recording = FlightRecording()
+    private var startTime: CFTimeInterval?
+    private var subs: Set<AnyCancellable> = []
+
+    /// Creates a recorder.
+    ///
+    /// - Parameters:
+    ///   - maxDuration: longest recording, in seconds.
+    ///   - clock: time source. Defaults to the `clock` of the recorded drone, so simulated flights are
+    ///     recorded in simulated time.
+    public init(maxDuration: CFTimeInterval = 600.0, clock: (() -> CFTimeInterval)? = nil) {
+        self.maxDuration = maxDuration
+        self.fixedClock = clock
+    }
+
+    /// Starts recording the drone. Discards any previous recording.
+    public func start(_ tello: Tello) {
+        lock.lock()
+        recording = FlightRecording()
+        clock = fixedClock ?? tello.clock
+        startTime = clock()
+        lock.unlock()
+
+        subs = []
+        tello.sticks.observation { [weak self] in
+            self?.record(\.sticks, $0)
+        }.store(in: &subs)
+        tello.imu.observation { [weak self] in
+            self?.record(\.imu, $0)
+        }.store(in: &subs)
+        tello.mvo.observation { [weak self] in
+            self?.record(\.mvo, $0)
+        }.store(in: &subs)
+        tello.vo.observation { [weak self] in
+            self?.record(\.vo, $0)
+        }.store(in: &subs)
+    }
+
+    /// Stops recording.
+    ///
+    /// - Returns: The recording.
+    @discardableResult
+    public func stop() -> FlightRecording {
+        subs = []
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        startTime = nil
+        return recording
+    }
+
+    private func record<T>(_ path: WritableKeyPath<FlightRecording, [FlightRecording.Sample<T>]>, _ value: T) {
+        lock.lock()
+        let clock = self.clock
+        lock.unlock()
+
+        let now = clock()
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard let start = startTime, now - start <= maxDuration else { return }
+        recording[keyPath: path].append(.init(time: now, value: value))
+    }
+}
@@ -0,0 +1,313 @@
+//
+//  GainOptimizer.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import simd
+
+/// Searches the position controller gains on simulated step responses.
+///
+/// Each axis is tuned on its own: after takeoff the drone is commanded to the full takeoff pose
+/// with only that axis offset by a step, so the other axes hold their takeoff values with the
+/// `Tello` controller gains. A gain vector is scored over `runs` randomized simulations
+/// of `MonteCarloHarness`, with the same seeds for every vector, by its mean settle (convergence) time
+/// and mean overshoot.
+///
+/// The search is a coarse-to-fine grid: a full grid over the search space, then, for every refinement,
+/// a local grid with half the spacing around each Pareto-optimal vector found so far. All the runs of
+/// a grid level are spread over all cores at once. Scores are cached per gain vector, so repeated and
+/// overlapping searches only simulate the new vectors.
+public final class GainOptimizer {
+    /// Ranges of the gains. A degenerate range keeps the gain fixed.
+    public struct SearchSpace {
+        public var p: ClosedRange<Double>
+        public var i: ClosedRange<Double>
+        public var d: ClosedRange<Double>
+
+        public init(p: ClosedRange<Double>, i: ClosedRange<Double> = 0.0...0.0, d: ClosedRange<Double>) {
+            self.p = p
+            self.i = i
+            self.d = d
+        }
+    }
+
+    /// Optimizer parameters.
+    public struct Configuration {
+        public var x = SearchSpace(p: 0.2...3.0, d: 0.0...1.5)
+        public var y = SearchSpace(p: 0.2...3.0, d: 0.0...1.5)
+        public var z = SearchSpace(p: 0.5...4.0, d: 0.0...0.5)
+        public var yaw = SearchSpace(p: 0.2...3.0, d: 0.0...1.0)
+        /// Step of the x and y axes, m.
+        public var positionStep: Double = 1.0
+        /// Step of the z axis, m.
+        public var altitudeStep: Double = 0.5
+        /// Step of the yaw, rad.
+        public var yawStep: Double = deg2rad(90.0)
+        /// Points per gain of the coarse grid.
+        public var gridPoints: Int = 7
+        /// Number of local refinements after the coarse grid.
+        public var refinements: Int = 2
+        /// Simulated runs per gain vector.
+        public var runs: Int = 8
+        /// Largest fraction of failed runs of a Pareto-optimal vector.
+        public var maxFailureRate: Double = 0.0
+        /// Simulation and randomization of the runs. `runs`, `pids` and `prepare` are set by the optimizer.
+        public var harness = MonteCarloHarness.Configuration()
+
+        public init() {}
+    }
+
+    /// Score of a gain vector.
+    public struct Candidate {
+        public var p: Double
+        public var i: Double
+        public var d: Double
+        /// Mean time to converge, s. Infinite if all runs failed.
+        public var settleTime: Double
+        /// Mean overshoot, m or rad. Infinite if all runs failed.
+        public var overshoot: Double
+        /// Fraction of failed runs.
+        public var failureRate: Double
+    }
+
+    /// Search result of an axis.
+    public struct AxisResult {
+        public var axis: Autotuner.Axis
+        /// All scored vectors.
+        public var candidates: [Candidate]
+        /// Vectors no other vector beats in both settle time and overshoot, by increasing settle time.
+        public var paretoFront: [Candidate]
+    }
+
+    private struct Key: Hashable {
+        var axis: Int
+        var gains: SIMD3<Int64>
+    }
+
+    public let configuration: Configuration
+
+    private let lock = NSLock()
+    private var cache: [Key: Candidate] = [:]
+    private var runsSimulated = 0
+
+    /// Number of runs simulated so far, cached vectors are not simulated again.
+    var simulatedRuns: Int {
+        lock.lock()
+        defer { lock.unlock() }
+        return runsSimulated
+    }
+
+    public init(configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+    }
+
+    /// Searches the gains of the axes. Blocks until done, call it from a background queue.
+    public func optimize(_ axes: [Autotuner.Axis] = [.x, .y, .z, .yaw]) -> [AxisResult] {
+        return axes.map(search)
+    }
+
+    /// Converts the Pareto fronts to `Pid.dictionary()` maps, keyed by axis: `x`, `y`, `z`, and `yaw`.
+    ///
+    /// Deadbands and window sizes are copied from `current`, if given.
+    public func paretoPids(_ results: [AxisResult], current: (x: Pid, y: Pid, z: Pid, yaw: Pid)? = nil) -> [String: [Dictionary<String, Any>]] {
+        var res: [String: [Dictionary<String, Any>]] = [:]
+
+        for result in results {
+            let pid = current.map { [$0.x, $0.y, $0.z, $0.yaw][result.axis.rawValue] }
+            res[GainOptimizer.name(of: result.axis)] = result.paretoFront.compactMap {
+                Pid(p: $0.p, i: $0.i, d: $0.d,
+                    deadband: pid?.deadband ?? 0.001,
+                    windowSize: pid?.windowSize ?? 5)?.dictionary()
+            }
+        }
+
+        return res
+    }
+
+    private func search(_ axis: Autotuner.Axis) -> AxisResult {
+        let space = [configuration.x, configuration.y, configuration.z, configuration.yaw][axis.rawValue]
+        let ranges = [space.p, space.i, space.d]
+        let points = Swift.max(configuration.gridPoints, 2)
+
+        // Coarse grid
+        var spacing = ranges.map { ($0.upperBound - $0.lowerBound) / Double(points - 1) }
+        var grid: [simd_double3] = [.zero]
+        for (dim, range) in ranges.enumerated() {
+            let values = spacing[dim] > 0.0 ? (0..<points).map { range.lowerBound + Double($0) * spacing[dim] } : [range.lowerBound]
+            grid = grid.flatMap { base in
+                values.map { value -> simd_double3 in
+                    var v = base
+                    v[dim] = value
+                    return v
+                }
+            }
+        }
+
+        var scored = evaluate(grid, axis: axis)
+
+        for _ in 0..<Swift.max(configuration.refinements, 0) {
+            spacing = spacing.map { $0 / 2.0 }
+
+            // Local grid around every Pareto-optimal vector
+            var local: [simd_double3] = []
+            for center in GainOptimizer.paretoFront(scored, maxFailureRate: configuration.maxFailureRate) {
+                var neighbors: [simd_double3] = [simd_double3(center.p, center.i, center.d)]
+                for dim in 0..<3 where spacing[dim] > 0.0 {
+                    neighbors = neighbors.flatMap { base in
+                        [-1.0, 0.0, 1.0].map { offset -> simd_double3 in
+                            var v = base
+                            v[dim] = (v[dim] + offset * spacing[dim]).clamped(to: ranges[dim])
+                            return v
+                        }
+                    }
+                }
+                local += neighbors
+            }
+
+            scored += evaluate(local, axis: axis).filter { candidate in
+                !scored.contains { $0.p == candidate.p && $0.i == candidate.i && $0.d == candidate.d }
+            }
+        }
+
+        return AxisResult(axis: axis,
+                          candidates: scored,
+                          paretoFront: GainOptimizer.paretoFront(scored, maxFailureRate: configuration.maxFailureRate))
+    }
+
+    /// Scores the gain vectors, simulating only those not in the cache. Duplicates are scored once.
+    private func evaluate(_ gains: [simd_double3], axis: Autotuner.Axis) -> [Candidate] {
+        // Quantized, so vectors reached by different grid paths share the cache entry
+        let keys = gains.map { Key(axis: axis.rawValue, gains: SIMD3<Int64>(($0 * 1e9).rounded(.toNearestOrEven))) }
+
+        var unique: [Key: simd_double3] = [:]
+        for (key, g) in zip(keys, gains) {
+            unique[key] = g
+        }
+
+        lock.lock()
+        let missing = unique.filter { cache[$0.key] == nil }.map { (key: $0.key, gains: $0.value) }
+        lock.unlock()
+
+        let runs = Swift.max(configuration.runs, 1)
+        let mission = self.mission(axis)
+        let harnesses = missing.map { harness(gains: $0.gains, axis: axis) }
+
+        // All runs of all vectors at once, so the cores stay busy until the last batch
+        var results = [MonteCarloHarness.Run](repeating: MonteCarloHarness.Run(index: 0), count: missing.count * runs)
+        results.withUnsafeMutableBufferPointer { buffer in
+            DispatchQueue.concurrentPerform(iterations: buffer.count) { job in
+                buffer[job] = harnesses[job / runs].simulate(mission, index: job % runs)
+            }
+        }
+
+        lock.lock()
+        runsSimulated += results.count
+        for (n, entry) in missing.enumerated() {
+            cache[entry.key] = score(entry.gains, runs: results[(n * runs)..<((n + 1) * runs)], axis: axis)
+        }
+        var res: [Candidate] = []
+        var seen = Set<Key>()
+        for key in keys where seen.insert(key).inserted {
+            if let candidate = cache[key] {
+                res.append(candidate)
+            }
+        }
+        lock.unlock()
+
+        return res
+    }
+
+    /// Harness flying the axis with the gain vector, all other axes keep the `Tello` gains.
+    private func harness(gains: simd_double3, axis: Autotuner.Axis) -> MonteCarloHarness {
+        var config = configuration.harness
+        config.runs = configuration.runs
+        config.pids = nil
+
+        let (p, i, d) = (gains.x, gains.y, gains.z)
+        config.prepare = { tello in
+            let current = tello.getControllerPids()
+            let pid = [current.x, current.y, current.z, current.yaw][axis.rawValue]
+            guard let candidate = Pid(p: p, i: i, d: d, deadband: pid.deadband, windowSize: pid.windowSize) else { return }
+
+            switch axis {
+            case .x:
+                tello.setControllerPids(x: candidate, y: nil, z: nil, yaw: nil)
+            case .y:
+                tello.setControllerPids(x: nil, y: candidate, z: nil, yaw: nil)
+            case .z:
+                tello.setControllerPids(x: nil, y: nil, z: candidate, yaw: nil)
+            case .yaw:
+                tello.setControllerPids(x: nil, y: nil, z: nil, yaw: candidate)
+            }
+        }
+
+        return MonteCarloHarness(configuration: config)
+    }
+
+    /// Takeoff, then the takeoff pose with a step of the axis.
+    ///
+    /// All four axes are targeted, so the untuned ones are held against drift and prop-wash
+    /// instead of being left uncontrolled.
+    private func mission(_ axis: Autotuner.Axis) -> [MonteCarloHarness.Step] {
+        let c = configuration
+        let start = c.harness.simulator.initialPosition
+        let altitude = c.harness.simulator.dynamics.takeoffAltitude
+        let yaw = c.harness.simulator.initialYaw
+
+        var target = QuadrotorPose(x: start.x, y: start.y, z: altitude, yaw: yaw)
+        switch axis {
+        case .x:
+            target.x = start.x + c.positionStep
+        case .y:
+            target.y = start.y + c.positionStep
+        case .z:
+            target.z = altitude + c.altitudeStep
+        case .yaw:
+            target.yaw = remainder(yaw + c.yawStep, 2.0 * .pi)
+        }
+
+        return [.takeoff, .goTo(target)]
+    }
+
+    private func score(_ gains: simd_double3, runs: ArraySlice<MonteCarloHarness.Run>, axis: Autotuner.Axis) -> Candidate {
+        var settle = 0.0, overshoot = 0.0, succeeded = 0
+        for run in runs where run.failure == nil {
+            guard let time = run.convergenceTimes.first,
+                  let over = axis == .yaw ? run.yawOvershoots.first : run.overshoots.first else { continue }
+            settle += time
+            overshoot += over
+            succeeded += 1
+        }
+
+        let n = Double(succeeded)
+        return Candidate(p: gains.x, i: gains.y, d: gains.z,
+                         settleTime: succeeded > 0 ? settle / n : .infinity,
+                         overshoot: succeeded > 0 ? overshoot / n : .infinity,
+                         failureRate: 1.0 - n / Double(runs.count))
+    }
+
+    /// Non-dominated feasible candidates, by increasing settle time.
+    static func paretoFront(_ candidates: [Candidate], maxFailureRate: Double) -> [Candidate] {
+        let feasible = candidates
+            .filter { $0.failureRate <= maxFailureRate && $0.settleTime.isFinite }
+            .sorted { ($0.settleTime, $0.overshoot) < ($1.settleTime, $1.overshoot) }
+
+        // Sorted by settle time, so a candidate is optimal if it overshoots less than all faster ones
+        var front: [Candidate] = []
+        for candidate in feasible where candidate.overshoot < (front.last?.overshoot ?? .infinity) {
+            front.append(candidate)
+        }
+        return front
+    }
+
+    private static func name(of axis: Autotuner.Axis) -> String {
+        switch axis {
+        case .x: return "x"
+        case .y: return "y"
+        case .z: return "z"
+        case .yaw: return "yaw"
+        }
+    }
+}
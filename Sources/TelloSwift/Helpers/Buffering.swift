@@ -0,0 +1,170 @@
+//
+//  Buffering.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+
+/// Describes how many undelivered elements to keep and which ones to drop when there are too many.
+public struct BufferingPolicy: Equatable {
+    /// What to drop when the buffer is full.
+    public enum Overflow: Equatable {
+        /// Drop the oldest buffered element to make room for the new one.
+        case dropOldest
+        /// Drop the new element.
+        case dropNewest
+    }
+
+    /// Maximum number of undelivered elements. At least one.
+    public let capacity: Int
+    /// What to drop when the buffer is full.
+    public let overflow: Overflow
+
+    public init(capacity: Int, overflow: Overflow) {
+        precondition(capacity > 0, "Buffer capacity must be positive")
+        self.capacity = capacity
+        self.overflow = overflow
+    }
+
+    /// Keeps up to `capacity` newest elements.
+    public static func dropOldest(capacity: Int) -> BufferingPolicy {
+        return .init(capacity: capacity, overflow: .dropOldest)
+    }
+
+    /// Keeps up to `capacity` oldest elements.
+    public static func dropNewest(capacity: Int) -> BufferingPolicy {
+        return .init(capacity: capacity, overflow: .dropNewest)
+    }
+
+    /// Keeps only the latest element.
+    public static let latest: BufferingPolicy = .dropOldest(capacity: 1)
+}
+
+/// Thread-safe counter of dropped elements.
+public final class DropCounter {
+    private let lock = NSLock()
+    private var _count: Int = 0
+
+    public init() {}
+
+    /// Number of dropped elements so far.
+    public var count: Int {
+        lock.lock(); defer { lock.unlock() }
+        return _count
+    }
+
+    internal func increment() {
+        lock.lock(); defer { lock.unlock() }
+        _count += 1
+    }
+}
+
+/// Delivers elements downstream only when there is demand, buffering the rest according to a policy.
+///
+/// The elements are delivered outside of the internal lock, so the downstream may call back
+/// into the subscription (e.g. to request more) from `receive(_:)`.
+///
+/// With pending demand and nothing buffered, an element is delivered directly. Only the elements
+/// that have to wait are passed through `detach`, so elements that borrow the storage of the
+/// publisher (e.g. ring buffer windows) copy it only when they outlive the call.
+internal final class DemandBuffer<Output> {
+    private let lock = NSLock()
+    private let pending: PowerOfTwoRingBuffer<Output>
+    private var demand = Subscribers.Demand.none
+    private var isDraining = false
+    private let policy: BufferingPolicy
+    private let drops: DropCounter
+    private let detach: ((Output) -> Output)?
+    private let send: (Output) -> Subscribers.Demand
+
+    init(policy: BufferingPolicy, drops: DropCounter, detach: ((Output) -> Output)? = nil, send: @escaping (Output) -> Subscribers.Demand) {
+        self.pending = PowerOfTwoRingBuffer(minimumCapacity: policy.capacity)
+        self.policy = policy
+        self.drops = drops
+        self.detach = detach
+        self.send = send
+    }
+
+    /// Delivers a new element if demanded, otherwise buffers it.
+    func offer(_ value: Output) {
+        lock.lock()
+        if !isDraining, demand > 0, pending.isEmpty {
+            demand -= 1
+            isDraining = true
+            lock.unlock()
+
+            let newDemand = send(value)
+
+            lock.lock()
+            demand += newDemand
+            isDraining = false
+            // The downstream may have offered more from `receive(_:)`
+            let hasPending = !pending.isEmpty
+            lock.unlock()
+
+            if hasPending {
+                drain()
+            }
+            return
+        }
+
+        // The storage may be larger than the policy allows
+        if pending.count == policy.capacity {
+            drops.increment()
+
+            switch policy.overflow {
+            case .dropOldest:
+                _ = pending.read()
+            case .dropNewest:
+                lock.unlock()
+                return
+            }
+        }
+        pending.append(detach?(value) ?? value)
+        lock.unlock()
+
+        drain()
+    }
+
+    /// Adds downstream demand and delivers buffered elements.
+    func request(_ demand: Subscribers.Demand) {
+        lock.lock()
+        self.demand += demand
+        lock.unlock()
+
+        drain()
+    }
+
+    /// Drops all buffered elements and demand.
+    func reset() {
+        lock.lock()
+        while pending.read() != nil {}
+        demand = .none
+        lock.unlock()
+    }
+
+    private func drain() {
+        lock.lock()
+        // Somebody up the stack is already delivering
+        guard !isDraining else {
+            lock.unlock()
+            return
+        }
+        isDraining = true
+
+        while demand > 0, let value = pending.read() {
+            demand -= 1
+            lock.unlock()
+
+            let newDemand = send(value)
+
+            lock.lock()
+            demand += newDemand
+        }
+
+        isDraining = false
+        lock.unlock()
+    }
+}
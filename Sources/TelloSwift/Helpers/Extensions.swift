@@ -51,11 +51,22 @@ extension Strideable where Stride: SignedInteger {
 
 // MARK: Combine Publishers
 
+extension Publisher {
+    /// Pairs each element with the previous one.
+    ///
+    /// - Parameters:
+    ///   - initial: previous value for the first element. Defaults to `nil`.
+    public func withPrevious(_ initial: Output? = nil) -> Publishers.Map<Publishers.Scan<Self, (Output?, Output?)>, (previous: Output?, current: Output)> {
+        return scan((initial, nil)) { ($0.1 ?? $0.0, $1) }
+            .map { (previous: $0.0, current: $0.1!) }
+    }
+}
+
 // Inspired by OpenCombine Publishers.Buffer implementation: https://github.com/broadwaylamb/OpenCombine
 
 extension Publisher where Output: BinaryFloatingPoint {
-    public func movingAverageByCount(count: Int, strategy: Publishers.MovingAverageStrategy) -> Publishers.MovingAverageByCount<Self> {
-        return .init(upstream: self, count: count, strategy: strategy)
+    public func movingAverageByCount(count: Int, strategy: Publishers.MovingAverageStrategy, buffering: BufferingPolicy = .latest) -> Publishers.MovingAverageByCount<Self> {
+        return .init(upstream: self, count: count, strategy: strategy, buffering: buffering)
     }
 }
 
@@ -81,11 +92,17 @@ extension Publishers {
         public let upstream: Upstream
         public let count: Int
         public let strategy: MovingAverageStrategy
+        /// Averages buffering policy for slow subscribers
+        public let buffering: BufferingPolicy
+        /// Number of averages dropped because the subscribers had no demand
+        public let drops: DropCounter
 
-        public init(upstream: Upstream, count: Int, strategy: MovingAverageStrategy) {
+        public init(upstream: Upstream, count: Int, strategy: MovingAverageStrategy, buffering: BufferingPolicy = .latest) {
             self.upstream = upstream
             self.count = count
             self.strategy = strategy
+            self.buffering = buffering
+            self.drops = DropCounter()
         }
 
         public func receive<Downstream: Subscriber>(subscriber: Downstream) where Self.Failure == Downstream.Failure, Self.Output == Downstream.Input {
@@ -99,119 +116,96 @@ extension Publishers.MovingAverageByCount {
         typealias Input = Upstream.Output
         typealias Failure = Upstream.Failure
 
-        private enum State {
-            case ready(Publishers.MovingAverageByCount<Upstream>, Downstream)
-            case subscribed(Publishers.MovingAverageByCount<Upstream>, Downstream, Subscription)
-            case terminal
-        }
+        private let lock = NSLock()
+        private var downstream: Downstream?
+        private var subscription: Subscription?
+        private let strategy: Publishers.MovingAverageStrategy
 
-        private var state: State
+        private var statistics: WindowedStatistics<Double>
+        private var outputs: DemandBuffer<Output>!
 
-        private var downstreamDemand = Subscribers.Demand.none
-
-        private var terminal: Subscribers.Completion<Failure>?
+        init(downstream: Downstream, slidingAverage: Publishers.MovingAverageByCount<Upstream>) {
+            self.downstream = downstream
+            self.strategy = slidingAverage.strategy
+            self.statistics = .init(size: slidingAverage.count)
+            self.outputs = DemandBuffer(policy: slidingAverage.buffering, drops: slidingAverage.drops) { [weak self] in
+                self?.deliver($0) ?? .none
+            }
+        }
 
-        private var ringBuf: RingBuffer<Input>
+        private func deliver(_ output: Output) -> Subscribers.Demand {
+            lock.lock()
+            let downstream = self.downstream
+            lock.unlock()
 
-        init(downstream: Downstream, slidingAverage: Publishers.MovingAverageByCount<Upstream>) {
-            self.ringBuf = .init(count: slidingAverage.count)
-            state = .ready(slidingAverage, downstream)
+            return downstream?.receive(output) ?? .none
         }
 
         func receive(subscription: Subscription) {
-            guard case let .ready(slidingAverage, downstream) = state else {
+            lock.lock()
+            guard let downstream = downstream, self.subscription == nil else {
+                lock.unlock()
                 subscription.cancel()
                 return
             }
+            self.subscription = subscription
+            lock.unlock()
 
-            state = .subscribed(slidingAverage, downstream, subscription)
-
-            subscription.request(.max(ringBuf.size))
             downstream.receive(subscription: self)
+            // Every element updates the window, the averages are throttled by the demand buffer
+            subscription.request(.unlimited)
         }
 
         func receive(_ input: Input) -> Subscribers.Demand {
-            guard case .subscribed = state else {
+            lock.lock()
+            guard downstream != nil else {
+                lock.unlock()
                 return .none
             }
 
-            // Check if upstream finished
-            switch terminal {
-            case nil, .finished?:
-                // The drain() guarantees there is at least one space in the buffer
-                ringBuf.write(input)
-                // Calculate an average, send it downstream, and free up space for a new item
-                return drain()
-            case .failure?:
-                return .none
+            // The window drops the oldest element by itself
+            statistics.add(Double(input))
+
+            // Running average of the current window, O(1)
+            let value: Double? = (strategy == .everyTime || statistics.isFull) ? statistics.mean : nil
+            lock.unlock()
+
+            if let value = value {
+                outputs.offer(value)
             }
+
+            return .none
         }
 
         // Upstream has finished
         func receive(completion: Subscribers.Completion<Upstream.Failure>) {
-            guard case .subscribed = state, terminal == nil else {
+            lock.lock()
+            guard let downstream = downstream else {
+                lock.unlock()
                 return
             }
+            self.downstream = nil
+            self.subscription = nil
+            lock.unlock()
 
-            terminal = completion
+            downstream.receive(completion: completion)
         }
 
         // Downstream demands
         func request(_ demand: Subscribers.Demand) {
-            guard case let .subscribed(_, _, subscription) = state else {
-                return
-            }
-            downstreamDemand += demand
-            subscription.request(downstreamDemand)
+            outputs.request(demand)
         }
 
         func cancel() {
-            guard case let .subscribed(_, _, subscription) = state else {
-                return
-            }
-
-            state = .terminal
-            ringBuf = RingBuffer<Input>(count: ringBuf.size)
-            subscription.cancel()
-        }
-
-        private func drain() -> Subscribers.Demand {
-            var upstreamDemand = Subscribers.Demand.none
-
-            guard case let .subscribed(slidingAverage, downstream, _) = state else {
-                return upstreamDemand
-            }
-
-            // Did upstream complete?
-            if let completion = terminal {
-                state = .terminal
-                downstream.receive(completion: completion)
-            }
-
-            // Calculate average of current buffer
-            let value: Double = ringBuf.average()
-            var newDownstreamDemand = Subscribers.Demand.none
-
-            // Are we full?
-            if ringBuf.availableSpaceForWriting == 0 {
-                // Drop first
-                _ = ringBuf.read()
-                if slidingAverage.strategy == .whenFull {
-                    // Send the value downstream
-                    newDownstreamDemand += downstream.receive(value)
-                }
-            }
-
-            if slidingAverage.strategy == .everyTime {
-                newDownstreamDemand = downstream.receive(value)
-            }
-
-            downstreamDemand -= 1
-            downstreamDemand += newDownstreamDemand
-
-            upstreamDemand = Subscribers.Demand.max(ringBuf.availableSpaceForWriting)
-
-            return upstreamDemand
+            lock.lock()
+            let subscription = self.subscription
+            downstream = nil
+            self.subscription = nil
+            statistics.reset()
+            lock.unlock()
+
+            outputs.reset()
+            subscription?.cancel()
         }
     }
 }
@@ -0,0 +1,270 @@
+//
+//  PowerOfTwoRingBuffer.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import TelloSwiftObjC
+
+/// Rounds `value` up to the nearest power of two.
+fileprivate func nextPowerOfTwo(_ value: Int) -> Int {
+    precondition(value > 0, "Ring buffer capacity must be positive")
+    return value <= 1 ? 1 : 1 << (Int.bitWidth - (value - 1).leadingZeroBitCount)
+}
+
+/// Fixed-length ring buffer with power-of-two capacity.
+///
+/// The read and write indices always increment and are mapped to the storage
+/// with a bit mask instead of a modulo. Elements are stored contiguously, so the
+/// contents can be accessed as (at most) two contiguous slices.
+///
+/// Not thread-safe. Use `SPSCRingBuffer` to pass elements between threads.
+public final class PowerOfTwoRingBuffer<T> {
+    /// Maximum number of elements, always a power of two.
+    public let capacity: Int
+
+    private let mask: Int
+    private let storage: UnsafeMutablePointer<T>
+    private var readIndex = 0
+    private var writeIndex = 0
+
+    /// Creates a ring buffer that holds at least `minimumCapacity` elements.
+    public init(minimumCapacity: Int) {
+        capacity = nextPowerOfTwo(minimumCapacity)
+        mask = capacity - 1
+        storage = UnsafeMutablePointer<T>.allocate(capacity: capacity)
+    }
+
+    deinit {
+        removeAll()
+        storage.deallocate()
+    }
+
+    public var count: Int {
+        return writeIndex - readIndex
+    }
+
+    public var isEmpty: Bool {
+        return count == 0
+    }
+
+    public var isFull: Bool {
+        return count == capacity
+    }
+
+    public var availableSpaceForWriting: Int {
+        return capacity - count
+    }
+
+    /// Element at `offset` from the oldest one.
+    public subscript(offset: Int) -> T {
+        precondition(offset >= 0 && offset < count, "Ring buffer offset out of range")
+        return storage[(readIndex + offset) & mask]
+    }
+
+    /// Appends an element. When full, the oldest element is dropped.
+    public func append(_ element: T) {
+        if isFull {
+            (storage + (readIndex & mask)).deinitialize(count: 1)
+            readIndex += 1
+        }
+        (storage + (writeIndex & mask)).initialize(to: element)
+        writeIndex += 1
+    }
+
+    /// Writes as many elements as fit into the free space.
+    ///
+    /// - Returns: Number of written elements.
+    @discardableResult
+    public func write<C>(contentsOf elements: C) -> Int where C: Collection, C.Element == T {
+        let n = Swift.min(elements.count, availableSpaceForWriting)
+        guard n > 0 else { return 0 }
+
+        let copied: Void? = elements.withContiguousStorageIfAvailable { src in
+            let start = writeIndex & mask
+            let first = Swift.min(n, capacity - start)
+            (storage + start).initialize(from: src.baseAddress!, count: first)
+            if n > first {
+                storage.initialize(from: src.baseAddress! + first, count: n - first)
+            }
+        }
+
+        if copied == nil {
+            var index = writeIndex
+            for element in elements.prefix(n) {
+                (storage + (index & mask)).initialize(to: element)
+                index += 1
+            }
+        }
+
+        writeIndex += n
+        return n
+    }
+
+    /// Removes and returns the oldest element, or `nil` if the buffer is empty.
+    public func read() -> T? {
+        guard !isEmpty else { return nil }
+        defer { readIndex += 1 }
+        return (storage + (readIndex & mask)).move()
+    }
+
+    /// Moves up to `buffer.count` oldest elements into `buffer`.
+    ///
+    /// The memory of `buffer` must be uninitialized, or hold trivial values.
+    ///
+    /// - Returns: Number of moved elements.
+    @discardableResult
+    public func read(into buffer: UnsafeMutableBufferPointer<T>) -> Int {
+        let n = Swift.min(buffer.count, count)
+        guard n > 0, let dst = buffer.baseAddress else { return 0 }
+
+        let start = readIndex & mask
+        let first = Swift.min(n, capacity - start)
+        dst.moveInitialize(from: storage + start, count: first)
+        if n > first {
+            (dst + first).moveInitialize(from: storage, count: n - first)
+        }
+
+        readIndex += n
+        return n
+    }
+
+    /// Drops all elements.
+    public func removeAll() {
+        while !isEmpty {
+            (storage + (readIndex & mask)).deinitialize(count: 1)
+            readIndex += 1
+        }
+        readIndex = 0
+        writeIndex = 0
+    }
+
+    /// Calls `body` with the contents split in two contiguous slices, oldest elements first.
+    ///
+    /// The second slice is empty unless the contents wrap around the end of the storage.
+    public func withContiguousSlices<R>(_ body: (UnsafeBufferPointer<T>, UnsafeBufferPointer<T>) throws -> R) rethrows -> R {
+        let start = readIndex & mask
+        let first = Swift.min(count, capacity - start)
+
+        return try body(UnsafeBufferPointer(start: storage + start, count: first),
+                        UnsafeBufferPointer(start: storage, count: count - first))
+    }
+}
+
+/// Lock-free single-producer/single-consumer ring buffer with power-of-two capacity.
+///
+/// One thread may write and another one may read concurrently without locks,
+/// e.g. the network thread producing measurements and a consumer queue draining them.
+/// Calling the producer (or consumer) methods from more than one thread at a time is not supported.
+public final class SPSCRingBuffer<T> {
+    /// Maximum number of elements, always a power of two.
+    public let capacity: Int
+
+    private let mask: Int
+    private let storage: UnsafeMutablePointer<T>
+
+    // Indices live on separate cache lines: [0] is written by the consumer, [cacheLine] by the producer
+    private static var cacheLine: Int { 8 }
+    private let indices: UnsafeMutablePointer<Int64>
+    private var readIndexPtr: UnsafeMutablePointer<Int64> { indices }
+    private var writeIndexPtr: UnsafeMutablePointer<Int64> { indices + SPSCRingBuffer.cacheLine }
+
+    /// Creates a ring buffer that holds at least `minimumCapacity` elements.
+    public init(minimumCapacity: Int) {
+        capacity = nextPowerOfTwo(minimumCapacity)
+        mask = capacity - 1
+        storage = UnsafeMutablePointer<T>.allocate(capacity: capacity)
+        indices = UnsafeMutablePointer<Int64>.allocate(capacity: 2 * SPSCRingBuffer.cacheLine)
+        indices.initialize(repeating: 0, count: 2 * SPSCRingBuffer.cacheLine)
+    }
+
+    deinit {
+        while pop() != nil {}
+        storage.deallocate()
+        indices.deallocate()
+    }
+
+    /// Number of elements. Only a snapshot when the other side is active.
+    public var count: Int {
+        let w = tello_atomic_load_acquire(writeIndexPtr)
+        let r = tello_atomic_load_acquire(readIndexPtr)
+        return Int(w - r)
+    }
+
+    public var isEmpty: Bool {
+        return count == 0
+    }
+
+    // MARK: Producer
+
+    /// Appends an element.
+    ///
+    /// - Returns: `false` if the buffer is full and the element was not written.
+    @discardableResult
+    public func push(_ element: T) -> Bool {
+        let w = tello_atomic_load_relaxed(writeIndexPtr)
+        let r = tello_atomic_load_acquire(readIndexPtr)
+        guard Int(w - r) < capacity else { return false }
+
+        (storage + (Int(w) & mask)).initialize(to: element)
+        tello_atomic_store_release(writeIndexPtr, w + 1)
+        return true
+    }
+
+    /// Writes as many elements as fit into the free space.
+    ///
+    /// - Returns: Number of written elements.
+    @discardableResult
+    public func write<C>(contentsOf elements: C) -> Int where C: Collection, C.Element == T {
+        let w = tello_atomic_load_relaxed(writeIndexPtr)
+        let r = tello_atomic_load_acquire(readIndexPtr)
+        let n = Swift.min(elements.count, capacity - Int(w - r))
+        guard n > 0 else { return 0 }
+
+        var index = Int(w)
+        for element in elements.prefix(n) {
+            (storage + (index & mask)).initialize(to: element)
+            index += 1
+        }
+
+        tello_atomic_store_release(writeIndexPtr, w + Int64(n))
+        return n
+    }
+
+    // MARK: Consumer
+
+    /// Removes and returns the oldest element, or `nil` if the buffer is empty.
+    public func pop() -> T? {
+        let r = tello_atomic_load_relaxed(readIndexPtr)
+        let w = tello_atomic_load_acquire(writeIndexPtr)
+        guard r != w else { return nil }
+
+        let element = (storage + (Int(r) & mask)).move()
+        tello_atomic_store_release(readIndexPtr, r + 1)
+        return element
+    }
+
+    /// Moves up to `buffer.count` oldest elements into `buffer`.
+    ///
+    /// The memory of `buffer` must be uninitialized, or hold trivial values.
+    ///
+    /// - Returns: Number of moved elements.
+    @discardableResult
+    public func read(into buffer: UnsafeMutableBufferPointer<T>) -> Int {
+        let r = tello_atomic_load_relaxed(readIndexPtr)
+        let w = tello_atomic_load_acquire(writeIndexPtr)
+        let n = Swift.min(buffer.count, Int(w - r))
+        guard n > 0, let dst = buffer.baseAddress else { return 0 }
+
+        let start = Int(r) & mask
+        let first = Swift.min(n, capacity - start)
+        dst.moveInitialize(from: storage + start, count: first)
+        if n > first {
+            (dst + first).moveInitialize(from: storage, count: n - first)
+        }
+
+        tello_atomic_store_release(readIndexPtr, r + Int64(n))
+        return n
+    }
+}
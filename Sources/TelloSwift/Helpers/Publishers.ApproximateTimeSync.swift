@@ -0,0 +1,731 @@
+//
+//  Publishers.ApproximateTimeSync.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+import QuartzCore.CoreAnimation
+
+public extension Publisher {
+    /// Matches elements of this publisher with elements of another publisher by their arrival time.
+    ///
+    /// Unlike `combineLatest`, a pair is only emitted when both elements arrived within `slop` seconds
+    /// from each other. Elements that can not be matched anymore are dropped and counted in `statistics`.
+    ///
+    /// The arrival time is the time an element reaches the operator. When the upstreams deliver on a queue,
+    /// e.g. `Sensor` subscribers on the main queue, use `approximateTimeSync(with:slop:queueSize:time:_:)`
+    /// with the time the elements were produced.
+    ///
+    /// - Parameters:
+    ///   - other: Another publisher.
+    ///   - slop: Maximum difference between arrival times of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    func approximateTimeSync<B>(with other: B, slop: TimeInterval, queueSize: Int = 10) -> Publishers.ApproximateTimeSync<Self, B>
+        where B: Publisher, B.Failure == Failure
+    {
+        return .init(self, other, slop: slop, queueSize: queueSize)
+    }
+
+    /// Matches elements of this publisher with elements of another publisher by their own time stamps.
+    ///
+    /// Each element of one input is matched with the element of the other input closest to it in time.
+    ///
+    /// - Parameters:
+    ///   - other: Another publisher.
+    ///   - slop: Maximum difference between time stamps of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    ///   - time: Time stamp of an element of this publisher, non-decreasing.
+    ///   - otherTime: Time stamp of an element of the other publisher, non-decreasing.
+    func approximateTimeSync<B>(with other: B, slop: TimeInterval, queueSize: Int = 10,
+                                time: @escaping (Output) -> CFTimeInterval,
+                                _ otherTime: @escaping (B.Output) -> CFTimeInterval) -> Publishers.ApproximateTimeSync<Self, B>
+        where B: Publisher, B.Failure == Failure
+    {
+        return .init(self, other, slop: slop, queueSize: queueSize, time: time, otherTime)
+    }
+
+    /// Matches elements of this publisher with elements of two other publishers by their arrival time.
+    ///
+    /// - Parameters:
+    ///   - b: Second publisher.
+    ///   - c: Third publisher.
+    ///   - slop: Maximum difference between arrival times of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    func approximateTimeSync<B, C>(with b: B, _ c: C, slop: TimeInterval, queueSize: Int = 10) -> Publishers.ApproximateTimeSync3<Self, B, C>
+        where B: Publisher, C: Publisher, B.Failure == Failure, C.Failure == Failure
+    {
+        return .init(self, b, c, slop: slop, queueSize: queueSize)
+    }
+
+    /// Matches elements of this publisher with elements of two other publishers by their own time stamps.
+    ///
+    /// - Parameters:
+    ///   - b: Second publisher.
+    ///   - c: Third publisher.
+    ///   - slop: Maximum difference between time stamps of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    ///   - time: Time stamp of an element of this publisher, non-decreasing.
+    ///   - bTime: Time stamp of an element of the second publisher, non-decreasing.
+    ///   - cTime: Time stamp of an element of the third publisher, non-decreasing.
+    func approximateTimeSync<B, C>(with b: B, _ c: C, slop: TimeInterval, queueSize: Int = 10,
+                                   time: @escaping (Output) -> CFTimeInterval,
+                                   _ bTime: @escaping (B.Output) -> CFTimeInterval,
+                                   _ cTime: @escaping (C.Output) -> CFTimeInterval) -> Publishers.ApproximateTimeSync3<Self, B, C>
+        where B: Publisher, C: Publisher, B.Failure == Failure, C.Failure == Failure
+    {
+        return .init(self, b, c, slop: slop, queueSize: queueSize, time: time, bTime, cTime)
+    }
+
+    /// Matches elements of this publisher with elements of three other publishers by their arrival time.
+    ///
+    /// - Parameters:
+    ///   - b: Second publisher.
+    ///   - c: Third publisher.
+    ///   - d: Fourth publisher.
+    ///   - slop: Maximum difference between arrival times of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    func approximateTimeSync<B, C, D>(with b: B, _ c: C, _ d: D, slop: TimeInterval, queueSize: Int = 10) -> Publishers.ApproximateTimeSync4<Self, B, C, D>
+        where B: Publisher, C: Publisher, D: Publisher, B.Failure == Failure, C.Failure == Failure, D.Failure == Failure
+    {
+        return .init(self, b, c, d, slop: slop, queueSize: queueSize)
+    }
+
+    /// Matches elements of this publisher with elements of three other publishers by their own time stamps.
+    ///
+    /// - Parameters:
+    ///   - b: Second publisher.
+    ///   - c: Third publisher.
+    ///   - d: Fourth publisher.
+    ///   - slop: Maximum difference between time stamps of the matched elements, in seconds.
+    ///   - queueSize: Maximum number of unmatched elements to keep per input. When full, the oldest element is dropped.
+    ///   - time: Time stamp of an element of this publisher, non-decreasing.
+    ///   - bTime: Time stamp of an element of the second publisher, non-decreasing.
+    ///   - cTime: Time stamp of an element of the third publisher, non-decreasing.
+    ///   - dTime: Time stamp of an element of the fourth publisher, non-decreasing.
+    func approximateTimeSync<B, C, D>(with b: B, _ c: C, _ d: D, slop: TimeInterval, queueSize: Int = 10,
+                                      time: @escaping (Output) -> CFTimeInterval,
+                                      _ bTime: @escaping (B.Output) -> CFTimeInterval,
+                                      _ cTime: @escaping (C.Output) -> CFTimeInterval,
+                                      _ dTime: @escaping (D.Output) -> CFTimeInterval) -> Publishers.ApproximateTimeSync4<Self, B, C, D>
+        where B: Publisher, C: Publisher, D: Publisher, B.Failure == Failure, C.Failure == Failure, D.Failure == Failure
+    {
+        return .init(self, b, c, d, slop: slop, queueSize: queueSize, time: time, bTime, cTime, dTime)
+    }
+}
+
+public extension Publishers {
+    /// Counters of an approximate-time synchronizer.
+    ///
+    /// The counters are shared by all subscriptions to the same publisher.
+    final class ApproximateTimeSyncStatistics {
+        private let lock = NSLock()
+        private var _matched: Int = 0
+        private var _dropped: [Int]
+
+        internal init(inputs: Int) {
+            _dropped = [Int](repeating: 0, count: inputs)
+        }
+
+        /// Number of emitted matched sets.
+        public var matched: Int {
+            lock.lock(); defer { lock.unlock() }
+            return _matched
+        }
+
+        /// Number of dropped elements per input.
+        public var dropped: [Int] {
+            lock.lock(); defer { lock.unlock() }
+            return _dropped
+        }
+
+        fileprivate func didMatch() {
+            lock.lock(); defer { lock.unlock() }
+            _matched += 1
+        }
+
+        fileprivate func didDrop(input: Int, count: Int = 1) {
+            lock.lock(); defer { lock.unlock() }
+            _dropped[input] += count
+        }
+    }
+
+    /// A publisher that matches elements of two upstream publishers by their time stamps, or arrival time.
+    struct ApproximateTimeSync<A, B>: Publisher where A: Publisher, B: Publisher, A.Failure == B.Failure {
+        public typealias Output = (A.Output, B.Output)
+        public typealias Failure = A.Failure
+
+        public let a: A
+        public let b: B
+
+        /// Maximum difference between time stamps of the matched elements, in seconds.
+        public let slop: TimeInterval
+        /// Maximum number of unmatched elements to keep per input.
+        public let queueSize: Int
+        /// Matched and dropped element counters.
+        public let statistics: ApproximateTimeSyncStatistics
+
+        // Time stamps of the elements, arrival time if `nil`
+        private let times: (((A.Output) -> CFTimeInterval)?, ((B.Output) -> CFTimeInterval)?)
+
+        public init(_ a: A, _ b: B, slop: TimeInterval, queueSize: Int,
+                    time: ((A.Output) -> CFTimeInterval)? = nil, _ bTime: ((B.Output) -> CFTimeInterval)? = nil) {
+            self.a = a
+            self.b = b
+            self.slop = slop
+            self.queueSize = queueSize
+            self.statistics = .init(inputs: 2)
+            self.times = (time, bTime)
+        }
+
+        public func receive<Downstream: Subscriber>(subscriber: Downstream)
+            where Downstream.Input == Output, Downstream.Failure == Failure
+        {
+            let inner = ApproximateTimeSyncInner(downstream: subscriber,
+                                                 queues: TimedQueues2<A.Output, B.Output>(capacity: queueSize),
+                                                 slop: slop, statistics: statistics)
+
+            subscriber.receive(subscription: inner)
+            inner.subscribe(a, index: 0, time: times.0) { $0.a.append($1, at: $2) }
+            inner.subscribe(b, index: 1, time: times.1) { $0.b.append($1, at: $2) }
+        }
+    }
+
+    /// A publisher that matches elements of three upstream publishers by their time stamps, or arrival time.
+    struct ApproximateTimeSync3<A, B, C>: Publisher
+        where A: Publisher, B: Publisher, C: Publisher, A.Failure == B.Failure, A.Failure == C.Failure
+    {
+        public typealias Output = (A.Output, B.Output, C.Output)
+        public typealias Failure = A.Failure
+
+        public let a: A
+        public let b: B
+        public let c: C
+
+        /// Maximum difference between time stamps of the matched elements, in seconds.
+        public let slop: TimeInterval
+        /// Maximum number of unmatched elements to keep per input.
+        public let queueSize: Int
+        /// Matched and dropped element counters.
+        public let statistics: ApproximateTimeSyncStatistics
+
+        // Time stamps of the elements, arrival time if `nil`
+        private let times: (((A.Output) -> CFTimeInterval)?, ((B.Output) -> CFTimeInterval)?, ((C.Output) -> CFTimeInterval)?)
+
+        public init(_ a: A, _ b: B, _ c: C, slop: TimeInterval, queueSize: Int,
+                    time: ((A.Output) -> CFTimeInterval)? = nil, _ bTime: ((B.Output) -> CFTimeInterval)? = nil,
+                    _ cTime: ((C.Output) -> CFTimeInterval)? = nil) {
+            self.a = a
+            self.b = b
+            self.c = c
+            self.slop = slop
+            self.queueSize = queueSize
+            self.statistics = .init(inputs: 3)
+            self.times = (time, bTime, cTime)
+        }
+
+        public func receive<Downstream: Subscriber>(subscriber: Downstream)
+            where Downstream.Input == Output, Downstream.Failure == Failure
+        {
+            let inner = ApproximateTimeSyncInner(downstream: subscriber,
+                                                 queues: TimedQueues3<A.Output, B.Output, C.Output>(capacity: queueSize),
+                                                 slop: slop, statistics: statistics)
+
+            subscriber.receive(subscription: inner)
+            inner.subscribe(a, index: 0, time: times.0) { $0.a.append($1, at: $2) }
+            inner.subscribe(b, index: 1, time: times.1) { $0.b.append($1, at: $2) }
+            inner.subscribe(c, index: 2, time: times.2) { $0.c.append($1, at: $2) }
+        }
+    }
+
+    /// A publisher that matches elements of four upstream publishers by their time stamps, or arrival time.
+    struct ApproximateTimeSync4<A, B, C, D>: Publisher
+        where A: Publisher, B: Publisher, C: Publisher, D: Publisher,
+              A.Failure == B.Failure, A.Failure == C.Failure, A.Failure == D.Failure
+    {
+        public typealias Output = (A.Output, B.Output, C.Output, D.Output)
+        public typealias Failure = A.Failure
+
+        public let a: A
+        public let b: B
+        public let c: C
+        public let d: D
+
+        /// Maximum difference between time stamps of the matched elements, in seconds.
+        public let slop: TimeInterval
+        /// Maximum number of unmatched elements to keep per input.
+        public let queueSize: Int
+        /// Matched and dropped element counters.
+        public let statistics: ApproximateTimeSyncStatistics
+
+        // Time stamps of the elements, arrival time if `nil`
+        private let times: (((A.Output) -> CFTimeInterval)?, ((B.Output) -> CFTimeInterval)?,
+                            ((C.Output) -> CFTimeInterval)?, ((D.Output) -> CFTimeInterval)?)
+
+        public init(_ a: A, _ b: B, _ c: C, _ d: D, slop: TimeInterval, queueSize: Int,
+                    time: ((A.Output) -> CFTimeInterval)? = nil, _ bTime: ((B.Output) -> CFTimeInterval)? = nil,
+                    _ cTime: ((C.Output) -> CFTimeInterval)? = nil, _ dTime: ((D.Output) -> CFTimeInterval)? = nil) {
+            self.a = a
+            self.b = b
+            self.c = c
+            self.d = d
+            self.slop = slop
+            self.queueSize = queueSize
+            self.statistics = .init(inputs: 4)
+            self.times = (time, bTime, cTime, dTime)
+        }
+
+        public func receive<Downstream: Subscriber>(subscriber: Downstream)
+            where Downstream.Input == Output, Downstream.Failure == Failure
+        {
+            let inner = ApproximateTimeSyncInner(downstream: subscriber,
+                                                 queues: TimedQueues4<A.Output, B.Output, C.Output, D.Output>(capacity: queueSize),
+                                                 slop: slop, statistics: statistics)
+
+            subscriber.receive(subscription: inner)
+            inner.subscribe(a, index: 0, time: times.0) { $0.a.append($1, at: $2) }
+            inner.subscribe(b, index: 1, time: times.1) { $0.b.append($1, at: $2) }
+            inner.subscribe(c, index: 2, time: times.2) { $0.c.append($1, at: $2) }
+            inner.subscribe(d, index: 3, time: times.3) { $0.d.append($1, at: $2) }
+        }
+    }
+}
+
+// MARK: Synchronizer
+
+/// Fixed-capacity FIFO of time-stamped values that never reallocates.
+private struct TimedQueue<T> {
+    private var values: [T?]
+    private var times: [CFTimeInterval]
+    private var head = 0
+    private(set) var count = 0
+
+    init(capacity: Int) {
+        precondition(capacity >= 1, "Queue size must be positive")
+        values = [T?](repeating: nil, count: capacity)
+        times = [CFTimeInterval](repeating: 0.0, count: capacity)
+    }
+
+    var isFull: Bool { count == times.count }
+
+    func time(at offset: Int) -> CFTimeInterval {
+        return times[(head + offset) % times.count]
+    }
+
+    mutating func append(_ value: T, at time: CFTimeInterval) {
+        precondition(!isFull)
+        let slot = (head + count) % times.count
+        values[slot] = value
+        times[slot] = time
+        count += 1
+    }
+
+    @discardableResult
+    mutating func removeFirst() -> T {
+        precondition(count > 0)
+        let value = values[head]!
+        values[head] = nil
+        head = (head + 1) % times.count
+        count -= 1
+        return value
+    }
+
+    mutating func removeAll() {
+        while count > 0 {
+            removeFirst()
+        }
+    }
+}
+
+/// Typed queues of the inputs of a synchronizer, one per input.
+private protocol TimedQueues {
+    associatedtype Output
+
+    /// Number of inputs.
+    var inputs: Int { get }
+
+    func count(_ input: Int) -> Int
+    func isFull(_ input: Int) -> Bool
+    func time(_ input: Int, at offset: Int) -> CFTimeInterval
+    mutating func removeFirst(_ input: Int)
+    mutating func removeAll()
+    /// Removes the first element of every input and returns them ordered by input.
+    mutating func popFirst() -> Output
+}
+
+extension TimedQueues {
+    /// Matches the latest first element with the closest element of every other input.
+    ///
+    /// Each element enters and leaves its queue exactly once, so the matching costs O(1) amortized per element.
+    ///
+    /// - Returns: Matched elements ordered by input, or `nil` if there is no match yet.
+    mutating func match(slop: TimeInterval, statistics: Publishers.ApproximateTimeSyncStatistics) -> Output? {
+        while (0..<inputs).allSatisfy({ count($0) > 0 }) {
+            // The latest first element is the pivot: time stamps are non-decreasing,
+            // so nothing earlier can become the pivot anymore
+            var pivot = -CFTimeInterval.infinity
+            for i in 0..<inputs {
+                pivot = max(pivot, time(i, at: 0))
+            }
+
+            var second = SIMDMask<SIMD4<Int>.MaskStorage>(repeating: false)
+            var earliest = (time: CFTimeInterval.infinity, input: 0)
+            var latest = -CFTimeInterval.infinity
+            var waiting = false
+
+            for i in 0..<inputs {
+                // Keep the last element at or before the pivot and the one after it
+                while count(i) > 1, time(i, at: 1) <= pivot {
+                    removeFirst(i)
+                    statistics.didDrop(input: i)
+                }
+
+                var t = time(i, at: 0)
+                if t < pivot {
+                    if count(i) > 1 {
+                        let next = time(i, at: 1)
+                        if next - pivot < pivot - t {
+                            second[i] = true
+                            t = next
+                        }
+                    } else {
+                        // The next element of this input might be closer to the pivot
+                        waiting = true
+                    }
+                }
+
+                if t < earliest.time {
+                    earliest = (t, i)
+                }
+                latest = max(latest, t)
+            }
+
+            if latest - earliest.time <= slop {
+                guard !waiting else { return nil }
+
+                for i in 0..<inputs where second[i] {
+                    removeFirst(i)
+                    statistics.didDrop(input: i)
+                }
+                statistics.didMatch()
+                return popFirst()
+            }
+
+            // The earliest element is at or before the pivot, and the pivot only moves later
+            removeFirst(earliest.input)
+            statistics.didDrop(input: earliest.input)
+        }
+
+        return nil
+    }
+}
+
+private struct TimedQueues2<A, B>: TimedQueues {
+    var a: TimedQueue<A>
+    var b: TimedQueue<B>
+
+    init(capacity: Int) {
+        a = TimedQueue(capacity: capacity)
+        b = TimedQueue(capacity: capacity)
+    }
+
+    var inputs: Int { 2 }
+
+    func count(_ input: Int) -> Int {
+        return input == 0 ? a.count : b.count
+    }
+
+    func isFull(_ input: Int) -> Bool {
+        return input == 0 ? a.isFull : b.isFull
+    }
+
+    func time(_ input: Int, at offset: Int) -> CFTimeInterval {
+        return input == 0 ? a.time(at: offset) : b.time(at: offset)
+    }
+
+    mutating func removeFirst(_ input: Int) {
+        if input == 0 { a.removeFirst() } else { b.removeFirst() }
+    }
+
+    mutating func removeAll() {
+        a.removeAll()
+        b.removeAll()
+    }
+
+    mutating func popFirst() -> (A, B) {
+        return (a.removeFirst(), b.removeFirst())
+    }
+}
+
+private struct TimedQueues3<A, B, C>: TimedQueues {
+    var a: TimedQueue<A>
+    var b: TimedQueue<B>
+    var c: TimedQueue<C>
+
+    init(capacity: Int) {
+        a = TimedQueue(capacity: capacity)
+        b = TimedQueue(capacity: capacity)
+        c = TimedQueue(capacity: capacity)
+    }
+
+    var inputs: Int { 3 }
+
+    func count(_ input: Int) -> Int {
+        switch input {
+        case 0: return a.count
+        case 1: return b.count
+        default: return c.count
+        }
+    }
+
+    func isFull(_ input: Int) -> Bool {
+        switch input {
+        case 0: return a.isFull
+        case 1: return b.isFull
+        default: return c.isFull
+        }
+    }
+
+    func time(_ input: Int, at offset: Int) -> CFTimeInterval {
+        switch input {
+        case 0: return a.time(at: offset)
+        case 1: return b.time(at: offset)
+        default: return c.time(at: offset)
+        }
+    }
+
+    mutating func removeFirst(_ input: Int) {
+        switch input {
+        case 0: a.removeFirst()
+        case 1: b.removeFirst()
+        default: c.removeFirst()
+        }
+    }
+
+    mutating func removeAll() {
+        a.removeAll()
+        b.removeAll()
+        c.removeAll()
+    }
+
+    mutating func popFirst() -> (A, B, C) {
+        return (a.removeFirst(), b.removeFirst(), c.removeFirst())
+    }
+}
+
+private struct TimedQueues4<A, B, C, D>: TimedQueues {
+    var a: TimedQueue<A>
+    var b: TimedQueue<B>
+    var c: TimedQueue<C>
+    var d: TimedQueue<D>
+
+    init(capacity: Int) {
+        a = TimedQueue(capacity: capacity)
+        b = TimedQueue(capacity: capacity)
+        c = TimedQueue(capacity: capacity)
+        d = TimedQueue(capacity: capacity)
+    }
+
+    var inputs: Int { 4 }
+
+    func count(_ input: Int) -> Int {
+        switch input {
+        case 0: return a.count
+        case 1: return b.count
+        case 2: return c.count
+        default: return d.count
+        }
+    }
+
+    func isFull(_ input: Int) -> Bool {
+        switch input {
+        case 0: return a.isFull
+        case 1: return b.isFull
+        case 2: return c.isFull
+        default: return d.isFull
+        }
+    }
+
+    func time(_ input: Int, at offset: Int) -> CFTimeInterval {
+        switch input {
+        case 0: return a.time(at: offset)
+        case 1: return b.time(at: offset)
+        case 2: return c.time(at: offset)
+        default: return d.time(at: offset)
+        }
+    }
+
+    mutating func removeFirst(_ input: Int) {
+        switch input {
+        case 0: a.removeFirst()
+        case 1: b.removeFirst()
+        case 2: c.removeFirst()
+        default: d.removeFirst()
+        }
+    }
+
+    mutating func removeAll() {
+        a.removeAll()
+        b.removeAll()
+        c.removeAll()
+        d.removeAll()
+    }
+
+    mutating func popFirst() -> (A, B, C, D) {
+        return (a.removeFirst(), b.removeFirst(), c.removeFirst(), d.removeFirst())
+    }
+}
+
+// MARK: Subscription
+
+private final class ApproximateTimeSyncInner<Downstream: Subscriber, Queues: TimedQueues>: Subscription
+    where Queues.Output == Downstream.Input
+{
+    typealias Failure = Downstream.Failure
+
+    private final class Side<Input>: Subscriber {
+        typealias Failure = Downstream.Failure
+
+        let index: Int
+        let time: ((Input) -> CFTimeInterval)?
+        let push: (inout Queues, Input, CFTimeInterval) -> Void
+        weak var parent: ApproximateTimeSyncInner?
+
+        init(index: Int, parent: ApproximateTimeSyncInner, time: ((Input) -> CFTimeInterval)?,
+             push: @escaping (inout Queues, Input, CFTimeInterval) -> Void) {
+            self.index = index
+            self.parent = parent
+            self.time = time
+            self.push = push
+        }
+
+        func receive(subscription: Subscription) {
+            guard let parent = parent else {
+                subscription.cancel()
+                return
+            }
+            parent.receive(subscription: subscription, index: index)
+        }
+
+        func receive(_ input: Input) -> Subscribers.Demand {
+            // Stamped here, before taking the lock
+            let stamp = time?(input) ?? CACurrentMediaTime()
+            parent?.receive(index: index) { push(&$0, input, stamp) }
+            return .none
+        }
+
+        func receive(completion: Subscribers.Completion<Failure>) {
+            parent?.receive(completion: completion)
+        }
+    }
+
+    private let lock = NSLock()
+    private var downstream: Downstream?
+    private var subscriptions: [Subscription?]
+    private var queues: Queues
+    private let slop: TimeInterval
+    private let statistics: Publishers.ApproximateTimeSyncStatistics
+    private var demand = Subscribers.Demand.none
+
+    init(downstream: Downstream, queues: Queues, slop: TimeInterval, statistics: Publishers.ApproximateTimeSyncStatistics) {
+        self.downstream = downstream
+        self.subscriptions = [Subscription?](repeating: nil, count: queues.inputs)
+        self.queues = queues
+        self.slop = slop
+        self.statistics = statistics
+    }
+
+    func subscribe<Upstream: Publisher>(_ upstream: Upstream, index: Int, time: ((Upstream.Output) -> CFTimeInterval)?,
+                                        push: @escaping (inout Queues, Upstream.Output, CFTimeInterval) -> Void)
+        where Upstream.Failure == Failure
+    {
+        upstream.subscribe(Side(index: index, parent: self, time: time, push: push))
+    }
+
+    fileprivate func receive(subscription: Subscription, index: Int) {
+        lock.lock()
+        guard downstream != nil, subscriptions[index] == nil else {
+            lock.unlock()
+            subscription.cancel()
+            return
+        }
+        subscriptions[index] = subscription
+        lock.unlock()
+
+        // The queues are bounded, so it is safe to accept everything
+        subscription.request(.unlimited)
+    }
+
+    fileprivate func receive(index: Int, push: (inout Queues) -> Void) {
+        lock.lock()
+        guard let downstream = downstream else {
+            lock.unlock()
+            return
+        }
+
+        if queues.isFull(index) {
+            queues.removeFirst(index)
+            statistics.didDrop(input: index)
+        }
+        push(&queues)
+
+        guard let matched = queues.match(slop: slop, statistics: statistics) else {
+            lock.unlock()
+            return
+        }
+
+        guard demand > 0 else {
+            // Nobody asked for it
+            for i in 0..<queues.inputs {
+                statistics.didDrop(input: i)
+            }
+            lock.unlock()
+            return
+        }
+        demand -= 1
+        lock.unlock()
+
+        let newDemand = downstream.receive(matched)
+
+        lock.lock()
+        demand += newDemand
+        lock.unlock()
+    }
+
+    fileprivate func receive(completion: Subscribers.Completion<Failure>) {
+        lock.lock()
+        guard let downstream = downstream else {
+            lock.unlock()
+            return
+        }
+        // Nothing can be matched once any of the inputs completes
+        let subscriptions = self.subscriptions
+        terminate()
+        lock.unlock()
+
+        subscriptions.forEach { $0?.cancel() }
+        downstream.receive(completion: completion)
+    }
+
+    func request(_ demand: Subscribers.Demand) {
+        lock.lock()
+        self.demand += demand
+        lock.unlock()
+    }
+
+    func cancel() {
+        lock.lock()
+        let subscriptions = self.subscriptions
+        terminate()
+        lock.unlock()
+
+        subscriptions.forEach { $0?.cancel() }
+    }
+
+    private func terminate() {
+        downstream = nil
+        subscriptions = subscriptions.map { _ in nil }
+        queues.removeAll()
+    }
+}
@@ -0,0 +1,439 @@
+//
+//  Publishers.Resample.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+import simd
+import QuartzCore.CoreAnimation
+
+/// A type which values can be interpolated.
+public protocol Interpolatable {
+    /// Linear interpolation between `a` and `b`, where `t` is in [`0.0...1.0`] interval.
+    static func lerp(_ a: Self, _ b: Self, _ t: Double) -> Self
+    /// Spherical linear interpolation between `a` and `b`, where `t` is in [`0.0...1.0`] interval.
+    ///
+    /// Defaults to `lerp()` for types that do not represent rotations.
+    static func slerp(_ a: Self, _ b: Self, _ t: Double) -> Self
+}
+
+public extension Interpolatable {
+    static func slerp(_ a: Self, _ b: Self, _ t: Double) -> Self {
+        return lerp(a, b, t)
+    }
+}
+
+extension Double: Interpolatable {
+    public static func lerp(_ a: Double, _ b: Double, _ t: Double) -> Double {
+        return a + (b - a) * t
+    }
+}
+
+extension Float: Interpolatable {
+    public static func lerp(_ a: Float, _ b: Float, _ t: Double) -> Float {
+        return a + (b - a) * Float(t)
+    }
+}
+
+extension SIMD2: Interpolatable where Scalar: BinaryFloatingPoint {
+    public static func lerp(_ a: SIMD2, _ b: SIMD2, _ t: Double) -> SIMD2 {
+        return a + (b - a) * Scalar(t)
+    }
+}
+
+extension SIMD3: Interpolatable where Scalar: BinaryFloatingPoint {
+    public static func lerp(_ a: SIMD3, _ b: SIMD3, _ t: Double) -> SIMD3 {
+        return a + (b - a) * Scalar(t)
+    }
+}
+
+extension SIMD4: Interpolatable where Scalar: BinaryFloatingPoint {
+    public static func lerp(_ a: SIMD4, _ b: SIMD4, _ t: Double) -> SIMD4 {
+        return a + (b - a) * Scalar(t)
+    }
+}
+
+extension simd_quatd: Interpolatable {
+    /// Normalized linear interpolation along the shortest arc.
+    public static func lerp(_ a: simd_quatd, _ b: simd_quatd, _ t: Double) -> simd_quatd {
+        // q and -q represent the same rotation
+        let b = simd_dot(a, b) < 0.0 ? -b : b
+        return simd_normalize(simd_quatd(vector: a.vector + (b.vector - a.vector) * t))
+    }
+
+    public static func slerp(_ a: simd_quatd, _ b: simd_quatd, _ t: Double) -> simd_quatd {
+        return simd_slerp(a, b, t)
+    }
+}
+
+extension Imu: Interpolatable {
+    public static func lerp(_ a: Imu, _ b: Imu, _ t: Double) -> Imu {
+        return Imu(accel: .lerp(a.accel, b.accel, t),
+                   gyro: .lerp(a.gyro, b.gyro, t),
+                   orientation: .lerp(a.orientation, b.orientation, t),
+                   temperature: .lerp(a.temperature, b.temperature, t))
+    }
+
+    public static func slerp(_ a: Imu, _ b: Imu, _ t: Double) -> Imu {
+        var imu = lerp(a, b, t)
+        imu.orientation = .slerp(a.orientation, b.orientation, t)
+        return imu
+    }
+}
+
+extension Vo: Interpolatable {
+    public static func lerp(_ a: Vo, _ b: Vo, _ t: Double) -> Vo {
+        return Vo(velocity: .lerp(a.velocity, b.velocity, t),
+                  position: .lerp(a.position, b.position, t),
+                  isValid: t < 0.5 ? a.isValid : b.isValid)
+    }
+}
+
+extension Mvo: Interpolatable {
+    public static func lerp(_ a: Mvo, _ b: Mvo, _ t: Double) -> Mvo {
+        return Mvo(velocity: .lerp(a.velocity, b.velocity, t),
+                   velocityCov: a.velocityCov + (b.velocityCov - a.velocityCov) * t,
+                   position: .lerp(a.position, b.position, t),
+                   positionCov: a.positionCov + (b.positionCov - a.positionCov) * t,
+                   height: .lerp(a.height, b.height, t),
+                   heightVariance: .lerp(a.heightVariance, b.heightVariance, t),
+                   isValid: t < 0.5 ? a.isValid : b.isValid)
+    }
+}
+
+public extension Publisher {
+    /// Resamples the upstream elements to a fixed rate using zero-order hold, i.e. emits
+    /// the latest upstream element at every tick.
+    ///
+    /// Elements are stamped with `clock` when they reach the operator, unless `time` is given.
+    /// When the upstream delivers on a queue, e.g. `Sensor` subscribers on the main queue,
+    /// stamp the elements where they are produced and pass the stamp with `time`.
+    ///
+    /// - Parameters:
+    ///   - rate: Output rate, in Hz.
+    ///   - delay: How far behind the tick time to sample the upstream signal, in seconds.
+    ///   - clock: Time source of the ticks and of the arrival stamps, e.g. `Tello.clock`. Defaults to `CACurrentMediaTime()`.
+    ///   - time: Time stamp of an element on `clock`, non-decreasing. Arrival time if `nil`.
+    func resample(rate: Double, delay: TimeInterval = 0.0,
+                  clock: @escaping () -> CFTimeInterval = CACurrentMediaTime,
+                  time: ((Output) -> CFTimeInterval)? = nil) -> Publishers.Resample<Self> {
+        return Publishers.Resample(upstream: self, rate: rate, mode: .zeroOrderHold, delay: delay,
+                                   clock: clock, time: time, interpolator: nil)
+    }
+}
+
+public extension Publisher where Output: Interpolatable {
+    /// Resamples the upstream elements to a fixed rate.
+    ///
+    /// Interpolating modes need two samples around the sampling time, so the signal is sampled
+    /// `delay` seconds behind the tick time. Set `delay` to at least one upstream period
+    /// to avoid holding the latest sample. The samples are never extrapolated.
+    ///
+    /// Elements are stamped with `clock` when they reach the operator, unless `time` is given.
+    /// When the upstream delivers on a queue, e.g. `Sensor` subscribers on the main queue,
+    /// stamp the elements where they are produced and pass the stamp with `time`.
+    ///
+    /// - Parameters:
+    ///   - rate: Output rate, in Hz.
+    ///   - mode: Resampling mode.
+    ///   - delay: How far behind the tick time to sample the upstream signal, in seconds.
+    ///   - clock: Time source of the ticks and of the arrival stamps, e.g. `Tello.clock`. Defaults to `CACurrentMediaTime()`.
+    ///   - time: Time stamp of an element on `clock`, non-decreasing. Arrival time if `nil`.
+    func resample(rate: Double, mode: Publishers.ResamplingMode, delay: TimeInterval = 0.0,
+                  clock: @escaping () -> CFTimeInterval = CACurrentMediaTime,
+                  time: ((Output) -> CFTimeInterval)? = nil) -> Publishers.Resample<Self> {
+        let interpolator: ((Output, Output, Double) -> Output)?
+
+        switch mode {
+        case .zeroOrderHold:
+            interpolator = nil
+        case .linear:
+            interpolator = Output.lerp
+        case .slerp:
+            interpolator = Output.slerp
+        }
+
+        return Publishers.Resample(upstream: self, rate: rate, mode: mode, delay: delay,
+                                   clock: clock, time: time, interpolator: interpolator)
+    }
+}
+
+public extension Publishers {
+    /// Resampling modes.
+    enum ResamplingMode {
+        /// Holds the latest sample until the next one arrives.
+        case zeroOrderHold
+        /// Linear interpolation between the two closest samples.
+        case linear
+        /// Spherical linear interpolation between the two closest samples.
+        /// Differs from `.linear` only for rotations, e.g. `simd_quatd`.
+        case slerp
+    }
+
+    /// A publisher that emits upstream elements resampled to a fixed rate.
+    ///
+    /// The output is driven by a timer on a background queue, independently of the upstream rate.
+    /// The tick times are kept on a fixed grid of the clock, ticks the timer missed are skipped.
+    struct Resample<Upstream>: Publisher where Upstream: Publisher {
+        public typealias Output = Upstream.Output
+        public typealias Failure = Upstream.Failure
+
+        public let upstream: Upstream
+        /// Output rate, in Hz.
+        public let rate: Double
+        /// Resampling mode.
+        public let mode: ResamplingMode
+        /// How far behind the tick time the upstream signal is sampled, in seconds.
+        public let delay: TimeInterval
+
+        private let clock: () -> CFTimeInterval
+        private let time: ((Output) -> CFTimeInterval)?
+        private let interpolator: ((Output, Output, Double) -> Output)?
+        // Drives the ticks instead of the background timer if set
+        private var ticker: ResampleTicker?
+
+        fileprivate init(upstream: Upstream, rate: Double, mode: ResamplingMode, delay: TimeInterval,
+                         clock: @escaping () -> CFTimeInterval, time: ((Output) -> CFTimeInterval)?,
+                         interpolator: ((Output, Output, Double) -> Output)?)
+        {
+            precondition(rate > 0.0, "Resampling rate must be positive")
+
+            self.upstream = upstream
+            self.rate = rate
+            self.mode = mode
+            self.delay = delay
+            self.clock = clock
+            self.time = time
+            self.interpolator = interpolator
+        }
+
+        /// Ticks whenever `ticker` fires instead of on a background timer, e.g. to step the output with a manual clock.
+        internal func ticking(with ticker: ResampleTicker) -> Self {
+            var resample = self
+            resample.ticker = ticker
+            return resample
+        }
+
+        public func receive<Downstream: Subscriber>(subscriber: Downstream)
+            where Downstream.Input == Output, Downstream.Failure == Failure
+        {
+            upstream.subscribe(Inner(downstream: subscriber, period: 1.0 / rate, delay: delay, clock: clock, time: time,
+                                     interpolator: interpolator, ticker: ticker))
+        }
+    }
+}
+
+/// Fires the ticks of the resampling subscriptions registered with it.
+internal final class ResampleTicker {
+    private let lock = NSLock()
+    private var handlers: [() -> Void] = []
+
+    fileprivate func add(_ handler: @escaping () -> Void) {
+        lock.lock()
+        handlers.append(handler)
+        lock.unlock()
+    }
+
+    /// Runs one tick of every registered subscription on the calling thread.
+    func fire() {
+        lock.lock()
+        let handlers = self.handlers
+        lock.unlock()
+
+        handlers.forEach { $0() }
+    }
+}
+
+extension Publishers.Resample {
+    private final class Inner<Downstream: Subscriber>: Subscriber, Subscription
+        where Downstream.Input == Output, Downstream.Failure == Upstream.Failure
+    {
+        typealias Input = Upstream.Output
+        typealias Failure = Upstream.Failure
+
+        private struct Sample {
+            let time: CFTimeInterval
+            let value: Input
+        }
+
+        /// Number of samples kept for interpolation
+        private static var historySize: Int { 16 }
+
+        private let lock = NSLock()
+        private var downstream: Downstream?
+        private var subscription: Subscription?
+        private var demand = Subscribers.Demand.none
+
+        private let period: TimeInterval
+        private let delay: TimeInterval
+        private let clock: () -> CFTimeInterval
+        private let time: ((Input) -> CFTimeInterval)?
+        private let interpolator: ((Input, Input, Double) -> Input)?
+        private let ticker: ResampleTicker?
+
+        private var timer: BackgroundTimer?
+        private var started = false
+        private var startTime: CFTimeInterval = 0.0
+        private var tick: Int = 0
+
+        // Preallocated ring of the latest samples, ordered by time
+        private var history: [Sample?]
+        private var historyHead = 0
+        private var historyCount = 0
+
+        init(downstream: Downstream, period: TimeInterval, delay: TimeInterval, clock: @escaping () -> CFTimeInterval,
+             time: ((Input) -> CFTimeInterval)?, interpolator: ((Input, Input, Double) -> Input)?, ticker: ResampleTicker?) {
+            self.downstream = downstream
+            self.period = period
+            self.delay = delay
+            self.clock = clock
+            self.time = time
+            self.interpolator = interpolator
+            self.ticker = ticker
+            self.history = [Sample?](repeating: nil, count: Inner.historySize)
+        }
+
+        func receive(subscription: Subscription) {
+            lock.lock()
+            guard let downstream = downstream, self.subscription == nil else {
+                lock.unlock()
+                subscription.cancel()
+                return
+            }
+            self.subscription = subscription
+            lock.unlock()
+
+            downstream.receive(subscription: self)
+            // Upstream elements are only stored, so accept everything
+            subscription.request(.unlimited)
+        }
+
+        func receive(_ input: Input) -> Subscribers.Demand {
+            // Stamped here, before taking the lock
+            let stamp = time?(input) ?? clock()
+
+            lock.lock()
+            let index = (historyHead + historyCount) % history.count
+            history[index] = Sample(time: stamp, value: input)
+            if historyCount < history.count {
+                historyCount += 1
+            } else {
+                historyHead = (historyHead + 1) % history.count
+            }
+            lock.unlock()
+
+            return .none
+        }
+
+        func receive(completion: Subscribers.Completion<Failure>) {
+            lock.lock()
+            guard let downstream = downstream else {
+                lock.unlock()
+                return
+            }
+            terminate()
+            lock.unlock()
+
+            downstream.receive(completion: completion)
+        }
+
+        func request(_ demand: Subscribers.Demand) {
+            lock.lock()
+            self.demand += demand
+
+            if !started && downstream != nil {
+                started = true
+                startTime = clock()
+                tick = 0
+
+                if let ticker = ticker {
+                    ticker.add { [weak self] in
+                        self?.timerDidFire()
+                    }
+                } else {
+                    timer = BackgroundTimer(repeat: period) { [weak self] _ in
+                        self?.timerDidFire()
+                    }
+                }
+            }
+            lock.unlock()
+        }
+
+        func cancel() {
+            lock.lock()
+            let subscription = self.subscription
+            terminate()
+            lock.unlock()
+
+            subscription?.cancel()
+        }
+
+        private func terminate() {
+            timer?.cancel()
+            timer = nil
+            downstream = nil
+            subscription = nil
+            historyCount = 0
+        }
+
+        private func timerDidFire() {
+            lock.lock()
+            guard let downstream = downstream else {
+                lock.unlock()
+                return
+            }
+
+            // Keep the nominal tick times on a fixed grid, skip ticks the timer missed
+            let now = clock()
+            tick = max(tick + 1, Int(((now - startTime) / period).rounded(.down)))
+            let sampleTime = startTime + Double(tick) * period - delay
+
+            guard demand > 0, let value = sample(at: sampleTime) else {
+                lock.unlock()
+                return
+            }
+            demand -= 1
+            lock.unlock()
+
+            let newDemand = downstream.receive(value)
+
+            lock.lock()
+            demand += newDemand
+            lock.unlock()
+        }
+
+        /// Must be called with the lock held.
+        private func sample(at time: CFTimeInterval) -> Input? {
+            guard historyCount > 0 else { return nil }
+
+            // Find the latest sample not newer than the requested time
+            var before: Sample? = nil
+            var after: Sample? = nil
+
+            for i in 0..<historyCount {
+                let s = history[(historyHead + i) % history.count]!
+                if s.time <= time {
+                    before = s
+                } else {
+                    after = s
+                    break
+                }
+            }
+
+            switch (before, after) {
+            case let (b?, a?):
+                guard let interpolate = interpolator else { return b.value }
+                let t = ((time - b.time) / (a.time - b.time)).clamped(to: 0.0...1.0)
+                return interpolate(b.value, a.value, t)
+            case let (b?, nil):
+                return b.value
+            case let (nil, a?):
+                return a.value
+            case (nil, nil):
+                return nil
+            }
+        }
+    }
+}
@@ -13,8 +13,9 @@ public extension Publisher {
     /// - Parameters:
     ///    - size: buffer size
     ///    - strategy: when set to `.always` (default) generates output with first upstream element; when set to `.whenFull` generates output after the buffer is full
-    func ringBuffer(size: Int, strategy: Publishers.RingBuffer<Self>.OutputStrategy = .always) -> Publishers.RingBuffer<Self> {
-        return Publishers.RingBuffer(upstream: self, size: size, strategy: strategy)
+    ///    - buffering: how many outputs to keep while the downstream has no demand. By default keeps only the latest one.
+    func ringBuffer(size: Int, strategy: Publishers.RingBuffer<Self>.OutputStrategy = .always, buffering: BufferingPolicy = .latest) -> Publishers.RingBuffer<Self> {
+        return Publishers.RingBuffer(upstream: self, size: size, strategy: strategy, buffering: buffering)
     }
 }
 
@@ -22,7 +23,11 @@ public extension Publishers {
     /// A publisher that buffers elements from an upstream publisher in a ring buffer.
     struct RingBuffer<Upstream> : Publisher where Upstream : Publisher {
         /// The kind of values published by this publisher.
-        public typealias Output = [Upstream.Output]
+        ///
+        /// The window shares storage with the ring buffer, so publishing it does not copy the elements.
+        /// The storage is copied only if a subscriber keeps the window beyond `receive(_:)`.
+        /// Use `Array(window)` to get an independent copy.
+        public typealias Output = Window
 
         /// The kind of errors this publisher might publish.
         ///
@@ -38,16 +43,24 @@ public extension Publishers {
         /// Output strategy
         public let strategy: OutputStrategy
 
-        public init(upstream: Upstream, size: Int, strategy: OutputStrategy) {
+        /// Outputs buffering policy for slow subscribers
+        public let buffering: BufferingPolicy
+
+        /// Number of outputs dropped because the subscribers had no demand
+        public let drops: DropCounter
+
+        public init(upstream: Upstream, size: Int, strategy: OutputStrategy, buffering: BufferingPolicy = .latest) {
             self.upstream = upstream
             self.size = size
             self.strategy = strategy
+            self.buffering = buffering
+            self.drops = DropCounter()
         }
 
         public func receive<Downstream: Subscriber>(subscriber: Downstream)
             where Downstream.Input == Output, Downstream.Failure == Failure
         {
-            upstream.subscribe(Inner(downstream: subscriber, size: size, strategy: strategy))
+            upstream.subscribe(Inner(downstream: subscriber, size: size, strategy: strategy, buffering: buffering, drops: drops))
         }
     }
 }
@@ -62,49 +75,135 @@ public extension Publishers.RingBuffer {
     }
 }
 
+public extension Publishers.RingBuffer {
+    /// A read-only view of the ring buffer contents ordered from the oldest to the newest element.
+    struct Window: RandomAccessCollection {
+        public typealias Element = Upstream.Output
+        public typealias Index = Int
+
+        // Copy-on-write snapshot of the buffer
+        private let ring: TelloSwift.RingBuffer<Element>
+
+        fileprivate init(_ ring: TelloSwift.RingBuffer<Element>) {
+            self.ring = ring
+        }
+
+        /// Copies the elements of `window` into storage of their own.
+        fileprivate init(snapshot window: Window) {
+            var ring = TelloSwift.RingBuffer<Element>(count: Swift.max(window.count, 1))
+            window.forEach { ring.write($0) }
+            self.ring = ring
+        }
+
+        public var startIndex: Int { 0 }
+        public var endIndex: Int { ring.availableSpaceForReading }
+
+        public subscript(position: Int) -> Element {
+            return ring.element(at: position)
+        }
+    }
+}
+
 extension Publishers.RingBuffer {
-    private final class Inner<Downstream: Subscriber> : Subscriber where Downstream.Input == Output, Downstream.Failure == Upstream.Failure {
+    private final class Inner<Downstream: Subscriber> : Subscriber, Subscription where Downstream.Input == Output, Downstream.Failure == Upstream.Failure {
 
         typealias Input = Upstream.Output
         typealias Failure = Upstream.Failure
 
-        let downstream: Downstream
-        let strategy: OutputStrategy
-        var buf: RingBuffer<Input>
+        private let lock = NSLock()
+        private var downstream: Downstream?
+        private var subscription: Subscription?
+        private let strategy: OutputStrategy
+        private var buf: RingBuffer<Input>
+        private var outputs: DemandBuffer<Output>!
 
-        init(downstream: Downstream, size: Int, strategy: OutputStrategy) {
+        init(downstream: Downstream, size: Int, strategy: OutputStrategy, buffering: BufferingPolicy, drops: DropCounter) {
             self.downstream = downstream
             self.strategy = strategy
             self.buf = RingBuffer<Input>(count: size)
+            // Buffered windows get storage of their own, so sliding the ring does not copy all of it
+            self.outputs = DemandBuffer(policy: buffering, drops: drops, detach: { Window(snapshot: $0) }) { [weak self] in
+                self?.deliver($0) ?? .none
+            }
+        }
+
+        private func deliver(_ output: Output) -> Subscribers.Demand {
+            lock.lock()
+            let downstream = self.downstream
+            lock.unlock()
+
+            return downstream?.receive(output) ?? .none
         }
 
         func receive(subscription: Subscription) {
-            downstream.receive(subscription: subscription)
+            lock.lock()
+            guard let downstream = downstream, self.subscription == nil else {
+                lock.unlock()
+                subscription.cancel()
+                return
+            }
+            self.subscription = subscription
+            lock.unlock()
+
+            downstream.receive(subscription: self)
+            // The window slides over every upstream element, the outputs are throttled by the demand buffer
+            subscription.request(.unlimited)
         }
 
         func receive(_ input: Upstream.Output) -> Subscribers.Demand {
-            buf.write(input)
-
-            let output = Array(buf)
+            lock.lock()
+            guard downstream != nil else {
+                lock.unlock()
+                return .none
+            }
 
-            if strategy == .always {
-                _ = downstream.receive(output)
+            buf.write(input)
+            let emit = strategy == .always || buf.isFull
+            lock.unlock()
+
+            // Windows are created in place and delivered directly when demanded, so unless the
+            // subscriber keeps the window, no reference to the storage outlives the call and
+            // dropping the oldest element below does not copy it
+            if emit {
+                outputs.offer(Window(buf))
             }
 
+            lock.lock()
             if buf.isFull {
-                if strategy == .whenFull {
-                    _ = downstream.receive(output)
-                }
-
                 // Drop oldest
                 _ = buf.read()
             }
+            lock.unlock()
 
-            return .max(buf.availableSpaceForWriting)
+            return .none
         }
 
         func receive(completion: Subscribers.Completion<Upstream.Failure>) {
+            lock.lock()
+            guard let downstream = downstream else {
+                lock.unlock()
+                return
+            }
+            self.downstream = nil
+            self.subscription = nil
+            lock.unlock()
+
             downstream.receive(completion: completion)
         }
+
+        func request(_ demand: Subscribers.Demand) {
+            outputs.request(demand)
+        }
+
+        func cancel() {
+            lock.lock()
+            let subscription = self.subscription
+            self.downstream = nil
+            self.subscription = nil
+            lock.unlock()
+
+            outputs.reset()
+            subscription?.cancel()
+        }
     }
 }
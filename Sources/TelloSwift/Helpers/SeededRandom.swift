@@ -0,0 +1,42 @@
+//
+//  SeededRandom.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+
+/// Deterministic random number generator (SplitMix64).
+///
+/// The same seed always produces the same sequence, on every platform,
+/// which makes simulations reproducible.
+public struct SeededRandom: RandomNumberGenerator {
+    private var state: UInt64
+
+    public init(seed: UInt64) {
+        state = seed
+    }
+
+    public mutating func next() -> UInt64 {
+        state &+= 0x9e3779b97f4a7c15
+        var z = state
+        z = (z ^ (z >> 30)) &* 0xbf58476d1ce4e5b9
+        z = (z ^ (z >> 27)) &* 0x94d049bb133111eb
+        return z ^ (z >> 31)
+    }
+
+    /// Uniform sample in [0; 1).
+    public mutating func uniform() -> Double {
+        return Double(next() >> 11) * 0x1.0p-53
+    }
+
+    /// Normally distributed sample (Box–Muller).
+    public mutating func gaussian(mean: Double = 0.0, standardDeviation: Double = 1.0) -> Double {
+        guard standardDeviation > 0.0 else { return mean }
+
+        // Avoid log(0)
+        let u1 = 1.0 - uniform()
+        let u2 = uniform()
+        return mean + standardDeviation * (-2.0 * log(u1)).squareRoot() * cos(2.0 * .pi * u2)
+    }
+}
@@ -0,0 +1,73 @@
+//
+//  SeqLock.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import TelloSwiftObjC
+
+/// Single-value container for trivially copyable values, based on a sequence lock.
+///
+/// Readers never take a lock and never block writers; they retry in the rare case
+/// a write happened during the read. Writers are serialized with each other.
+/// Suited for small values that are written occasionally and read often from another thread,
+/// e.g. the latest control command read by the keep-alive timer.
+public final class SeqLock<T> {
+    private let seq: UnsafeMutablePointer<Int64>
+    private let words: UnsafeMutablePointer<Int64>
+    // Memory to read into; only its bytes are replaced
+    private let placeholder: T
+
+    public init(_ value: T) {
+        precondition(_isPOD(T.self), "SeqLock supports only trivially copyable types")
+
+        let count = (MemoryLayout<T>.size + MemoryLayout<Int64>.size - 1) / MemoryLayout<Int64>.size
+        seq = UnsafeMutablePointer<Int64>.allocate(capacity: 1)
+        seq.initialize(to: 0)
+        words = UnsafeMutablePointer<Int64>.allocate(capacity: Swift.max(count, 1))
+        words.initialize(repeating: 0, count: Swift.max(count, 1))
+        placeholder = value
+
+        store(value)
+    }
+
+    deinit {
+        seq.deallocate()
+        words.deallocate()
+    }
+
+    /// Returns a consistent copy of the latest stored value.
+    public func load() -> T {
+        var value = placeholder
+        withUnsafeMutableBytes(of: &value) {
+            tello_seqlock_read(seq, words, $0.baseAddress!, $0.count)
+        }
+        return value
+    }
+
+    /// Replaces the stored value.
+    public func store(_ value: T) {
+        var value = value
+        withUnsafeBytes(of: &value) {
+            tello_seqlock_write(seq, words, $0.baseAddress!, $0.count)
+        }
+    }
+
+    /// Modifies the stored value in place. Other writers wait until `body` returns.
+    public func update(_ body: (inout T) -> Void) {
+        let s = tello_seqlock_write_begin(seq)
+
+        var value = placeholder
+        withUnsafeMutableBytes(of: &value) {
+            // No other writer is active, so the words are consistent
+            tello_seqlock_load_bytes(words, $0.baseAddress!, $0.count)
+        }
+        body(&value)
+        withUnsafeBytes(of: &value) {
+            tello_seqlock_store_bytes(words, $0.baseAddress!, $0.count)
+        }
+
+        tello_seqlock_write_end(seq, s)
+    }
+}
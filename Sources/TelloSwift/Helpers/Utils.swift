@@ -28,6 +28,9 @@ public func deg2rad<T: FloatingPoint>(_ deg: T) -> T {
  time! To make this thread-safe for one reader and one writer, it should be
  enough to change read/writeIndex += 1 to OSAtomicIncrement64(), but I haven't
  tested this...
+
+ See `PowerOfTwoRingBuffer` for a mask-indexed variant with bulk operations,
+ and `SPSCRingBuffer` for a lock-free single-producer/single-consumer one.
  */
 public struct RingBuffer<T> {
     private var array: [T?]
@@ -77,6 +80,12 @@ public struct RingBuffer<T> {
     public var isFull: Bool {
         return availableSpaceForWriting == 0
     }
+
+    /* Returns element at `offset` from the oldest one. The buffer must contain that element. */
+    internal func element(at offset: Int) -> T {
+        precondition(offset >= 0 && offset < availableSpaceForReading, "Ring buffer offset out of range")
+        return array[wrapped: readIndex + offset]!
+    }
 }
 
 extension RingBuffer: Sequence {
@@ -123,7 +132,8 @@ public class StopWatch {
     /// Current window size. Can be less than maxWindow
     private(set) public var window: Int
 
-    private var buf: RingBuffer<CFTimeInterval>
+    private var stats: WindowedStatistics<CFTimeInterval>
+    private let samples: SPSCRingBuffer<CFTimeInterval>
     private var startTime: CFTimeInterval
     private var stopTime: CFTimeInterval
     private var avgTime: CFTimeInterval?
@@ -138,7 +148,8 @@ public class StopWatch {
 
     public init(maxWindow: Int, statsInterval: CFTimeInterval = 1.0, delegate: StopWatchDelegate? = nil) {
         bufSize = maxWindow
-        buf = RingBuffer(count: maxWindow)
+        stats = WindowedStatistics(size: maxWindow)
+        samples = SPSCRingBuffer(minimumCapacity: maxWindow)
         startTime = 0.0
         stopTime = 0.0
 
@@ -182,27 +193,14 @@ public class StopWatch {
     }
 
     private func average() -> (Int, CFTimeInterval, CFTimeInterval, CFTimeInterval) {
-        let sum = buf.reduce(CFTimeInterval(), +)
-        let count = buf.availableSpaceForReading
-        let avg = sum / Double(count)
-
-        // Sequence of differences
-        let diff = buf.map {curVal in
-            return curVal - avg
-        }
+        let avg = stats.mean
 
-        // Max deviation
-        let max = diff.max { a, b in abs(a) < abs(b)}
+        // Max deviation, keeps the sign
+        let maxDev = stats.max! - avg
+        let minDev = stats.min! - avg
+        let max = abs(maxDev) >= abs(minDev) ? maxDev : minDev
 
-        // Sum of squared differences
-        var std = diff.reduce(CFTimeInterval()) { prevRes, curVal in
-            return prevRes + pow(curVal, 2.0)
-        }
-
-        // Standard deviation
-        std = sqrt(std) / Double(count - 1)
-
-        return (count, avg, std, max!)
+        return (stats.count, avg, stats.standardDeviation, max)
     }
 
     public func start() {
@@ -211,64 +209,59 @@ public class StopWatch {
 
     public func stop() {
         stopTime = CACurrentMediaTime()
-        let dt = stopTime - startTime
-        statsQueue.async {
-            self.buf.write(dt)
-
-            let (count, avg, std, max) = self.average()
-            (self.window, self.avgTime, self.stdTime, self.maxDevTime) = (count, avg, std, max)
-
-            if self.buf.availableSpaceForWriting == 0 {
-                _ = self.buf.read()
-            }
-        }
-
-        if let avg = self.avgTime {
-            throttle(timeInterval: statsInterval) {
-                guard let delegate = delegate else {
-                    printTime()
-                    return
-                }
-
-                DispatchQueue.main.async {
-                    delegate.stopWatch(self, window: self.window, didEstimateTime: avg)
-                }
-            }
-        }
+        record(stopTime - startTime, reportHz: false)
     }
 
     public func hz() {
         let now = CACurrentMediaTime()
 
         if let last = self.hzLastTime {
-            let dt = now - last
-            statsQueue.async {
-                self.buf.write(dt)
+            record(now - last, reportHz: true)
+        }
 
-                let (count, avg, std, max) = self.average()
-                (self.window, self.avgTime, self.stdTime, self.maxDevTime) = (count, avg, std, max)
+        self.hzLastTime = now
+    }
 
-                if self.buf.availableSpaceForWriting == 0 {
-                    _ = self.buf.read()
-                }
+    private func record(_ dt: CFTimeInterval, reportHz: Bool) {
+        // The samples are handed over to the stats queue without locks.
+        // If the queue falls behind, the sample is dropped.
+        guard samples.push(dt) else { return }
+
+        statsQueue.async {
+            while let dt = self.samples.pop() {
+                self.stats.add(dt)
             }
+            guard !self.stats.isEmpty else { return }
+
+            let (count, avg, std, max) = self.average()
+            (self.window, self.avgTime, self.stdTime, self.maxDevTime) = (count, avg, std, max)
+
+            self.report(hz: reportHz)
         }
+    }
+
+    // Must be called on the stats queue
+    private func report(hz: Bool) {
+        guard let avg = self.avgTime else { return }
+        let window = self.window
 
-        if let avg = self.avgTime {
-            throttle(timeInterval: statsInterval) {
-                guard let delegate = delegate else {
+        throttle(timeInterval: statsInterval) {
+            guard let delegate = delegate else {
+                if hz {
                     printHz()
-                    printTime()
-                    return
                 }
+                printTime()
+                return
+            }
 
-                DispatchQueue.main.async {
-                    delegate.stopWatch(self, window: self.window, didEstimateHz: 1.0 / avg)
+            DispatchQueue.main.async {
+                if hz {
+                    delegate.stopWatch(self, window: window, didEstimateHz: 1.0 / avg)
+                } else {
+                    delegate.stopWatch(self, window: window, didEstimateTime: avg)
                 }
             }
         }
-
-        self.hzLastTime = now
     }
 }
 
@@ -0,0 +1,406 @@
+//
+//  WindowedStatistics.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import Combine
+
+/// A value that `WindowedStatistics` can aggregate.
+///
+/// Scalars are treated as single-lane vectors, SIMD vectors are aggregated lane-wise.
+/// Conforming types store their `laneCount` lanes as contiguous `Scalar`s, like `Double`, `Float` and the SIMD vectors.
+public protocol WindowedStatisticsElement {
+    associatedtype Scalar: BinaryFloatingPoint
+
+    static var zero: Self { get }
+    /// Number of independent lanes.
+    static var laneCount: Int { get }
+
+    static func + (lhs: Self, rhs: Self) -> Self
+    static func - (lhs: Self, rhs: Self) -> Self
+    static func * (lhs: Self, rhs: Self) -> Self
+    static func / (lhs: Self, rhs: Scalar) -> Self
+}
+
+extension WindowedStatisticsElement {
+    subscript(lane lane: Int) -> Scalar {
+        get {
+            return withUnsafeBytes(of: self) { $0.load(fromByteOffset: lane * MemoryLayout<Scalar>.stride, as: Scalar.self) }
+        }
+        set {
+            withUnsafeMutableBytes(of: &self) { $0.storeBytes(of: newValue, toByteOffset: lane * MemoryLayout<Scalar>.stride, as: Scalar.self) }
+        }
+    }
+
+    /// Lane-wise maximum.
+    static func laneMax(_ lhs: Self, _ rhs: Self) -> Self {
+        var result = lhs
+        for lane in 0..<laneCount where rhs[lane: lane] > result[lane: lane] {
+            result[lane: lane] = rhs[lane: lane]
+        }
+        return result
+    }
+}
+
+extension Double: WindowedStatisticsElement {
+    public typealias Scalar = Double
+
+    public static var laneCount: Int { 1 }
+}
+
+extension Float: WindowedStatisticsElement {
+    public typealias Scalar = Float
+
+    public static var laneCount: Int { 1 }
+}
+
+extension SIMD2: WindowedStatisticsElement where Scalar: BinaryFloatingPoint {
+    public static var laneCount: Int { 2 }
+}
+
+extension SIMD3: WindowedStatisticsElement where Scalar: BinaryFloatingPoint {
+    public static var laneCount: Int { 3 }
+}
+
+extension SIMD4: WindowedStatisticsElement where Scalar: BinaryFloatingPoint {
+    public static var laneCount: Int { 4 }
+}
+
+/// Sliding-window statistics with O(1) cost per sample.
+///
+/// - The sum is accumulated with Kahan compensation, so adding and removing
+///   samples for hours does not drift.
+/// - The variance is maintained with Welford's update adapted to a sliding window.
+/// - Minimum and maximum are tracked with monotonic deques (amortized O(1)).
+///
+/// All the storage is allocated at initialization, `add()` and `reset()` do not allocate.
+public struct WindowedStatistics<T: WindowedStatisticsElement> {
+    /// Summary of the current window.
+    public struct Summary {
+        public let count: Int
+        public let mean: T
+        public let variance: T
+        public let min: T
+        public let max: T
+    }
+
+    /// Maximum number of samples in the window.
+    public let size: Int
+
+    private var samples: RingBuffer<T>
+
+    private var runningSum: T = .zero
+    private var compensation: T = .zero
+    private var m2: T = .zero
+
+    private var minima: [MonotonicDeque<T.Scalar>]
+    private var maxima: [MonotonicDeque<T.Scalar>]
+    private var sequence: Int = 0
+
+    public init(size: Int) {
+        precondition(size > 0, "Window size must be positive")
+
+        self.size = size
+        self.samples = RingBuffer(count: size)
+        self.minima = (0..<T.laneCount).map { _ in MonotonicDeque(capacity: size, keepsMinimum: true) }
+        self.maxima = (0..<T.laneCount).map { _ in MonotonicDeque(capacity: size, keepsMinimum: false) }
+    }
+
+    /// Number of samples in the window.
+    public var count: Int {
+        return samples.availableSpaceForReading
+    }
+
+    public var isEmpty: Bool {
+        return samples.isEmpty
+    }
+
+    public var isFull: Bool {
+        return samples.isFull
+    }
+
+    /// Sum of the samples in the window.
+    public var sum: T {
+        return runningSum
+    }
+
+    /// Mean of the samples in the window. Zero when the window is empty.
+    public var mean: T {
+        return count > 0 ? runningSum / T.Scalar(count) : .zero
+    }
+
+    /// Unbiased (sample) variance. Zero for less than two samples.
+    public var variance: T {
+        guard count > 1 else { return .zero }
+        // Rounding may push the sum of squares slightly below zero
+        return T.laneMax(m2, .zero) / T.Scalar(count - 1)
+    }
+
+    /// Lane-wise minimum of the samples in the window, or `nil` if the window is empty.
+    public var min: T? {
+        guard !isEmpty else { return nil }
+        var result: T = .zero
+        for lane in 0..<T.laneCount {
+            result[lane: lane] = minima[lane].front!
+        }
+        return result
+    }
+
+    /// Lane-wise maximum of the samples in the window, or `nil` if the window is empty.
+    public var max: T? {
+        guard !isEmpty else { return nil }
+        var result: T = .zero
+        for lane in 0..<T.laneCount {
+            result[lane: lane] = maxima[lane].front!
+        }
+        return result
+    }
+
+    /// Summary of the current window, or `nil` if the window is empty.
+    public var summary: Summary? {
+        guard let min = min, let max = max else { return nil }
+        return Summary(count: count, mean: mean, variance: variance, min: min, max: max)
+    }
+
+    /// Adds a new sample. When the window is full, the oldest sample is removed.
+    public mutating func add(_ value: T) {
+        if samples.isFull {
+            let oldMean = mean
+            let oldest = samples.read()!
+            accumulate(value - oldest)
+            let newMean = runningSum / T.Scalar(size)
+            m2 = m2 + (value - oldest) * (value - newMean + oldest - oldMean)
+        } else {
+            let oldMean = mean
+            accumulate(value)
+            let newMean = runningSum / T.Scalar(count + 1)
+            m2 = m2 + (value - oldMean) * (value - newMean)
+        }
+        samples.write(value)
+
+        // Expire samples that left the window and push the new one
+        let firstInWindow = sequence - size + 1
+        for lane in 0..<T.laneCount {
+            minima[lane].expire(before: firstInWindow)
+            minima[lane].push(value[lane: lane], sequence: sequence)
+            maxima[lane].expire(before: firstInWindow)
+            maxima[lane].push(value[lane: lane], sequence: sequence)
+        }
+        sequence += 1
+    }
+
+    /// Removes all samples without releasing the storage.
+    public mutating func reset() {
+        while samples.read() != nil {}
+
+        runningSum = .zero
+        compensation = .zero
+        m2 = .zero
+
+        for lane in 0..<T.laneCount {
+            minima[lane].removeAll()
+            maxima[lane].removeAll()
+        }
+        sequence = 0
+    }
+
+    // Kahan summation
+    private mutating func accumulate(_ value: T) {
+        let y = value - compensation
+        let t = runningSum + y
+        compensation = (t - runningSum) - y
+        runningSum = t
+    }
+}
+
+extension WindowedStatistics where T: BinaryFloatingPoint {
+    /// Unbiased (sample) standard deviation. Zero for less than two samples.
+    public var standardDeviation: T {
+        return variance.squareRoot()
+    }
+}
+
+/// Double-ended queue of (sequence, value) pairs with monotonic values.
+///
+/// The front holds the minimum (or maximum) of the values pushed since the last expired sequence.
+private struct MonotonicDeque<Scalar: Comparable> {
+    private var sequences: [Int]
+    private var values: [Scalar?]
+    private var head = 0
+    private var count = 0
+    private let keepsMinimum: Bool
+
+    init(capacity: Int, keepsMinimum: Bool) {
+        self.sequences = [Int](repeating: 0, count: capacity)
+        self.values = [Scalar?](repeating: nil, count: capacity)
+        self.keepsMinimum = keepsMinimum
+    }
+
+    var front: Scalar? {
+        return count > 0 ? values[head] : nil
+    }
+
+    mutating func push(_ value: Scalar, sequence: Int) {
+        // Drop the values that can never become the extremum again
+        while count > 0 {
+            let back = values[(head + count - 1) % values.count]!
+            guard keepsMinimum ? back >= value : back <= value else { break }
+            count -= 1
+        }
+
+        let index = (head + count) % values.count
+        sequences[index] = sequence
+        values[index] = value
+        count += 1
+    }
+
+    mutating func expire(before sequence: Int) {
+        while count > 0 && sequences[head] < sequence {
+            head = (head + 1) % values.count
+            count -= 1
+        }
+    }
+
+    mutating func removeAll() {
+        head = 0
+        count = 0
+    }
+}
+
+// MARK: Combine Publisher
+
+extension Publisher where Output: WindowedStatisticsElement {
+    /// Calculates mean, variance, minimum and maximum over a sliding window of the last `count` elements.
+    ///
+    /// - Parameters:
+    ///   - count: Window size.
+    ///   - strategy: Whether to publish only when the window is full or on every element.
+    ///   - buffering: How many summaries to keep while the downstream has no demand.
+    public func windowedStatistics(count: Int, strategy: Publishers.MovingAverageStrategy = .whenFull, buffering: BufferingPolicy = .latest) -> Publishers.WindowedStatisticsByCount<Self> {
+        return .init(upstream: self, count: count, strategy: strategy, buffering: buffering)
+    }
+}
+
+extension Publishers {
+    /// A publisher that calculates statistics over a sliding window of upstream elements.
+    public struct WindowedStatisticsByCount<Upstream: Publisher>: Publisher where Upstream.Output: WindowedStatisticsElement {
+        public typealias Output = WindowedStatistics<Upstream.Output>.Summary
+        public typealias Failure = Upstream.Failure
+
+        public let upstream: Upstream
+        public let count: Int
+        public let strategy: MovingAverageStrategy
+        /// Summaries buffering policy for slow subscribers
+        public let buffering: BufferingPolicy
+        /// Number of summaries dropped because the subscribers had no demand
+        public let drops: DropCounter
+
+        public init(upstream: Upstream, count: Int, strategy: MovingAverageStrategy, buffering: BufferingPolicy = .latest) {
+            self.upstream = upstream
+            self.count = count
+            self.strategy = strategy
+            self.buffering = buffering
+            self.drops = DropCounter()
+        }
+
+        public func receive<Downstream: Subscriber>(subscriber: Downstream) where Self.Failure == Downstream.Failure, Self.Output == Downstream.Input {
+            upstream.subscribe(Inner(downstream: subscriber, count: count, strategy: strategy, buffering: buffering, drops: drops))
+        }
+    }
+}
+
+extension Publishers.WindowedStatisticsByCount {
+    private final class Inner<Downstream: Subscriber>: Subscriber, Subscription where Downstream.Input == Output, Downstream.Failure == Upstream.Failure {
+        typealias Input = Upstream.Output
+        typealias Failure = Upstream.Failure
+
+        private let lock = NSLock()
+        private var downstream: Downstream?
+        private var subscription: Subscription?
+        private let strategy: Publishers.MovingAverageStrategy
+        private var statistics: WindowedStatistics<Input>
+        private var outputs: DemandBuffer<Output>!
+
+        init(downstream: Downstream, count: Int, strategy: Publishers.MovingAverageStrategy, buffering: BufferingPolicy, drops: DropCounter) {
+            self.downstream = downstream
+            self.strategy = strategy
+            self.statistics = WindowedStatistics(size: count)
+            self.outputs = DemandBuffer(policy: buffering, drops: drops) { [weak self] in
+                self?.deliver($0) ?? .none
+            }
+        }
+
+        private func deliver(_ output: Output) -> Subscribers.Demand {
+            lock.lock()
+            let downstream = self.downstream
+            lock.unlock()
+
+            return downstream?.receive(output) ?? .none
+        }
+
+        func receive(subscription: Subscription) {
+            lock.lock()
+            guard let downstream = downstream, self.subscription == nil else {
+                lock.unlock()
+                subscription.cancel()
+                return
+            }
+            self.subscription = subscription
+            lock.unlock()
+
+            downstream.receive(subscription: self)
+            // Each element only updates the window
+            subscription.request(.unlimited)
+        }
+
+        func receive(_ input: Input) -> Subscribers.Demand {
+            lock.lock()
+            guard downstream != nil else {
+                lock.unlock()
+                return .none
+            }
+
+            statistics.add(input)
+
+            let summary = (strategy == .everyTime || statistics.isFull) ? statistics.summary : nil
+            lock.unlock()
+
+            if let summary = summary {
+                outputs.offer(summary)
+            }
+
+            return .none
+        }
+
+        func receive(completion: Subscribers.Completion<Failure>) {
+            lock.lock()
+            guard let downstream = downstream else {
+                lock.unlock()
+                return
+            }
+            self.downstream = nil
+            self.subscription = nil
+            lock.unlock()
+
+            downstream.receive(completion: completion)
+        }
+
+        func request(_ demand: Subscribers.Demand) {
+            outputs.request(demand)
+        }
+
+        func cancel() {
+            lock.lock()
+            let subscription = self.subscription
+            downstream = nil
+            self.subscription = nil
+            statistics.reset()
+            lock.unlock()
+
+            outputs.reset()
+            subscription?.cancel()
+        }
+    }
+}
@@ -0,0 +1,342 @@
+//
+//  MonteCarloHarness.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+/// Evaluates the controller on a mission over many randomized closed-loop simulations.
+///
+/// Every run flies the mission with its own `QuadrotorSimulator` connected to its own `Tello`.
+/// Noise, latencies, gusts and drag are drawn per run from `Randomization`. Run `i` always draws
+/// the same values for the same `seed`, so two configurations, e.g. two gain sets,
+/// are compared on exactly the same disturbances.
+///
+/// Runs are independent and are spread over all cores: `DispatchQueue.concurrentPerform` hands out
+/// the runs one by one to the worker threads, so threads finishing short runs take over the remaining ones.
+///
+/// - Remark: `evaluate` blocks until all runs finish. Call it from a background queue,
+///   so the main queue keeps delivering the `Sensor` values of the simulated drones.
+public struct MonteCarloHarness {
+    /// Mission step. Steps run in order, each until it finishes or times out.
+    public enum Step {
+        /// Automatic takeoff, finishes when hovering.
+        case takeoff
+        /// Position controller target, finishes when converged.
+        case goTo(QuadrotorPose)
+        /// Minimum-snap trajectory through the waypoints, finishes when converged at the last one.
+        case waypoints([QuadrotorPose], Trajectory.Limits)
+        /// Keeps flying for the given number of seconds.
+        case hold(CFTimeInterval)
+        /// Automatic landing, finishes when landed.
+        case land
+    }
+
+    /// Ranges the per-run parameters are uniformly drawn from.
+    public struct Randomization {
+        /// Scale of all sensor noise standard deviations.
+        public var noiseScale: ClosedRange<Double> = 0.5...2.0
+        /// Scale of all sensor latencies.
+        public var latencyScale: ClosedRange<Double> = 0.5...1.5
+        /// Time from sending the sticks to the drone reacting, s.
+        public var commandLatency: ClosedRange<Double> = 0.03...0.1
+        /// Standard deviation of the gust acceleration, m/s^2.
+        public var gustAcceleration: ClosedRange<Double> = 0.0...0.2
+        /// Scale of the drag, i.e. mismatch of the drone response.
+        public var dragScale: ClosedRange<Double> = 0.8...1.2
+
+        public init() {}
+    }
+
+    /// Harness parameters.
+    public struct Configuration {
+        /// Number of runs.
+        public var runs: Int = 1000
+        /// Seed of the first run, the following runs use the next seeds.
+        public var seed: UInt64 = 0
+        /// Nominal simulator configuration, randomized per run.
+        public var simulator = QuadrotorSimulator.Configuration()
+        public var randomization = Randomization()
+        /// Longest time a step may take, s. Longer steps fail the run.
+        public var stepTimeout: CFTimeInterval = 20.0
+        /// Time the overshoot is still measured for after convergence, s.
+        public var settleTime: CFTimeInterval = 1.0
+        /// Controllers to evaluate, the `Tello` defaults if `nil`.
+        public var pids: (x: Pid, y: Pid, z: Pid, yaw: Pid)?
+        /// Called with every simulated drone before the mission, e.g. to select the controller algorithm.
+        /// Called concurrently from several threads.
+        public var prepare: ((Tello) -> Void)?
+
+        public init() {}
+    }
+
+    /// Reasons a run failed.
+    public enum Failure {
+        /// The step did not finish within `stepTimeout`.
+        case timeout(step: Int)
+        /// The position sensor of the controller failed.
+        case sensorFailure(step: Int)
+        /// The trajectory could not be made.
+        case trajectoryRejected(step: Int)
+    }
+
+    /// Outcome of a single run.
+    public struct Run {
+        /// Run number.
+        public var index: Int
+        /// `nil` if the whole mission was flown.
+        public var failure: Failure?
+        /// Time from the command to the controller convergence, per `goTo` and `waypoints` step, s.
+        public var convergenceTimes: [Double] = []
+        /// Largest distance past the target along the move, per `goTo` and `waypoints` step, m.
+        public var overshoots: [Double] = []
+        /// Largest yaw past the target yaw, per `goTo` and `waypoints` step that turns, rad.
+        public var yawOvershoots: [Double] = []
+        /// Simulated duration, s.
+        public var duration: CFTimeInterval = 0.0
+    }
+
+    /// Distribution of a metric over the steps of the successful runs.
+    public struct Distribution {
+        public var count: Int
+        public var mean: Double
+        public var standardDeviation: Double
+        public var min: Double
+        public var median: Double
+        /// 95th percentile.
+        public var percentile95: Double
+        public var max: Double
+
+        init(_ values: [Double]) {
+            count = values.count
+            guard !values.isEmpty else {
+                (mean, standardDeviation, min, median, percentile95, max) = (.nan, .nan, .nan, .nan, .nan, .nan)
+                return
+            }
+
+            let sorted = values.sorted()
+            let n = Double(count)
+            let m = sorted.reduce(0.0, +) / n
+            mean = m
+            standardDeviation = (sorted.reduce(0.0) { $0 + ($1 - m) * ($1 - m) } / n).squareRoot()
+            min = sorted[0]
+            max = sorted[count - 1]
+            median = sorted[(count - 1) / 2]
+            percentile95 = sorted[Int((0.95 * Double(count - 1)).rounded())]
+        }
+    }
+
+    /// Aggregated results.
+    public struct Report {
+        /// All runs, in order.
+        public var runs: [Run]
+        /// Fraction of the runs that failed.
+        public var failureRate: Double
+        public var convergenceTime: Distribution
+        public var overshoot: Distribution
+        public var yawOvershoot: Distribution
+        /// Simulated time per wall-clock time.
+        public var speedup: Double
+    }
+
+    public var configuration: Configuration
+
+    public init(configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+    }
+
+    /// Flies the mission in every run, in parallel.
+    public func evaluate(_ mission: [Step]) -> Report {
+        let count = Swift.max(configuration.runs, 0)
+        let started = CACurrentMediaTime()
+
+        var runs = [Run](repeating: Run(index: 0), count: count)
+        runs.withUnsafeMutableBufferPointer { buffer in
+            DispatchQueue.concurrentPerform(iterations: count) { i in
+                buffer[i] = simulate(mission, index: i)
+            }
+        }
+
+        let wallTime = CACurrentMediaTime() - started
+        let succeeded = runs.filter { $0.failure == nil }
+        let simulated = runs.reduce(0.0) { $0 + $1.duration }
+
+        return Report(runs: runs,
+                      failureRate: count > 0 ? Double(count - succeeded.count) / Double(count) : 0.0,
+                      convergenceTime: Distribution(succeeded.flatMap { $0.convergenceTimes }),
+                      overshoot: Distribution(succeeded.flatMap { $0.overshoots }),
+                      yawOvershoot: Distribution(succeeded.flatMap { $0.yawOvershoots }),
+                      speedup: wallTime > 0.0 ? simulated / wallTime : .infinity)
+    }
+
+    /// Takes off, visits the poses in order and lands, in every run.
+    public func evaluate(goTo poses: [QuadrotorPose]) -> Report {
+        return evaluate([.takeoff] + poses.map { .goTo($0) } + [.land])
+    }
+
+    /// Simulator configuration of a run.
+    private func randomized(index: Int) -> QuadrotorSimulator.Configuration {
+        var rng = SeededRandom(seed: configuration.seed &+ UInt64(index))
+        let r = configuration.randomization
+        let draw = { (range: ClosedRange<Double>) -> Double in
+            range.lowerBound + (range.upperBound - range.lowerBound) * rng.uniform()
+        }
+
+        var sim = configuration.simulator
+        sim.seed = rng.next()
+
+        let noise = draw(r.noiseScale)
+        sim.imu.accelNoise *= noise
+        sim.imu.gyroNoise *= noise
+        sim.imu.attitudeNoise *= noise
+        sim.mvo.positionNoise *= noise
+        sim.mvo.velocityNoise *= noise
+        sim.vo.positionNoise *= noise
+        sim.vo.velocityNoise *= noise
+        sim.proximity.noise *= noise
+
+        let latency = draw(r.latencyScale)
+        sim.imu.latency *= latency
+        sim.mvo.latency *= latency
+        sim.vo.latency *= latency
+        sim.proximity.latency *= latency
+
+        sim.commandLatency = draw(r.commandLatency)
+        sim.dynamics.gustAcceleration = draw(r.gustAcceleration)
+        sim.dynamics.drag *= draw(r.dragScale)
+
+        return sim
+    }
+
+    /// Flies the mission in run `index`. Used by `GainOptimizer` to batch runs of several configurations.
+    func simulate(_ mission: [Step], index: Int) -> Run {
+        let simulator = QuadrotorSimulator(configuration: randomized(index: index))
+        let tello = Tello(transport: simulator)
+        var run = Run(index: index)
+
+        if let pids = configuration.pids {
+            tello.setControllerPids(x: pids.x, y: pids.y, z: pids.z, yaw: pids.yaw)
+        }
+        configuration.prepare?(tello)
+
+        // Observed on the simulation thread
+        var converged = false
+        var sensorFailed = false
+        let observation = tello.controller.state.observation { state in
+            switch state {
+            case .running(.converged):
+                converged = true
+            case .reset(.sensorFailure):
+                sensorFailed = true
+            default:
+                break
+            }
+        }
+        defer {
+            observation.cancel()
+            tello.disconnect()
+        }
+
+        tello.connect()
+
+        for (step, command) in mission.enumerated() {
+            converged = false
+            sensorFailed = false
+
+            var target: QuadrotorPose?
+            switch command {
+            case .takeoff:
+                _ = tello.takeoff()
+                guard simulator.run(until: { tello.flightState.value == .hovering }, timeout: configuration.stepTimeout) else {
+                    run.failure = .timeout(step: step)
+                    break
+                }
+            case .goTo(let pose):
+                tello.goTo(x: pose.x, y: pose.y, z: pose.z, yaw: pose.yaw)
+                target = pose
+            case .waypoints(let poses, let limits):
+                guard tello.goTo(waypoints: poses, limits: limits) else {
+                    run.failure = .trajectoryRejected(step: step)
+                    break
+                }
+                // Missing components keep the values of the previous waypoints
+                target = poses.reduce(QuadrotorPose()) { last, wp in
+                    QuadrotorPose(x: wp.x ?? last.x, y: wp.y ?? last.y, z: wp.z ?? last.z, yaw: wp.yaw ?? last.yaw)
+                }
+            case .hold(let duration):
+                simulator.run(for: duration)
+            case .land:
+                tello.land()
+                guard simulator.run(until: { tello.flightState.value == .landed }, timeout: configuration.stepTimeout) else {
+                    run.failure = .timeout(step: step)
+                    break
+                }
+            }
+
+            if let target = target, run.failure == nil {
+                run.failure = track(target, simulator: simulator, run: &run, step: step,
+                                    converged: { converged }, sensorFailed: { sensorFailed })
+            }
+            if run.failure != nil {
+                break
+            }
+        }
+
+        run.duration = simulator.now()
+        return run
+    }
+
+    /// Runs until the controller converges and then for `settleTime`, measuring the overshoot.
+    ///
+    /// - Returns: The failure, if any.
+    private func track(_ target: QuadrotorPose, simulator: QuadrotorSimulator, run: inout Run, step: Int,
+                       converged: () -> Bool, sensorFailed: () -> Bool) -> Failure? {
+        let start = simulator.state
+
+        // Overshoot along the commanded axes only
+        let goal = simd_double3(target.x ?? .nan, target.y ?? .nan, target.z ?? .nan)
+        let commanded = goal .== goal
+        let position = goal.replacing(with: 0.0, where: .!commanded)
+        let move = (position - start.position).replacing(with: 0.0, where: .!commanded)
+        let distance = simd_length(move)
+        let turn = target.yaw.map { remainder($0 - start.yaw, 2.0 * .pi) } ?? 0.0
+
+        var overshoot = 0.0
+        var yawOvershoot = 0.0
+        let measure = {
+            let s = simulator.state
+            if distance > 1e-6 {
+                overshoot = Swift.max(overshoot, simd_dot(s.position - position, move / distance))
+            }
+            if let yaw = target.yaw, turn != 0.0 {
+                yawOvershoot = Swift.max(yawOvershoot, remainder(s.yaw - yaw, 2.0 * .pi) * (turn > 0.0 ? 1.0 : -1.0))
+            }
+        }
+
+        let reached = simulator.run(until: {
+            measure()
+            return converged() || sensorFailed()
+        }, timeout: configuration.stepTimeout)
+
+        guard !sensorFailed() else { return .sensorFailure(step: step) }
+        guard reached else { return .timeout(step: step) }
+
+        run.convergenceTimes.append(simulator.now() - start.time)
+
+        simulator.run(until: {
+            measure()
+            return sensorFailed()
+        }, timeout: configuration.settleTime)
+
+        guard !sensorFailed() else { return .sensorFailure(step: step) }
+
+        run.overshoots.append(overshoot)
+        if turn != 0.0 {
+            run.yawOvershoots.append(yawOvershoot)
+        }
+        return nil
+    }
+}
@@ -0,0 +1,321 @@
+//
+//  MpcController.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import simd
+
+/// Linear model-predictive controller of four axes updated together as SIMD lanes: x, y, z, and yaw.
+///
+/// Each axis is modeled as a damped double integrator, the control accelerates the axis and
+/// the damping limits its speed. Over a receding horizon the controller minimizes position and
+/// velocity errors, control effort and control changes, subject to box constraints on the controls.
+///
+/// The quadratic program is condensed to the controls only and solved with FISTA (accelerated projected
+/// gradient), warm-started with the previous solution shifted by one step. All matrices are built
+/// at initialization and all buffers are preallocated, so `update` does not allocate.
+///
+/// Like `Pid4`, the time is passed explicitly. Not thread-safe, call it from one thread at a time.
+public final class MpcController {
+    /// Model, weights and solver parameters. Per-lane values are for x, y, z, and yaw.
+    public struct Configuration {
+        /// Number of prediction steps, clamped to `MpcController.horizonLimits`.
+        public var horizon: Int = 15
+        /// Prediction time step, s.
+        public var timeStep: Double = 0.1
+        /// Acceleration per unit of control, m/s^2 and rad/s^2.
+        public var inputGain: simd_double4 = simd_double4(2.0, 2.0, 2.0, 4.0)
+        /// Velocity damping, 1/s. Steady speed at full control is `inputGain / damping`.
+        /// Zero makes a pure double integrator.
+        public var damping: simd_double4 = simd_double4(2.0, 2.0, 2.0, 3.0)
+        /// Weight of position errors.
+        public var positionWeight: simd_double4 = .one
+        /// Weight of velocity errors.
+        public var velocityWeight: simd_double4 = simd_double4(repeating: 0.1)
+        /// Weight of control effort.
+        public var controlWeight: simd_double4 = simd_double4(repeating: 0.01)
+        /// Weight of control changes between steps, smooths the output.
+        public var controlRateWeight: simd_double4 = simd_double4(repeating: 0.1)
+        /// Controls are bounded to [`-maxControl`; `maxControl`], at most 1 (full stick).
+        public var maxControl: simd_double4 = .one
+        /// Largest number of solver iterations per update.
+        public var maxIterations: Int = 50
+        /// The solver stops when no control changes by more than the tolerance.
+        public var tolerance: Double = 1e-4
+
+        public init() {}
+    }
+
+    /// Allowed horizon lengths.
+    public static let horizonLimits: ClosedRange<Int> = 10...20
+
+    /// Controller configuration. Make a new controller to change it.
+    public let configuration: Configuration
+    /// Number of prediction steps.
+    public let horizon: Int
+
+    /// Solver iterations of the latest update.
+    public private(set) var iterations: Int = 0
+
+    private let maxControl: simd_double4
+    // Gradient step of each lane, inverse of the largest eigenvalue of the Hessian
+    private let step: simd_double4
+
+    // Hessian, `horizon` x `horizon`, row-major
+    private let hessian: UnsafeMutablePointer<simd_double4>
+    // Response of position and velocity at step `m` to a control applied at step 0: A^m * B
+    private let gainPos: UnsafeMutablePointer<simd_double4>
+    private let gainVel: UnsafeMutablePointer<simd_double4>
+    // Free response: A^k = [[1, freePos[k]], [0, freeVel[k]]]
+    private let freePos: UnsafeMutablePointer<simd_double4>
+    private let freeVel: UnsafeMutablePointer<simd_double4>
+
+    // Solver buffers
+    private let controls: UnsafeMutablePointer<simd_double4>
+    private let momentum: UnsafeMutablePointer<simd_double4>
+    private let iterate: UnsafeMutablePointer<simd_double4>
+    private let linear: UnsafeMutablePointer<simd_double4>
+    private let errorPos: UnsafeMutablePointer<simd_double4>
+    private let errorVel: UnsafeMutablePointer<simd_double4>
+
+    private var lastControl: simd_double4 = .zero
+    private var lastTime: simd_double4 = .zero
+    // Velocity predicted with the model, used for lanes without measured velocity
+    private var predictedVelocity: simd_double4 = .zero
+    private var started: Pid4Mask = .init(repeating: false)
+
+    public init(configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+
+        let n = configuration.horizon.clamped(to: MpcController.horizonLimits)
+        let dt = configuration.timeStep
+        horizon = n
+        maxControl = simd_clamp(configuration.maxControl, .zero, .one)
+
+        let hessian = UnsafeMutablePointer<simd_double4>.allocate(capacity: n * n)
+        let gainPos = UnsafeMutablePointer<simd_double4>.allocate(capacity: n)
+        let gainVel = UnsafeMutablePointer<simd_double4>.allocate(capacity: n)
+        let freePos = UnsafeMutablePointer<simd_double4>.allocate(capacity: n + 1)
+        let freeVel = UnsafeMutablePointer<simd_double4>.allocate(capacity: n + 1)
+
+        // Discrete model: p' = p + dt * v + b1 * u, v' = d * v + b2 * u
+        let d = 1.0 - configuration.damping * dt
+        let b1 = 0.5 * configuration.inputGain * dt * dt
+        let b2 = configuration.inputGain * dt
+
+        var pos = simd_double4.zero
+        var vel = simd_double4.one
+        for k in 0...n {
+            freePos.advanced(by: k).initialize(to: pos)
+            freeVel.advanced(by: k).initialize(to: vel)
+            if k < n {
+                gainPos.advanced(by: k).initialize(to: b1 + pos * b2)
+                gainVel.advanced(by: k).initialize(to: vel * b2)
+            }
+            pos += dt * vel
+            vel *= d
+        }
+
+        // H = G^T * Q * G + R + S * D^T * D, where D differentiates the controls
+        let qp = configuration.positionWeight
+        let qv = configuration.velocityWeight
+        let s = configuration.controlRateWeight
+        for i in 0..<n {
+            for j in 0..<n {
+                var h = simd_double4.zero
+                for k in (Swift.max(i, j) + 1)...n {
+                    h += qp * gainPos[k - 1 - i] * gainPos[k - 1 - j] + qv * gainVel[k - 1 - i] * gainVel[k - 1 - j]
+                }
+                if i == j {
+                    h += configuration.controlWeight + (i < n - 1 ? 2.0 * s : s)
+                } else if abs(i - j) == 1 {
+                    h -= s
+                }
+                hessian.advanced(by: i * n + j).initialize(to: h)
+            }
+        }
+
+        // Small margin for the unconverged power iteration
+        step = 1.0 / (1.05 * MpcController.largestEigenvalue(hessian, size: n))
+
+        self.hessian = hessian
+        self.gainPos = gainPos
+        self.gainVel = gainVel
+        self.freePos = freePos
+        self.freeVel = freeVel
+
+        controls = .allocate(capacity: n)
+        momentum = .allocate(capacity: n)
+        iterate = .allocate(capacity: n)
+        linear = .allocate(capacity: n)
+        errorPos = .allocate(capacity: n + 1)
+        errorVel = .allocate(capacity: n + 1)
+
+        controls.initialize(repeating: .zero, count: n)
+        momentum.initialize(repeating: .zero, count: n)
+        iterate.initialize(repeating: .zero, count: n)
+        linear.initialize(repeating: .zero, count: n)
+        errorPos.initialize(repeating: .zero, count: n + 1)
+        errorVel.initialize(repeating: .zero, count: n + 1)
+    }
+
+    /// Largest eigenvalue of each lane of a symmetric positive definite matrix, by power iteration.
+    private static func largestEigenvalue(_ matrix: UnsafeMutablePointer<simd_double4>, size n: Int) -> simd_double4 {
+        var vector = [simd_double4](repeating: .one, count: n)
+        var product = [simd_double4](repeating: .zero, count: n)
+        var norm = simd_double4.one
+
+        for _ in 0..<100 {
+            var sum = simd_double4.zero
+            for i in 0..<n {
+                var h = simd_double4.zero
+                for j in 0..<n {
+                    h += matrix[i * n + j] * vector[j]
+                }
+                product[i] = h
+                sum += h * h
+            }
+            norm = sum.squareRoot()
+            for i in 0..<n {
+                vector[i] = product[i] / norm
+            }
+        }
+
+        return norm
+    }
+
+    deinit {
+        hessian.deallocate()
+        gainPos.deallocate()
+        gainVel.deallocate()
+        freePos.deallocate()
+        freeVel.deallocate()
+        controls.deallocate()
+        momentum.deallocate()
+        iterate.deallocate()
+        linear.deallocate()
+        errorPos.deallocate()
+        errorVel.deallocate()
+    }
+
+    /// Clears the warm start and the model state of the given lanes.
+    public func reset(_ lanes: Pid4Mask = .init(repeating: true)) {
+        for k in 0..<horizon {
+            controls[k].replace(with: .zero, where: lanes)
+        }
+        lastControl.replace(with: .zero, where: lanes)
+        lastTime.replace(with: .zero, where: lanes)
+        predictedVelocity.replace(with: .zero, where: lanes)
+        started = started .& .!lanes
+    }
+
+    /// Calculates the controls of the active lanes.
+    ///
+    /// The reference over the horizon is extrapolated from the set point with constant acceleration.
+    ///
+    /// - Parameters:
+    ///   - setPoint: Desired (target) values of the process variables.
+    ///   - velocitySetPoint: Desired rates of the process variables.
+    ///   - accelerationSetPoint: Desired accelerations of the process variables.
+    ///   - measured: Actual values of the process variables.
+    ///   - measuredVelocity: Actual rates of the process variables. NaN lanes use the model prediction.
+    ///   - mask: Lanes to update. Lanes with NaN set point or measurement are skipped as well.
+    ///   - time: Time of the measurement, in seconds.
+    /// - Returns: Controls of the first step, within [`-maxControl`; `maxControl`]. Skipped lanes are zero.
+    public func update(setPoint: simd_double4,
+                       velocitySetPoint: simd_double4 = .zero,
+                       accelerationSetPoint: simd_double4 = .zero,
+                       measured: simd_double4,
+                       measuredVelocity: simd_double4,
+                       mask: Pid4Mask = .init(repeating: true),
+                       at time: Double) -> simd_double4 {
+        let n = horizon
+        let dt = configuration.timeStep
+
+        // NaN is not equal to itself
+        let active = mask .& (setPoint .== setPoint) .& (measured .== measured)
+        reset(.!active .& started)
+        guard any(active) else { return .zero }
+
+        // Propagate the model since the previous update
+        let elapsed = (time - lastTime).replacing(with: 0.0, where: .!started)
+        predictedVelocity += (configuration.inputGain * lastControl - configuration.damping * predictedVelocity) * elapsed
+        predictedVelocity.replace(with: measuredVelocity, where: measuredVelocity .== measuredVelocity)
+
+        // Inactive lanes solve a zero problem
+        let p0 = measured.replacing(with: 0.0, where: .!active)
+        let v0 = predictedVelocity.replacing(with: 0.0, where: .!active)
+        let sp = setPoint.replacing(with: 0.0, where: .!active)
+        let vs = velocitySetPoint.replacing(with: 0.0, where: .!(active .& (velocitySetPoint .== velocitySetPoint)))
+        let acc = accelerationSetPoint.replacing(with: 0.0, where: .!(active .& (accelerationSetPoint .== accelerationSetPoint)))
+
+        // Free response errors
+        for k in 1...n {
+            let t = Double(k) * dt
+            errorPos[k] = p0 + freePos[k] * v0 - (sp + vs * t + 0.5 * acc * t * t)
+            errorVel[k] = freeVel[k] * v0 - (vs + acc * t)
+        }
+
+        // Linear term: G^T * Q * e - S * u_prev
+        let qp = configuration.positionWeight
+        let qv = configuration.velocityWeight
+        for j in 0..<n {
+            var f = simd_double4.zero
+            for k in (j + 1)...n {
+                f += qp * gainPos[k - 1 - j] * errorPos[k] + qv * gainVel[k - 1 - j] * errorVel[k]
+            }
+            linear[j] = f
+        }
+        linear[0] -= configuration.controlRateWeight * lastControl
+
+        // Warm start: previous solution shifted by one step
+        for k in 0..<(n - 1) {
+            controls[k] = controls[k + 1]
+        }
+        for k in 0..<n {
+            controls[k] = simd_clamp(controls[k], -maxControl, maxControl)
+            momentum[k] = controls[k]
+        }
+
+        // FISTA
+        var t = 1.0
+        iterations = 0
+        while iterations < configuration.maxIterations {
+            iterations += 1
+
+            let tNext = (1.0 + (1.0 + 4.0 * t * t).squareRoot()) / 2.0
+            let beta = (t - 1.0) / tNext
+            var change = simd_double4.zero
+
+            // Gradient step from the momentum point, then projection onto the box
+            for i in 0..<n {
+                var grad = linear[i]
+                for j in 0..<n {
+                    grad += hessian[i * n + j] * momentum[j]
+                }
+                let next = simd_clamp(momentum[i] - step * grad, -maxControl, maxControl)
+                iterate[i] = next
+                change = simd_max(change, simd_abs(next - controls[i]))
+            }
+            for i in 0..<n {
+                momentum[i] = iterate[i] + beta * (iterate[i] - controls[i])
+                controls[i] = iterate[i]
+            }
+
+            t = tNext
+            if change.max() < configuration.tolerance {
+                break
+            }
+        }
+
+        let u = controls[0].replacing(with: 0.0, where: .!active)
+
+        lastControl = u
+        lastTime.replace(with: simd_double4(repeating: time), where: active)
+        started = started .| active
+
+        return u
+    }
+}
@@ -11,9 +11,9 @@ import QuartzCore.CoreAnimation
 
 /// Implementation of a simple [Proportional-Integral-Derivative](https://en.wikipedia.org/wiki/PID_controller) (PID) controller with a deadband.
 ///
-/// - Remark: The controller uses wall-time clock to estimate the time
-/// between measurements to calculate the integrals and derivatives, and
-/// therefore can be only used for online control.
+/// - Remark: Unless the time is passed explicitly, the controller uses wall-time clock
+/// to estimate the time between measurements to calculate the integrals and derivatives.
+/// See also `Pid4` for updating four controllers at once.
 public class Pid: Hashable {
     public static func == (lhs: Pid, rhs: Pid) -> Bool {
         return (lhs.gains == rhs.gains) && (lhs.deadband == rhs.deadband)
@@ -40,8 +40,10 @@ public class Pid: Hashable {
     /// Indicates that error converged to dead band interval.
     public private(set) var converged: Bool
 
-    private var windowSize: Int
-    private var ringBuf: RingBuffer<Double>
+    /// Number of last samples to consider when calculating convergence.
+    public private(set) var windowSize: Int
+    // Running statistics of the last `windowSize` errors, O(1) per update
+    private var errorWindow: WindowedStatistics<Double>
 
     /// Proportional (P) gain of the controller. Must be more than or equal to zero.
     ///
@@ -145,7 +147,7 @@ public class Pid: Hashable {
         self.deadband = deadband
         self.converged = false
         self.windowSize = windowSize
-        self.ringBuf = RingBuffer(count: windowSize)
+        self.errorWindow = WindowedStatistics(size: windowSize)
     }
 
     /// Convenience initializer. Creates PID controller with gains specified as elements of array.
@@ -190,7 +192,8 @@ public class Pid: Hashable {
         lastTime = nil
         integralError = nil
         converged = false
-        ringBuf = RingBuffer(count: ringBuf.size)
+        // Keeps the storage
+        errorWindow.reset()
     }
 
     /// Calculates the correction based on the desired and the actual values of the process variable.
@@ -200,17 +203,29 @@ public class Pid: Hashable {
     ///   - measuredValue: Actual value of the process variable.
     /// - Returns: Corrected value of the control variable.
     public func update(setPoint: Double, measuredValue: Double) -> Double {
-        // FIXME: Pass current time as a parameter / evaluate from user-specified closure
-        let now = CACurrentMediaTime()
+        return update(setPoint: setPoint, measuredValue: measuredValue, at: CACurrentMediaTime())
+    }
+
+    /// Calculates the correction based on the desired and the actual values of the process variable
+    /// measured at the given time.
+    ///
+    /// Use this method for simulation and replay, where the wall-time clock does not apply.
+    ///
+    /// - Parameters:
+    ///   - setPoint: Desired (target) value of the process variable.
+    ///   - measuredValue: Actual value of the process variable.
+    ///   - now: Time of the measurement, in seconds.
+    /// - Returns: Corrected value of the control variable.
+    public func update(setPoint: Double, measuredValue: Double, at now: CFTimeInterval) -> Double {
         let error: Double = setPoint - measuredValue
         var avgError: Double = .infinity
 
-        // Wait until the buffer is full
-        if ringBuf.isFull {
-            avgError = ringBuf.average()
-            _ = ringBuf.read()
+        // Wait until the window is full
+        if errorWindow.isFull {
+            avgError = errorWindow.mean
         }
-        ringBuf.write(error)
+        // The oldest error leaves the window
+        errorWindow.add(error)
 
         self.converged = (-deadband...deadband).contains(avgError)
 
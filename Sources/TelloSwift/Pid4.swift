@@ -0,0 +1,202 @@
+//
+//  Pid4.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import simd
+
+/// Lane mask of `Pid4`. Lanes are x, y, z, and yaw.
+public typealias Pid4Mask = SIMDMask<simd_double4.MaskStorage>
+
+/// Four PID controllers with a deadband updated together as SIMD lanes: x, y, z, and yaw.
+///
+/// Each lane has its own gains, deadband and convergence window, and behaves exactly as `Pid`.
+/// Unlike `Pid`, the time is passed explicitly, so the controller is deterministic and can be used
+/// for simulation and replay of recorded flights. A lane updated again without the time moving on
+/// keeps its integral and derivative state, so repeated time stamps do not produce inf or NaN.
+public struct Pid4 {
+    /// Proportional gains.
+    public private(set) var p: simd_double4
+    /// Integral gains.
+    public private(set) var i: simd_double4
+    /// Derivative gains.
+    public private(set) var d: simd_double4
+    /// Errors within [`-deadband`; `deadband`] are considered converged.
+    public private(set) var deadband: simd_double4
+    /// Number of last errors to average when checking convergence, per lane.
+    public private(set) var windowSize: SIMD4<Int>
+
+    /// Lanes which average error converged to the deadband.
+    public private(set) var converged: Pid4Mask = .init(repeating: false)
+
+    public private(set) var lastError: simd_double4 = .zero
+    public private(set) var lastDError: simd_double4 = .zero
+    public private(set) var integralError: simd_double4 = .zero
+
+    private var lastTime: simd_double4 = .zero
+    // Lanes that have been updated at least once since reset
+    private var started: Pid4Mask = .init(repeating: false)
+
+    // Error history, each lane uses its own `windowSize` latest entries
+    private var history: [simd_double4]
+    private var head: SIMD4<Int> = .zero
+    private var count: SIMD4<Int> = .zero
+    private var windowSum: simd_double4 = .zero
+
+    /// Creates the controller with gains of four `Pid` controllers.
+    public init(x: Pid, y: Pid, z: Pid, yaw: Pid) {
+        p = .zero
+        i = .zero
+        d = .zero
+        deadband = .zero
+        windowSize = .one
+        history = []
+
+        sync(x: x, y: y, z: z, yaw: yaw)
+    }
+
+    /// Copies gains, deadbands and window sizes from `Pid` controllers.
+    ///
+    /// Only the lanes whose parameters have changed are reset.
+    public mutating func sync(x: Pid, y: Pid, z: Pid, yaw: Pid) {
+        var changed = Pid4Mask(repeating: false)
+        changed[0] = sync(lane: 0, with: x)
+        changed[1] = sync(lane: 1, with: y)
+        changed[2] = sync(lane: 2, with: z)
+        changed[3] = sync(lane: 3, with: yaw)
+
+        let capacity = windowSize.max()
+        if history.count < capacity {
+            // Happens only when a window grows
+            history = [simd_double4](repeating: .zero, count: capacity)
+            changed = .init(repeating: true)
+        }
+
+        if any(changed) {
+            reset(changed)
+        }
+    }
+
+    private mutating func sync(lane: Int, with pid: Pid) -> Bool {
+        guard p[lane] != pid.p || i[lane] != pid.i || d[lane] != pid.d
+              || deadband[lane] != pid.deadband || windowSize[lane] != Swift.max(pid.windowSize, 1) else { return false }
+
+        p[lane] = pid.p
+        i[lane] = pid.i
+        d[lane] = pid.d
+        deadband[lane] = pid.deadband
+        windowSize[lane] = Swift.max(pid.windowSize, 1)
+
+        return true
+    }
+
+    /// Resets the integral, derivative and convergence of the given lanes.
+    public mutating func reset(_ lanes: Pid4Mask = .init(repeating: true)) {
+        lastError.replace(with: .zero, where: lanes)
+        lastDError.replace(with: .zero, where: lanes)
+        integralError.replace(with: .zero, where: lanes)
+        lastTime.replace(with: .zero, where: lanes)
+        windowSum.replace(with: .zero, where: lanes)
+        head.replace(with: .zero, where: lanes)
+        count.replace(with: .zero, where: lanes)
+        started = started .& .!lanes
+        converged = converged .& .!lanes
+    }
+
+    /// Calculates the corrections of the active lanes.
+    ///
+    /// - Parameters:
+    ///   - setPoint: Desired (target) values of the process variables.
+    ///   - measured: Actual values of the process variables.
+    ///   - mask: Lanes to update. Lanes with NaN set point or measurement are skipped as well.
+    ///   - time: Time of the measurement, in seconds.
+    /// - Returns: Corrections of the control variables. Skipped lanes are zero.
+    public mutating func update(setPoint: simd_double4, measured: simd_double4, mask: Pid4Mask = .init(repeating: true), at time: Double) -> simd_double4 {
+        return update(setPoint: setPoint, measured: measured, velocityError: simd_double4(repeating: .nan), mask: mask, at: time)
+    }
+
+    /// Calculates the corrections of the active lanes tracking a moving set point.
+    ///
+    /// The derivative term acts on the velocity error instead of the difference of position errors,
+    /// which avoids differentiating noisy measurements. Lanes with NaN velocities fall back to
+    /// the difference of errors, as in `update(setPoint:measured:mask:at:)`.
+    ///
+    /// - Parameters:
+    ///   - setPoint: Desired (target) values of the process variables.
+    ///   - measured: Actual values of the process variables.
+    ///   - velocitySetPoint: Desired rates of the process variables.
+    ///   - measuredVelocity: Actual rates of the process variables.
+    ///   - mask: Lanes to update. Lanes with NaN set point or measurement are skipped as well.
+    ///   - time: Time of the measurement, in seconds.
+    /// - Returns: Corrections of the control variables. Skipped lanes are zero.
+    public mutating func update(setPoint: simd_double4, measured: simd_double4,
+                                velocitySetPoint: simd_double4, measuredVelocity: simd_double4,
+                                mask: Pid4Mask = .init(repeating: true), at time: Double) -> simd_double4 {
+        return update(setPoint: setPoint, measured: measured, velocityError: velocitySetPoint - measuredVelocity, mask: mask, at: time)
+    }
+
+    private mutating func update(setPoint: simd_double4, measured: simd_double4, velocityError: simd_double4, mask: Pid4Mask, at time: Double) -> simd_double4 {
+        // NaN is not equal to itself
+        let active = mask .& (setPoint .== setPoint) .& (measured .== measured)
+        guard any(active) else { return .zero }
+
+        let error = setPoint - measured
+
+        // Convergence over the previous `windowSize` errors, as in `Pid`
+        for lane in 0..<4 where active[lane] {
+            let size = windowSize[lane]
+            let slot = head[lane] % history.count
+
+            if count[lane] >= size {
+                converged[lane] = abs(windowSum[lane] / Double(size)) <= deadband[lane]
+                // The oldest error leaves the window
+                windowSum[lane] -= history[(head[lane] - size + history.count) % history.count][lane]
+            } else {
+                converged[lane] = false
+                count[lane] += 1
+            }
+
+            history[slot][lane] = error[lane]
+            windowSum[lane] += error[lane]
+            head[lane] = (head[lane] + 1) % history.count
+
+            if head[lane] == 0 {
+                // Get rid of accumulated rounding errors once per turn
+                var sum = 0.0
+                for k in 0..<Swift.min(count[lane], size) {
+                    sum += history[(history.count - 1 - k)][lane]
+                }
+                windowSum[lane] = sum
+            }
+        }
+
+        let dE = (error - lastError).replacing(with: 0.0, where: .!started)
+        let dt = time - lastTime
+
+        // No time has passed since the previous update of these lanes: dividing by `dt` would give inf or NaN,
+        // so they keep their integral and their previous error until the time moves on
+        let stale = active .& started .& (dt .<= 0.0)
+        let advanced = active .& .!stale
+
+        // Integral and derivative start contributing on the second update
+        integralError.replace(with: integralError + dE * dt, where: advanced .& started)
+
+        // Velocity error is available from the first update
+        let hasVelocity = active .& (velocityError .== velocityError)
+        var derivative = (d * dE / dt).replacing(with: 0.0, where: stale)
+        derivative.replace(with: d * velocityError, where: hasVelocity)
+
+        var res = p * error
+        res.replace(with: res + i * integralError, where: started)
+        res.replace(with: res + derivative, where: started .| hasVelocity)
+
+        lastError.replace(with: error, where: advanced)
+        lastDError.replace(with: dE, where: advanced)
+        lastTime.replace(with: simd_double4(repeating: time), where: advanced)
+        started = started .| active
+
+        return res.replacing(with: 0.0, where: .!active)
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  PosePredictor.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+
+/// Predicts the drone state at the moment a command takes effect.
+///
+/// Measurements arrive at 5-10 Hz and are already delayed by the link, and the command sent now
+/// reaches the drone one link latency later. The predictor propagates the latest estimate of
+/// `StateEstimator` with its velocity and acceleration to the send time plus the link latency.
+///
+/// The link latency is a one-shot estimate: Tello acknowledges only the connection request,
+/// so it is half the round trip of the handshake and is not tracked during the flight.
+/// Use `additionalLatency` to account for a link that is slower than when connecting.
+public final class PosePredictor {
+    /// Estimator to propagate.
+    public let estimator: StateEstimator
+
+    /// Latency added on top of the measured link latency, e.g. actuation delay. In seconds.
+    public var additionalLatency: CFTimeInterval {
+        get { latency.load().additional }
+        set { latency.update { $0.additional = newValue } }
+    }
+
+    /// One-way link latency measured at connection, in seconds.
+    public var linkLatency: CFTimeInterval {
+        return latency.load().link
+    }
+
+    /// Longest prediction horizon. Longer horizons amplify acceleration noise too much.
+    public var maxHorizon: CFTimeInterval = 0.3
+
+    private struct Latency {
+        var link: CFTimeInterval
+        var additional: CFTimeInterval
+    }
+
+    // Written on the network thread, read by the keep-alive timer
+    private let latency = SeqLock(Latency(link: 0.0, additional: 0.0))
+
+    public init(estimator: StateEstimator) {
+        self.estimator = estimator
+    }
+
+    /// Sets the link latency from a round-trip time, e.g. between a request and its acknowledgement.
+    ///
+    /// Replaces the previous estimate.
+    public func setRoundTrip(_ rtt: CFTimeInterval) {
+        guard rtt >= 0.0 else { return }
+
+        latency.update { $0.link = rtt / 2.0 }
+    }
+
+    /// Returns the state at the moment a command sent at `time` reaches the drone.
+    public func predict(sendTime time: CFTimeInterval = CACurrentMediaTime()) -> EstimatedState? {
+        let l = latency.load()
+        let horizon = (l.link + l.additional).clamped(to: 0.0...maxHorizon)
+
+        return estimator.estimate(at: time + horizon)
+    }
+}
@@ -9,11 +9,12 @@
 import Foundation
 import Combine
 import simd
+import QuartzCore.CoreAnimation
 
 import Transform
 
 /// Quadrotor controls
-public struct QuadrotorControls: Equatable, CustomDebugStringConvertible {
+public struct QuadrotorControls: Equatable, Codable, CustomDebugStringConvertible {
     /// Rotation around X-axis (positive counter-clockwise)
     public var roll: Double?
     /// Rotation around Y-axis (positive counter-clockwise)
@@ -148,12 +149,99 @@ public struct QuadrotorPose: Equatable, CustomDebugStringConvertible {
     }
 }
 
+/// Timed reference for the tracking mode of `PositionController`. Lanes are x, y, z, and yaw.
+public struct TrackingReference {
+    /// Time the reference is valid at, `CACurrentMediaTime()` time base.
+    public var time: CFTimeInterval
+    /// Desired position and yaw, in controller frame.
+    public var position: simd_double4
+    /// Desired velocity and yaw rate, in controller frame.
+    public var velocity: simd_double4
+    /// Desired acceleration and yaw acceleration, in controller frame.
+    public var acceleration: simd_double4
+
+    public init(time: CFTimeInterval, position: simd_double4, velocity: simd_double4 = .zero, acceleration: simd_double4 = .zero) {
+        self.time = time
+        self.position = position
+        self.velocity = velocity
+        self.acceleration = acceleration
+    }
+
+    /// Desired pose.
+    public var pose: QuadrotorPose {
+        return QuadrotorPose(x: position.x, y: position.y, z: position.z, yaw: position.w)
+    }
+
+    /// Extrapolates the reference with constant acceleration.
+    ///
+    /// Past `horizon` seconds the reference stops where it was at the horizon.
+    /// The yaw is not wrapped, so a reference turning past pi stays continuous.
+    public func extrapolated(to time: CFTimeInterval, horizon: CFTimeInterval) -> TrackingReference {
+        let dt = (time - self.time).clamped(to: 0.0...horizon)
+        var res = TrackingReference(time: time,
+                                    position: position + velocity * dt + 0.5 * acceleration * dt * dt,
+                                    velocity: velocity + acceleration * dt,
+                                    acceleration: acceleration)
+
+        if time - self.time > horizon {
+            res.velocity = .zero
+            res.acceleration = .zero
+        }
+        return res
+    }
+}
+
 /// Position controller for a quadrotor.
 ///
 /// Takes 3D position and orientation in horizontal plane (`x`, `y`, `z`, and `yaw`) as input
 /// and outputs four velocity controls (`roll`, `pitch`, `yaw`, and `thrust`).
 /// Each control axis uses its own independent PID controller.
+///
+/// When following a trajectory or a reference set with `setReference(_:)`, the controller runs in tracking mode:
+/// the derivative terms act on the velocity error, using measured velocity instead of differentiating
+/// the position, and the reference velocity and acceleration are fed forward to the controls.
 public class PositionController {
+    /// Algorithm that computes the controls.
+    public enum Algorithm {
+        /// Four PID controllers, see `pid`.
+        case pid
+        /// Model-predictive controller.
+        ///
+        /// The PIDs still run alongside to report convergence with their deadbands and windows.
+        case mpc(MpcController)
+    }
+
+    /// Replaces the corrections of some lanes, e.g. to excite the drone for autotuning.
+    ///
+    /// Called on every update with the set point and the measurement in body frame, and the time.
+    /// Returns the lanes to replace and their corrections.
+    public typealias ControlOverride = (_ setPoint: simd_double4, _ measured: simd_double4, _ time: CFTimeInterval) -> (lanes: Pid4Mask, corrections: simd_double4)
+
+    /// Feed-forward gains of the tracking mode, per lane: x, y, z, and yaw.
+    public struct FeedForward {
+        /// Controls per unit of reference velocity, m/s and rad/s.
+        public var velocity: simd_double4
+        /// Controls per unit of reference acceleration, m/s^2 and rad/s^2.
+        public var acceleration: simd_double4
+
+        /// Inverts the first-order response of the drone to the sticks: the velocity gain is the inverse
+        /// of the stick gain, and the acceleration gain is the velocity gain times the response time.
+        ///
+        /// The defaults model a Tello in slow mode. With `.zero` only the PIDs act.
+        public init(dynamics: QuadrotorSimulator.Dynamics = QuadrotorSimulator.Dynamics()) {
+            velocity = 1.0 / dynamics.stickGain
+            acceleration = velocity * dynamics.responseTime
+        }
+
+        public init(velocity: simd_double4, acceleration: simd_double4) {
+            self.velocity = velocity
+            self.acceleration = acceleration
+        }
+
+        /// No feed-forward.
+        public static let zero = FeedForward(velocity: .zero, acceleration: .zero)
+    }
+
     /// PID controllers for four control axes
     public struct Pid3D {
         var x: Pid
@@ -187,8 +275,14 @@ public class PositionController {
     public private(set) var state: Sensor<State>
 
     /// Controllers for each control axis
+    ///
+    /// Hold the gains, deadbands and window sizes only. The axes are updated together by a `Pid4` engine,
+    /// which picks up changes to these on the next update and keeps the integral and derivative state itself,
+    /// so the state of these controllers, e.g. as returned by `Tello.getControllerPids()`, stays unused.
     public var pid: Pid3D
 
+    private var engine: Pid4
+
     /// User-specified target pose (read-only). To set the target use `setTarget()`.
     public private(set) var target: Sensor<QuadrotorPose>
     ///
@@ -221,6 +315,69 @@ public class PositionController {
 
     private var stateSub: AnyCancellable?
 
+    /// Feed-forward gains of the tracking mode. Not used by the MPC, which has the reference in its model.
+    public var feedForward = FeedForward()
+
+    /// Algorithm that computes the controls. Changing it resets the MPC.
+    public var algorithm: Algorithm {
+        get {
+            referenceLock.lock()
+            defer { referenceLock.unlock() }
+            return currentAlgorithm
+        }
+        set {
+            referenceLock.lock()
+            currentAlgorithm = newValue
+            pendingReset.mpc = true
+            referenceLock.unlock()
+        }
+    }
+
+    /// Shortest interval between notifications of `input` and `output` by `update(position:orientation:at:)`, in seconds.
+    public var publishInterval: CFTimeInterval = 0.1
+
+    /// Longest time to extrapolate a reference set with `setReference(_:)`, in seconds.
+    public var referenceHorizon: CFTimeInterval = 0.5
+
+    /// Overrides the corrections of some lanes. The controller does not report convergence while any lane is overridden.
+    ///
+    /// The closure is called on the thread that updates the controller.
+    public var controlOverride: ControlOverride? {
+        get {
+            referenceLock.lock()
+            defer { referenceLock.unlock() }
+            return currentOverride
+        }
+        set {
+            referenceLock.lock()
+            currentOverride = newValue
+            referenceLock.unlock()
+        }
+    }
+
+    // Trajectory being followed and the time it was started at, or a tracked reference
+    private var trajectory: Trajectory?
+    private var trajectoryStart: CFTimeInterval?
+    private var tracking: TrackingReference?
+    private var currentAlgorithm: Algorithm = .pid
+    private var currentOverride: ControlOverride?
+    private var pendingReset = PendingReset()
+    private let referenceLock = NSLock()
+
+    /// Resets requested from other threads, applied by the thread that updates the controller.
+    private struct PendingReset {
+        var engine = false
+        var mpc = false
+        var velocity = false
+        var target: QuadrotorPose?
+    }
+
+    // Time `input` and `output` were last published by the throttled update
+    private var lastPublication: CFTimeInterval = -.infinity
+
+    // Latest measured velocity in odometry frame, NaN if unknown
+    private var velocity = simd_double3(repeating: .nan)
+
     private var posSensorFailCount: Int = 0
     private let posSensorFailThreshold: Int = 30
     private var posSensorFailed: Bool = false
@@ -234,6 +391,7 @@ public class PositionController {
     ///   - yaw: PID controller for Yaw (rotation around Z-axis)
     public init(x: Pid, y: Pid, z: Pid, yaw: Pid){
         self.pid = Pid3D(x: x, y: y, z: z, yaw: yaw)
+        self.engine = Pid4(x: x, y: y, z: z, yaw: yaw)
 
         input = Sensor<QuadrotorPose>()
         input.value = QuadrotorPose()
@@ -250,65 +408,104 @@ public class PositionController {
     }
 
     /// Connects the controller to position and orientation measurement sources.
+    ///
+    /// Every position measurement updates all four axes once, with the latest orientation.
+    /// So all axes, including yaw, are controlled at the rate of the position source,
+    /// and nothing is controlled until both sources have a value.
     public func source<P, O>(position: Sensor<P>, orientation: Sensor<O>) -> Sensor<QuadrotorControls>
         where P: PositionMeasurement, O: OrientationMeasurement
     {
         // Clean previously stored subscribers
         sourcesSubs = []
 
-        // Subscribe to position measurements updates
+        // Subscribe to position measurements updates, the orientation is sampled
         position.sink {
-            // Count number of sensor failures
-            if $0.isValid.pos.x && $0.isValid.pos.y {
-                self.posSensorFailCount = 0
-                self.posSensorFailed = false
-            } else {
-                if !self.posSensorFailed {
-                    self.posSensorFailCount += 1
-
-                    if self.posSensorFailCount >= self.posSensorFailThreshold {
-                        self.posSensorFailed = true
-                        self.reset(.sensorFailure)
-                    }
-                }
-            }
+            guard let latest = orientation.value else { return }
+            // The output drives the sticks, so every update is published
+            self.update(position: $0, orientation: latest, at: CACurrentMediaTime(), throttled: false)
+        }.store(in: &sourcesSubs)
 
-            // Make pose
-            let pose = QuadrotorPose(x: $0.position.x, y: $0.position.y, z: $0.position.z, yaw: nil) - self.origin
+        // Chain output
+        return output
+    }
 
-            // Aggregate inputs (measurements)
-            self.input.value?.assignNonEmpty(other: pose)
-            // Calculate correction
-            if let corr = self.update(measured: pose) {
-                // Aggregate outputs (controls)
-                self.output.value?.assignNonEmpty(other: corr)
-            }
-        }.store(in: &sourcesSubs)
+    /// Disconnects the controller from measurement sources set with `source(position:orientation:)`.
+    public func disconnectSources() {
+        sourcesSubs = []
+    }
 
-        // Subscribe to orientation measurements updates
-        orientation.sink {
-            // Make pose
-            let pose = QuadrotorPose(x: nil, y: nil, z: nil, yaw: $0.orientation.rpy.yaw) - self.origin
-
-            // Transforms from body to odometry frame
-            // e.g. vector_in_odom = bodyTf * vector_in_body
-            // conversely, to get a vector in body frame:
-            // vector_in_body = bodyTf.inversed * vector_in_odom
-            self.bodyTf = Transform.init(simd_quatd(roll: 0.0, pitch: 0.0, yaw: $0.orientation.rpy.yaw))
-
-            // Aggregate inputs (measurements)
-            self.input.value?.assignNonEmpty(other: pose)
-            // Calculate correction
-            if let corr = self.update(measured: pose) {
-                // Aggregate outputs (controls)
-                self.output.value?.assignNonEmpty(other: corr)
-            }
-        }.store(in: &sourcesSubs)
+    /// Updates the controller with position and orientation measured (or predicted) at the same time.
+    ///
+    /// Use this method instead of `source(position:orientation:)` to run the controller at
+    /// a rate other than the sensors rate, e.g. from a `ControlLoop`. All four axes are updated once.
+    ///
+    /// `input.value` and `output.value` are kept current, but their observers and subscribers are
+    /// notified at most once per `publishInterval`, so the control rate does not flood the main queue.
+    ///
+    /// - Returns: Aggregated controls, or `nil` if there is no target.
+    @discardableResult
+    public func update<P, O>(position: P, orientation: O, at time: CFTimeInterval = CACurrentMediaTime()) -> QuadrotorControls?
+        where P: PositionMeasurement, O: OrientationMeasurement
+    {
+        return update(position: position, orientation: orientation, at: time, throttled: true)
+    }
 
-        // Chain output
+    private func update<P, O>(position: P, orientation: O, at time: CFTimeInterval, throttled: Bool) -> QuadrotorControls?
+        where P: PositionMeasurement, O: OrientationMeasurement
+    {
+        applyPendingReset()
+        countSensorFailures(position.isValid)
+        store(velocity: position.velocity, isValid: position.isValid.vel)
+
+        let yaw = orientation.orientation.rpy.yaw
+        // Set body frame first, so the position is converted with the same yaw
+        self.bodyTf = Transform.init(simd_quatd(roll: 0.0, pitch: 0.0, yaw: yaw))
+
+        // Make pose
+        let pose = QuadrotorPose(x: position.position.x, y: position.position.y, z: position.position.z, yaw: yaw) - self.origin
+
+        // Time goes back when a simulation restarts
+        let publish = !throttled || time < lastPublication || time - lastPublication >= publishInterval
+        if publish {
+            lastPublication = time
+        }
+
+        // Aggregate inputs (measurements)
+        var input = self.input.value ?? QuadrotorPose()
+        input.assignNonEmpty(other: pose)
+        self.input.store(input, notify: publish)
+        // Calculate correction
+        guard let corr = self.update(measured: pose, at: time) else { return nil }
+
+        // Aggregate outputs (controls)
+        var output = self.output.value ?? QuadrotorControls()
+        output.assignNonEmpty(other: corr)
+        self.output.store(output, notify: publish)
         return output
     }
 
+    private func store(velocity: simd_double3, isValid: IsValid) {
+        self.velocity = simd_double3(isValid.x ? velocity.x : .nan,
+                                     isValid.y ? velocity.y : .nan,
+                                     isValid.z ? velocity.z : .nan)
+    }
+
+    private func countSensorFailures(_ isValid: IsValidVelPos) {
+        if isValid.pos.x && isValid.pos.y {
+            self.posSensorFailCount = 0
+            self.posSensorFailed = false
+        } else {
+            if !self.posSensorFailed {
+                self.posSensorFailCount += 1
+
+                if self.posSensorFailCount >= self.posSensorFailThreshold {
+                    self.posSensorFailed = true
+                    self.reset(.sensorFailure)
+                }
+            }
+        }
+    }
+
     /// Sets new target (desired) pose.
     ///
     /// - Remark: This method resets all internal PID controllers.
@@ -316,14 +513,79 @@ public class PositionController {
     /// - Parameters:
     ///   - target: four-dimensional pose.
     public func setTarget(target: QuadrotorPose) {
-        self.target <- target
+        follow(nil, target: target)
+    }
+
+    /// Sets new target pose at the start of the next update.
+    ///
+    /// For the thread that updates the controller, e.g. from `controlOverride`, where the target must not change
+    /// in the middle of the update. A reset before the next update discards it.
+    func setTargetOnNextUpdate(_ target: QuadrotorPose) {
+        referenceLock.lock()
+        pendingReset.target = target
+        referenceLock.unlock()
+    }
+
+    /// Tracks a moving reference, e.g. to follow a moving object.
+    ///
+    /// Call it whenever the reference changes. Between the calls the reference is extrapolated
+    /// with its velocity and acceleration for up to `referenceHorizon` seconds.
+    ///
+    /// - Remark: Only the first call after a target, a trajectory, or a reset resets the internal PID controllers.
+    public func setReference(_ reference: TrackingReference) {
+        referenceLock.lock()
+        let wasTracking = tracking != nil
+        tracking = reference
+        trajectory = nil
+        trajectoryStart = nil
+        referenceLock.unlock()
+
+        if !wasTracking {
+            // Keeps `target` non-nil while tracking
+            follow(nil, tracking: reference, target: reference.pose)
+        }
+    }
+
+    /// Sets a trajectory to follow.
+    ///
+    /// The trajectory starts on the next controller update and its final waypoint becomes the target.
+    /// The controller does not report convergence until the end of the trajectory.
+    ///
+    /// - Remark: This method resets all internal PID controllers.
+    public func setTrajectory(_ trajectory: Trajectory) {
+        let end = trajectory.waypoints[trajectory.waypoints.count - 1]
+        follow(trajectory, target: QuadrotorPose(x: end.x, y: end.y, z: end.z, yaw: remainder(end.w, 2.0 * .pi)))
+    }
 
+    /// Sets a minimum-snap trajectory from the current pose through the waypoints.
+    ///
+    /// `nil` components of a waypoint keep the value of the previous waypoint.
+    ///
+    /// - Returns: `false` if the current pose is not fully known or the trajectory cannot be made.
+    @discardableResult
+    public func setTrajectory(waypoints: [QuadrotorPose], limits: Trajectory.Limits = Trajectory.Limits()) -> Bool {
+        guard let current = input.value,
+              let trajectory = Trajectory(waypoints: [current] + waypoints, limits: limits) else { return false }
+
+        setTrajectory(trajectory)
+        return true
+    }
+
+    private func follow(_ trajectory: Trajectory?, tracking: TrackingReference? = nil, target: QuadrotorPose) {
+        referenceLock.lock()
+        self.trajectory = trajectory
+        self.trajectoryStart = nil
+        self.tracking = tracking
         // TODO: Maybe reset only those which targets are not nil, so
         // the non-reset controllers keep react to disturbances
-        pid.x.reset()
-        pid.y.reset()
-        pid.z.reset()
-        pid.yaw.reset()
+        pendingReset.engine = true
+        pendingReset.mpc = true
+        referenceLock.unlock()
+
+        self.target <- target
+        // Leave `.idle` right away rather than on the next update, so a reset issued
+        // in between is published, and a previous convergence is reported again
+        transition(to: .running(.correcting))
 
         print("New target: ", target)
     }
@@ -353,14 +615,16 @@ public class PositionController {
 
         self.target <- nil
 
+        referenceLock.lock()
+        trajectory = nil
+        trajectoryStart = nil
+        tracking = nil
+        pendingReset = PendingReset(engine: true, mpc: true, velocity: true)
+        referenceLock.unlock()
+
         input.value = QuadrotorPose()
         output.value = QuadrotorControls()
 
-        pid.x.reset()
-        pid.y.reset()
-        pid.z.reset()
-        pid.yaw.reset()
-
         state <- .reset(reason)
         state <- .idle
         // FIXME: Publish controller state
@@ -373,79 +637,191 @@ public class PositionController {
     ///   - measured: Actual (measured) pose of the quadrotor.
     /// - Returns: Control values for `roll`, `pitch`, `yaw`, and `thrust`.
     public func update(measured: QuadrotorPose) -> QuadrotorControls? {
-        guard let target = target.value else {
-            state <- .idle
-            //print("error: No target set")
+        return update(measured: measured, at: CACurrentMediaTime())
+    }
+
+    /// Calculates the control values based on the actual (measured) pose of the quadrotor
+    /// measured at the given time.
+    ///
+    /// - Parameters:
+    ///   - measured: Actual (measured) pose of the quadrotor.
+    ///   - time: Time of the measurement, in seconds.
+    /// - Returns: Control values for `roll`, `pitch`, `yaw`, and `thrust`.
+    public func update(measured: QuadrotorPose, at time: CFTimeInterval) -> QuadrotorControls? {
+        // Runs at the control rate: no allocations, no logging,
+        // and the state is published only when it changes.
+        applyPendingReset()
+
+        guard var target = target.value else {
+            transition(to: .idle)
             return nil
         }
 
-        // Input vector in body frame
-        let measPos = self.bodyTf.inversed * simd_double3(x: measured.x ?? 0.0, y: measured.y ?? 0.0, z: measured.z ?? 0.0)
-        // Input in body frame
-        let measBody = QuadrotorPose(x: measured.x == nil ? nil : measPos.x,
-                                     y: measured.y == nil ? nil : measPos.y,
-                                     z: measured.z == nil ? nil : measPos.z,
-                                     yaw: measured.yaw)
+        // A trajectory or a tracked reference moves the target along
+        let reference = self.reference(at: time)
+        if let reference = reference {
+            target = reference.state.pose
+        }
 
-        let measured = measBody
+        let toBody = self.bodyTf.inversed
+        // Input and target vectors in body frame
+        let measPos = toBody * simd_double3(x: measured.x ?? 0.0, y: measured.y ?? 0.0, z: measured.z ?? 0.0)
+        let targetPos = toBody * simd_double3(x: target.x ?? 0.0, y: target.y ?? 0.0, z: target.z ?? 0.0)
+
+        // Missing axes are NaN
+        var setPoint = simd_double4(target.x == nil ? .nan : targetPos.x,
+                                    target.y == nil ? .nan : targetPos.y,
+                                    target.z == nil ? .nan : targetPos.z,
+                                    target.yaw ?? .nan)
+        let measuredValue = simd_double4(measured.x == nil ? .nan : measPos.x,
+                                         measured.y == nil ? .nan : measPos.y,
+                                         measured.z == nil ? .nan : measPos.z,
+                                         measured.yaw ?? .nan)
+        // References may wind past pi, turn the shortest way to the measured yaw
+        setPoint.w = measuredValue.w + remainder(setPoint.w - measuredValue.w, 2.0 * .pi)
+
+        // Axes that have both target and measurement
+        var present = Pid4Mask(repeating: false)
+        present[0] = target.x != nil && measured.x != nil
+        present[1] = target.y != nil && measured.y != nil
+        present[2] = target.z != nil && measured.z != nil
+        present[3] = target.yaw != nil && measured.yaw != nil
+
+        // NaN lanes are not updated, but still count towards convergence
+        let updated = present .& (setPoint .== setPoint) .& (measuredValue .== measuredValue)
+
+        // Pick up gains changed through `pid`
+        engine.sync(x: pid.x, y: pid.y, z: pid.z, yaw: pid.yaw)
+
+        var corr: simd_double4
+        let measuredVelocity = measuredBodyVelocity(toBody)
+        if let reference = reference?.state {
+            // Tracking mode, all vectors in body frame
+            let refVel = toBody * simd_double3(reference.velocity.x, reference.velocity.y, reference.velocity.z)
+            let refAcc = toBody * simd_double3(reference.acceleration.x, reference.acceleration.y, reference.acceleration.z)
+            let velocitySetPoint = simd_double4(refVel, reference.velocity.w)
+            let accelerationSetPoint = simd_double4(refAcc, reference.acceleration.w)
+
+            corr = engine.update(setPoint: setPoint, measured: measuredValue,
+                                 velocitySetPoint: velocitySetPoint, measuredVelocity: measuredVelocity,
+                                 mask: updated, at: time)
+            corr += feedForward.velocity * velocitySetPoint + feedForward.acceleration * accelerationSetPoint
+
+            if case .mpc(let mpc) = algorithm {
+                corr = mpc.update(setPoint: setPoint, velocitySetPoint: velocitySetPoint, accelerationSetPoint: accelerationSetPoint,
+                                  measured: measuredValue, measuredVelocity: measuredVelocity, mask: updated, at: time)
+            }
+        } else {
+            corr = engine.update(setPoint: setPoint, measured: measuredValue, mask: updated, at: time)
 
-        // Target vector in body frame
-        let targetPos = self.bodyTf.inversed * simd_double3(x: target.x ?? 0.0, y: target.y ?? 0.0, z: target.z ?? 0.0)
-        // Target in body frame
-        let t = QuadrotorPose(x: target.x == nil ? nil : targetPos.x,
-                              y: target.y == nil ? nil : targetPos.y,
-                              z: target.z == nil ? nil : targetPos.z,
-                              yaw: target.yaw)
+            if case .mpc(let mpc) = algorithm {
+                corr = mpc.update(setPoint: setPoint, measured: measuredValue, measuredVelocity: measuredVelocity, mask: updated, at: time)
+            }
+        }
 
-        state <- .running(.correcting)
+        // Lanes replaced by the override, e.g. autotuning excitation
+        var overridden = Pid4Mask(repeating: false)
+        if let override = controlOverride {
+            let replacement = override(setPoint, measuredValue, time)
+            overridden = replacement.lanes .& updated
+            corr.replace(with: replacement.corrections, where: overridden)
+        }
 
         var result: QuadrotorControls = QuadrotorControls() // all set to nil
-        var converged: [Bool?] = []
 
         // +X is proportional to +Pitch
-        if let targetX = t.x, let measuredX = measured.x {
-            if !(targetX.isNaN || measuredX.isNaN) {
-                result.pitch = pid.x.update(setPoint: targetX, measuredValue: measuredX)
-            }
-            converged.append(pid.x.converged)
-            //print("debug: Update pitch control")
+        if updated[0] {
+            result.pitch = corr.x
         }
-
         // +Y is proportional to -Roll
-        if let targetY = t.y, let measuredY = measured.y {
-            if !(targetY.isNaN || measuredY.isNaN) {
-                // Invert roll
-                result.roll = -1.0 * pid.y.update(setPoint: targetY, measuredValue: measuredY)
-            }
-            converged.append(pid.y.converged)
-            //print("debug: Update roll control")
+        if updated[1] {
+            result.roll = -1.0 * corr.y
         }
-
         // +Z is proportional to +Thrust
-        if let targetZ = t.z, let measuredZ = measured.z {
-            if !(targetZ.isNaN || measuredZ.isNaN) {
-                result.thrust = pid.z.update(setPoint: targetZ, measuredValue: measuredZ)
-            }
-            converged.append(pid.z.converged)
-            //print("debug: Update thrust control")
+        if updated[2] {
+            result.thrust = corr.z
         }
-
         // Yaw
-        if let targetYaw = t.yaw, let measuredYaw = measured.yaw {
-            if !(targetYaw.isNaN || measuredYaw.isNaN) {
-                result.yaw = -1.0 * pid.yaw.update(setPoint: targetYaw, measuredValue: measuredYaw)
-                print(rad2deg(targetYaw), rad2deg(measuredYaw))
-            }
-            converged.append(pid.yaw.converged)
-            //print("debug: Update yaw control")
+        if updated[3] {
+            result.yaw = -1.0 * corr.w
         }
 
-        result.assignNonEmpty(other: result)
+        let following = reference?.following ?? false
+        let converged = !following && !any(overridden) && any(present) && all(engine.converged .| .!present)
+        transition(to: .running(converged ? .converged : .correcting))
 
-        if !converged.isEmpty && converged.allSatisfy({ $0 == true }) {
-            state <- .running(.converged)
+        return result
+    }
+
+    /// Resets the engine, the MPC and the velocity as requested by `follow()`, `reset()` and `algorithm`,
+    /// after setting the target requested by `setTargetOnNextUpdate(_:)`.
+    ///
+    /// They are only touched by the thread that updates the controller, so the requests are deferred to it.
+    private func applyPendingReset() {
+        referenceLock.lock()
+        let target = pendingReset.target
+        pendingReset.target = nil
+        referenceLock.unlock()
+
+        if let target = target {
+            // Requests the resets applied below
+            follow(nil, target: target)
         }
 
-        return result
+        referenceLock.lock()
+        let pending = pendingReset
+        pendingReset = PendingReset()
+        let algorithm = currentAlgorithm
+        referenceLock.unlock()
+
+        if pending.engine {
+            engine.reset()
+        }
+        if pending.mpc, case .mpc(let mpc) = algorithm {
+            mpc.reset()
+        }
+        if pending.velocity {
+            velocity = simd_double3(repeating: .nan)
+        }
+    }
+
+    /// Returns the reference at `time`, if following a trajectory or tracking a reference.
+    ///
+    /// `following` is `true` until the end of the trajectory. The first sample starts the trajectory.
+    private func reference(at time: CFTimeInterval) -> (state: TrackingReference, following: Bool)? {
+        referenceLock.lock()
+        defer { referenceLock.unlock() }
+
+        if let tracking = tracking {
+            return (tracking.extrapolated(to: time, horizon: referenceHorizon), false)
+        }
+
+        guard trajectory != nil else { return nil }
+
+        let start = trajectoryStart ?? time
+        trajectoryStart = start
+
+        guard let sample = trajectory?.sample(at: time - start) else { return nil }
+        let state = TrackingReference(time: time, position: sample.position,
+                                      velocity: sample.velocity, acceleration: sample.acceleration)
+        return (state, !sample.isFinished)
+    }
+
+    /// Measured velocity in body frame, NaN lanes are unknown. There is no measured yaw rate.
+    private func measuredBodyVelocity(_ toBody: Transform) -> simd_double4 {
+        let v = velocity
+        // Rotation around Z mixes X and Y only
+        let planar = !v.x.isNaN && !v.y.isNaN
+        let body = toBody * simd_double3(planar ? v.x : 0.0, planar ? v.y : 0.0, 0.0)
+
+        return simd_double4(planar ? body.x : .nan, planar ? body.y : .nan, v.z, .nan)
+    }
+
+    /// Publishes the new state only if it differs from the current one.
+    ///
+    /// Keeps subscribers from being woken up on the main queue on every update.
+    private func transition(to newState: State) {
+        guard state.value != newState else { return }
+        state <- newState
     }
 }
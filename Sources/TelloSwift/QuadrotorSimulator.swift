@@ -0,0 +1,608 @@
+//
+//  QuadrotorSimulator.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+import Transform
+import TelloSwiftObjC
+
+/// Deterministic simulator of a Tello, used by `Tello` in place of the UDP connection.
+///
+/// The drone is a rigid body with the response of the Tello flight controller to the sticks:
+/// - roll and pitch sticks set the tilt, which follows with a first-order lag. The tilt accelerates
+///   the drone horizontally against linear drag, so the velocity settles proportionally to the stick;
+/// - thrust and yaw sticks set the climb rate and the yaw rate, both with first-order lags.
+///
+/// Sticks take effect after `commandLatency`. Takeoff and land commands climb and descend at
+/// a constant speed. Random gusts, with the same standard deviation at any time step, disturb the drone.
+///
+/// IMU, MVO, VO and proximity are sampled at their rates with Gaussian noise and delivered after
+/// their latencies. The noise comes from a seeded generator, so the same configuration and the same
+/// commands always produce the same flight.
+///
+/// The simulator advances only when stepped, with a fixed time step, so it runs as fast as it is stepped.
+/// `Tello` uses the simulated time as its `clock` and steps its control loop on the keep-alive events,
+/// which makes control with `setControllerSourcePredicted()` exact in simulated time:
+///
+///     let sim = QuadrotorSimulator()
+///     let tello = Tello(transport: sim)
+///     tello.connect()
+///     _ = tello.takeoff()
+///     sim.run(for: 5.0)
+///     tello.goTo(x: 1.0, y: 0.0, z: 1.0)
+///     sim.run(for: 10.0)
+///
+/// - Remark: Step from a single thread. Commands can be sent from any thread.
+public final class QuadrotorSimulator: TelloTransport {
+    /// Response of the drone to the sticks.
+    public struct Dynamics {
+        /// Tilt at full roll or pitch stick, rad.
+        public var maxTilt: Double = deg2rad(15.0)
+        /// Tilt at full roll or pitch stick in fast mode, rad.
+        public var maxTiltFast: Double = deg2rad(25.0)
+        /// Time constant of the tilt, s.
+        public var tiltTimeConstant: Double = 0.1
+        /// Linear drag, 1/s. The inverse of the horizontal velocity time constant.
+        public var drag: Double = 1.5
+        /// Climb rate at full thrust stick, m/s.
+        public var maxClimbRate: Double = 1.0
+        /// Time constant of the climb rate, s.
+        public var climbTimeConstant: Double = 0.15
+        /// Yaw rate at full yaw stick, rad/s.
+        public var maxYawRate: Double = deg2rad(100.0)
+        /// Time constant of the yaw rate, s.
+        public var yawTimeConstant: Double = 0.1
+        /// Standard deviation of the horizontal gust acceleration, m/s^2.
+        public var gustAcceleration: Double = 0.05
+        /// Correlation time of the gusts, s.
+        public var gustTimeConstant: Double = 1.0
+        /// Altitude reached by the takeoff command, m.
+        public var takeoffAltitude: Double = 0.8
+        /// Climb rate of the takeoff, m/s.
+        public var takeoffSpeed: Double = 0.6
+        /// Descent rate of the landing, m/s.
+        public var landingSpeed: Double = 0.5
+
+        public init() {}
+
+        /// Steady-state response to a unit stick near hover, per lane: x and y velocity, m/s,
+        /// climb rate, m/s, and yaw rate, rad/s, with the controller's sign convention.
+        public var stickGain: simd_double4 {
+            let horizontal = QuadrotorSimulator.gravity * maxTilt / drag
+            return simd_double4(horizontal, horizontal, maxClimbRate, maxYawRate)
+        }
+
+        /// Time constants of the response to the sticks, per lane, s.
+        /// The horizontal lanes add the tilt lag to the drag time constant.
+        public var responseTime: simd_double4 {
+            let horizontal = 1.0 / drag + tiltTimeConstant
+            return simd_double4(horizontal, horizontal, climbTimeConstant, yawTimeConstant)
+        }
+    }
+
+    /// IMU sampling. Noise values are standard deviations.
+    public struct ImuModel {
+        /// Rate, Hz. Zero disables the sensor.
+        public var rate: Double = 10.0
+        /// Delivery latency, s.
+        public var latency: Double = 0.1
+        /// Acceleration noise, g.
+        public var accelNoise: Double = 0.01
+        /// Angular velocity noise, rad/s.
+        public var gyroNoise: Double = 0.01
+        /// Roll, pitch and yaw noise, rad.
+        public var attitudeNoise: Double = 0.005
+
+        public init() {}
+    }
+
+    /// MVO or VO sampling. Noise values are standard deviations.
+    public struct OdometryModel {
+        /// Rate, Hz. Zero disables the sensor.
+        public var rate: Double
+        /// Delivery latency, s.
+        public var latency: Double
+        /// Position noise, m.
+        public var positionNoise: Double
+        /// Velocity noise, m/s.
+        public var velocityNoise: Double
+
+        public init(rate: Double, latency: Double, positionNoise: Double, velocityNoise: Double) {
+            self.rate = rate
+            self.latency = latency
+            self.positionNoise = positionNoise
+            self.velocityNoise = velocityNoise
+        }
+    }
+
+    /// Proximity sampling.
+    public struct ProximityModel {
+        /// Rate, Hz. Zero disables the sensor.
+        public var rate: Double = 10.0
+        /// Delivery latency, s.
+        public var latency: Double = 0.1
+        /// Standard deviation of the distance, m.
+        public var noise: Double = 0.01
+
+        public init() {}
+    }
+
+    /// Simulation parameters.
+    public struct Configuration {
+        /// Integration time step, s. Sensor rates must not exceed its inverse.
+        public var timeStep: Double = 0.005
+        /// Seed of the noise generator.
+        public var seed: UInt64 = 0
+        /// Position the drone starts landed at, m. The floor is at zero altitude.
+        public var initialPosition = simd_double2.zero
+        /// Heading the drone starts with, rad.
+        public var initialYaw: Double = 0.0
+        public var dynamics = Dynamics()
+        /// Time from sending the sticks to the drone reacting, s.
+        public var commandLatency: Double = 0.05
+        /// Interval of the keep-alive events, s.
+        public var keepAliveInterval: Double = 0.05
+        /// Rate of the flight data, Hz. Delivered without latency.
+        public var flightDataRate: Double = 10.0
+        public var imu = ImuModel()
+        public var mvo = OdometryModel(rate: 5.0, latency: 0.15, positionNoise: 0.02, velocityNoise: 0.03)
+        public var vo = OdometryModel(rate: 10.0, latency: 0.1, positionNoise: 0.03, velocityNoise: 0.05)
+        public var proximity = ProximityModel()
+
+        public init() {}
+    }
+
+    /// Ground truth of the simulated drone. Positions are in the world frame with Z-axis up.
+    public struct State {
+        /// Simulated time, s.
+        public var time: CFTimeInterval = 0.0
+        public var position = simd_double3.zero
+        public var velocity = simd_double3.zero
+        public var acceleration = simd_double3.zero
+        public var roll: Double = 0.0
+        public var pitch: Double = 0.0
+        public var yaw: Double = 0.0
+        /// Roll, pitch and yaw rates, rad/s.
+        public var angularVelocity = simd_double3.zero
+        public var flightState: FlightState = .landed
+    }
+
+    private struct Command {
+        var time: CFTimeInterval
+        var controls: QuadrotorControls
+        var fastMode: Bool
+    }
+
+    private static let gravity = 9.80665
+    // Slower drones report the still flight mode
+    private static let stillSpeed = 0.1
+
+    public let configuration: Configuration
+
+    private let lock = NSLock()
+    private var rng: SeededRandom
+    private var truth = State()
+    private var gust = simd_double2.zero
+    private var controls = QuadrotorControls(roll: 0.0, pitch: 0.0, yaw: 0.0, thrust: 0.0)
+    private var fastMode = false
+    // Sticks in flight to the drone, and events in flight from it, in time order
+    private var commands: [Command] = []
+    private var pending: [(time: CFTimeInterval, event: TelloTransportEvent)] = []
+    private var receive: ((TelloTransportEvent) -> Void)?
+
+    // Set by `SwarmWorld` between its ticks: prop-wash of the other drones and the shared link
+    private var externalAcceleration = simd_double3.zero
+    private var linkDelay = 0.0
+    private var linkLoss = 0.0
+    // Packets over the link since the last exchange with the world
+    private var packets = 0
+
+    private var nextKeepAlive = 0.0
+    private var nextFlightData = 0.0
+    private var nextImu = 0.0
+    private var nextMvo = 0.0
+    private var nextVo = 0.0
+    private var nextProximity = 0.0
+
+    // Discrete first-order lags of the fixed time step
+    private let tiltAlpha: Double
+    private let climbAlpha: Double
+    private let yawAlpha: Double
+    private let gustDecay: Double
+    private let gustNoise: Double
+
+    public init(configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+
+        let dt = configuration.timeStep
+        let d = configuration.dynamics
+        tiltAlpha = 1.0 - exp(-dt / d.tiltTimeConstant)
+        climbAlpha = 1.0 - exp(-dt / d.climbTimeConstant)
+        yawAlpha = 1.0 - exp(-dt / d.yawTimeConstant)
+        // Ornstein–Uhlenbeck process with a stationary deviation of `gustAcceleration`
+        gustDecay = exp(-dt / d.gustTimeConstant)
+        gustNoise = d.gustAcceleration * (1.0 - gustDecay * gustDecay).squareRoot()
+
+        rng = SeededRandom(seed: configuration.seed)
+        truth.position = simd_double3(configuration.initialPosition, 0.0)
+        truth.yaw = configuration.initialYaw
+    }
+
+    /// Ground truth at the current simulated time.
+    public var state: State {
+        lock.lock()
+        defer { lock.unlock() }
+        return truth
+    }
+
+    // MARK: Stepping
+
+    /// Advances the simulation by one time step and delivers the events due.
+    public func step() {
+        lock.lock()
+
+        let dt = configuration.timeStep
+        let now = truth.time + dt
+
+        while let command = commands.first, command.time <= now {
+            controls = command.controls
+            fastMode = command.fastMode
+            commands.removeFirst()
+        }
+
+        integrate(dt)
+        truth.time = now
+        sample(at: now)
+
+        let count = pending.prefix { $0.time <= now }.count
+        let due = count > 0 ? pending[..<count].map { $0.event } : []
+        pending.removeFirst(count)
+        let receive = self.receive
+
+        lock.unlock()
+
+        // Outside the lock, the receiver sends commands back
+        if let receive = receive {
+            for event in due {
+                receive(event)
+            }
+        }
+    }
+
+    /// Steps the simulation for `duration` seconds of simulated time.
+    public func run(for duration: CFTimeInterval) {
+        let steps = Int((duration / configuration.timeStep).rounded())
+        for _ in 0..<Swift.max(steps, 0) {
+            step()
+        }
+    }
+
+    /// Steps the simulation until `condition` holds, checked after every step.
+    ///
+    /// - Returns: `false` if `timeout` seconds of simulated time passed first.
+    @discardableResult
+    public func run(until condition: () -> Bool, timeout: CFTimeInterval) -> Bool {
+        let steps = Int((timeout / configuration.timeStep).rounded())
+        for _ in 0..<Swift.max(steps, 0) {
+            step()
+            if condition() {
+                return true
+            }
+        }
+        return false
+    }
+
+    // MARK: Commands
+
+    /// Sets the sticks, in `Tello.manualSticks` convention. Takes effect after `commandLatency`.
+    public func command(_ controls: QuadrotorControls, fastMode: Bool = false) {
+        let clamped = QuadrotorControls(roll: (controls.roll ?? 0.0).clamped(to: -1.0...1.0),
+                                        pitch: (controls.pitch ?? 0.0).clamped(to: -1.0...1.0),
+                                        yaw: (controls.yaw ?? 0.0).clamped(to: -1.0...1.0),
+                                        thrust: (controls.thrust ?? 0.0).clamped(to: -1.0...1.0))
+
+        lock.lock()
+        defer { lock.unlock() }
+
+        // Lost on a congested link, the next sticks command follows shortly
+        guard linkLoss <= 0.0 || rng.uniform() >= linkLoss else { return }
+
+        let time = truth.time + configuration.commandLatency + linkDelay
+        // The link delay changes, keep the time order
+        let index = commands.lastIndex { $0.time <= time }.map { $0 + 1 } ?? 0
+        commands.insert(Command(time: time, controls: clamped, fastMode: fastMode), at: index)
+    }
+
+    /// Takes off to `Dynamics.takeoffAltitude`, if landed.
+    public func takeoff() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if truth.flightState == .landed {
+            truth.flightState = .takingOff
+        }
+    }
+
+    /// Lands, if in the air.
+    public func land() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if truth.flightState != .landed {
+            truth.flightState = .landing
+        }
+    }
+
+    /// Stops landing and hovers.
+    public func cancelLanding() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        if truth.flightState == .landing {
+            truth.flightState = .hovering
+        }
+    }
+
+    // MARK: TelloTransport
+
+    public func now() -> CFTimeInterval {
+        lock.lock()
+        defer { lock.unlock() }
+        return truth.time
+    }
+
+    public func start(_ receive: @escaping (TelloTransportEvent) -> Void) {
+        lock.lock()
+        self.receive = receive
+        lock.unlock()
+
+        receive(.connected)
+    }
+
+    /// Handles sticks, takeoff and landing packets. Other packets are ignored.
+    public func send(_ packet: Data) {
+        lock.lock()
+        packets += 1
+        lock.unlock()
+
+        guard !packet.isEmpty, let packet = TelloPacket(rawData: packet),
+              let msgId = MessageId(rawValue: packet.getPreambula().messageID) else { return }
+
+        switch msgId {
+        case .stickCmd:
+            guard let payload = packet.getPayload() else { return }
+            let sticks = TelloSticksDataCreator.sticksData(from: payload)
+            let axis = { (value: UInt16) in (Double(value) - 1024.0) / 660.0 }
+
+            command(QuadrotorControls(roll: axis(sticks.axis1),
+                                      pitch: axis(sticks.axis2),
+                                      yaw: axis(sticks.axis4),
+                                      thrust: axis(sticks.axis3)),
+                    fastMode: sticks.axis5 == 1)
+        case .takeoffCmd, .throwAndGoCmd:
+            takeoff()
+        case .landCmd, .palmLandCmd:
+            if packet.getPayload()?.first == 1 {
+                cancelLanding()
+            } else {
+                land()
+            }
+        default:
+            break
+        }
+    }
+
+    public func stop() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        receive = nil
+    }
+
+    // MARK: World
+
+    /// Sets the acceleration caused by the other drones and the state of the shared link
+    /// for the following steps. Sticks and sensor packets are lost with `linkLoss` probability.
+    ///
+    /// - Returns: Number of packets sent and received since the previous call.
+    func exchange(externalAcceleration: simd_double3, linkDelay: Double, linkLoss: Double) -> Int {
+        lock.lock()
+        defer { lock.unlock() }
+
+        self.externalAcceleration = externalAcceleration
+        self.linkDelay = linkDelay
+        self.linkLoss = linkLoss
+
+        let count = packets
+        packets = 0
+        return count
+    }
+
+    // MARK: Dynamics
+
+    // Must be called under the lock
+    private func integrate(_ dt: Double) {
+        let d = configuration.dynamics
+
+        var tiltTarget = simd_double2.zero
+        var climbTarget = 0.0
+        var yawRateTarget = 0.0
+
+        switch truth.flightState {
+        case .landed, .unknown:
+            return
+        case .takingOff:
+            climbTarget = d.takeoffSpeed
+        case .landing:
+            climbTarget = -d.landingSpeed
+        case .hovering, .flying:
+            let maxTilt = fastMode ? d.maxTiltFast : d.maxTilt
+            tiltTarget = simd_double2(controls.roll ?? 0.0, controls.pitch ?? 0.0) * maxTilt
+            climbTarget = (controls.thrust ?? 0.0) * d.maxClimbRate
+            // Positive yaw stick turns clockwise
+            yawRateTarget = -(controls.yaw ?? 0.0) * d.maxYawRate
+        }
+
+        // Attitude
+        let tilt = simd_double2(truth.roll, truth.pitch)
+        let newTilt = tilt + (tiltTarget - tilt) * tiltAlpha
+        truth.angularVelocity.x = (newTilt.x - tilt.x) / dt
+        truth.angularVelocity.y = (newTilt.y - tilt.y) / dt
+        truth.angularVelocity.z += (yawRateTarget - truth.angularVelocity.z) * yawAlpha
+        truth.roll = newTilt.x
+        truth.pitch = newTilt.y
+        truth.yaw = remainder(truth.yaw + truth.angularVelocity.z * dt, 2.0 * .pi)
+
+        // Pitching forward accelerates along body X, rolling right along negative body Y
+        gust = gust * gustDecay + simd_double2(rng.gaussian(), rng.gaussian()) * gustNoise
+        let g = QuadrotorSimulator.gravity
+        let body = simd_double2(g * tan(truth.pitch), -g * tan(truth.roll))
+        let c = cos(truth.yaw), s = sin(truth.yaw)
+        let horizontal = simd_double2(c * body.x - s * body.y, s * body.x + c * body.y)
+            - d.drag * simd_double2(truth.velocity.x, truth.velocity.y) + gust
+
+        let climb = truth.velocity.z + (climbTarget - truth.velocity.z) * climbAlpha
+        truth.acceleration = simd_double3(horizontal, (climb - truth.velocity.z) / dt) + externalAcceleration
+
+        // Semi-implicit Euler
+        truth.velocity += truth.acceleration * dt
+        truth.position += truth.velocity * dt
+
+        if truth.position.z <= 0.0 {
+            truth.position.z = 0.0
+
+            if truth.flightState == .landing {
+                let position = truth.position, yaw = truth.yaw, time = truth.time
+                truth = State(time: time, position: position, yaw: yaw, flightState: .landed)
+                gust = .zero
+                return
+            }
+            truth.velocity.z = Swift.max(truth.velocity.z, 0.0)
+        }
+
+        switch truth.flightState {
+        case .takingOff where truth.position.z >= d.takeoffAltitude:
+            truth.flightState = .hovering
+        case .hovering, .flying:
+            let sticks = simd_double4(controls.roll ?? 0.0, controls.pitch ?? 0.0, controls.yaw ?? 0.0, controls.thrust ?? 0.0)
+            let moving = simd_length(truth.velocity) > QuadrotorSimulator.stillSpeed || sticks != .zero
+            truth.flightState = moving ? .flying : .hovering
+        default:
+            break
+        }
+    }
+
+    // MARK: Sensors
+
+    // Must be called under the lock
+    private func sample(at now: CFTimeInterval) {
+        let c = configuration
+
+        if QuadrotorSimulator.isDue(&nextKeepAlive, period: c.keepAliveInterval, at: now) {
+            enqueue(.keepAlive, at: now)
+        }
+        if QuadrotorSimulator.isDue(&nextFlightData, period: 1.0 / c.flightDataRate, at: now) {
+            enqueue(.flightData(flightData()), at: now)
+        }
+        if QuadrotorSimulator.isDue(&nextImu, period: 1.0 / c.imu.rate, at: now) {
+            enqueue(.imu(imu()), at: now + c.imu.latency)
+        }
+        if QuadrotorSimulator.isDue(&nextMvo, period: 1.0 / c.mvo.rate, at: now) {
+            let (position, velocity) = odometry(c.mvo)
+            let posVar = c.mvo.positionNoise * c.mvo.positionNoise
+            let velVar = c.mvo.velocityNoise * c.mvo.velocityNoise
+            let mvo = Mvo(velocity: velocity,
+                          velocityCov: simd_double3x3(diagonal: simd_double3(repeating: velVar)),
+                          position: position,
+                          positionCov: simd_double3x3(diagonal: simd_double3(repeating: posVar)),
+                          height: position.z,
+                          heightVariance: posVar,
+                          isValid: .allValid)
+            enqueue(.mvo(mvo), at: now + c.mvo.latency)
+        }
+        if QuadrotorSimulator.isDue(&nextVo, period: 1.0 / c.vo.rate, at: now) {
+            let (position, velocity) = odometry(c.vo)
+            enqueue(.vo(Vo(velocity: velocity, position: position, isValid: .allValid)), at: now + c.vo.latency)
+        }
+        if QuadrotorSimulator.isDue(&nextProximity, period: 1.0 / c.proximity.rate, at: now) {
+            let distance = Swift.max(truth.position.z + rng.gaussian(standardDeviation: c.proximity.noise), 0.0)
+            enqueue(.proximity(distance), at: now + c.proximity.latency)
+        }
+    }
+
+    /// Advances `next` by `period` if it is due. Infinite periods (zero rates) are never due.
+    private static func isDue(_ next: inout CFTimeInterval, period: Double, at now: CFTimeInterval) -> Bool {
+        guard period.isFinite, now >= next else { return false }
+
+        next = Swift.max(next + period, now)
+        return true
+    }
+
+    /// Inserts after the events with the same time, so they are delivered in the order they were produced.
+    ///
+    /// Events other than keep-alive are packets over the link: they are delayed and can be lost.
+    private func enqueue(_ event: TelloTransportEvent, at time: CFTimeInterval) {
+        var time = time
+        if case .keepAlive = event {} else {
+            packets += 1
+            guard linkLoss <= 0.0 || rng.uniform() >= linkLoss else { return }
+            time += linkDelay
+        }
+
+        let index = pending.lastIndex { $0.time <= time }.map { $0 + 1 } ?? 0
+        pending.insert((time, event), at: index)
+    }
+
+    private func noise(_ standardDeviation: Double) -> simd_double3 {
+        return simd_double3(rng.gaussian(standardDeviation: standardDeviation),
+                            rng.gaussian(standardDeviation: standardDeviation),
+                            rng.gaussian(standardDeviation: standardDeviation))
+    }
+
+    private func imu() -> Imu {
+        let model = configuration.imu
+        let g = QuadrotorSimulator.gravity
+        let attitude = noise(model.attitudeNoise)
+
+        // Gravity-compensated, in g like the drone reports it
+        return Imu(accel: truth.acceleration / g + noise(model.accelNoise),
+                   gyro: truth.angularVelocity + noise(model.gyroNoise),
+                   orientation: simd_quatd(roll: truth.roll + attitude.x,
+                                           pitch: truth.pitch + attitude.y,
+                                           yaw: remainder(truth.yaw + attitude.z, 2.0 * .pi)),
+                   temperature: 40.0)
+    }
+
+    private func odometry(_ model: OdometryModel) -> (position: simd_double3, velocity: simd_double3) {
+        return (truth.position + noise(model.positionNoise), truth.velocity + noise(model.velocityNoise))
+    }
+
+    private func flightData() -> FlightData {
+        var fd = FlightData()
+        let airborne = truth.flightState != .landed
+
+        // Height is reported in decimeters
+        fd.height = UInt16((truth.position.z * 10.0).rounded())
+        fd.batteryPercentage = 100
+        fd.emSky = airborne ? 1 : 0
+        fd.emGround = airborne ? 0 : 1
+
+        switch truth.flightState {
+        case .takingOff:
+            fd.flyMode = 11
+        case .landing:
+            fd.flyMode = 12
+        case .flying:
+            fd.flyMode = 1
+        default:
+            fd.flyMode = 6
+        }
+
+        return fd
+    }
+}
@@ -12,6 +12,11 @@ import simd
 
 infix operator <- : AssignmentPrecedence
 
+/// Identifies an observer registered with `Sensor.observe(_:)`.
+public struct ObserverToken: Hashable {
+    fileprivate let id: Int
+}
+
 public class Sensor<T>: ObservableObject, Publisher where T: Equatable {
     public typealias DataType = T
     public typealias Output = T
@@ -26,34 +31,197 @@ public class Sensor<T>: ObservableObject, Publisher where T: Equatable {
         subj?.receive(subscriber: subscriber)
     }
 
+    /// How many undelivered values to keep while the main queue is busy.
+    public let bufferingPolicy: BufferingPolicy
+
+    /// Number of values dropped because the main queue fell behind.
+    public var droppedCount: Int {
+        return drops.count
+    }
+
+    private let drops = DropCounter()
+    private let pendingLock = NSLock()
+    private let pending: PowerOfTwoRingBuffer<Output>
+    private var deliveryScheduled = false
+
+    private let observersLock = NSLock()
+    private var observers: [(id: Int, callback: (Output) -> Void)] = []
+    private var nextObserverId: Int = 0
+
+    // Trivially copyable values are read without locks, the rest are guarded by `valueLock`
+    private let snapshot: SeqLock<Output?>?
+    private let valueLock = NSLock()
+    private var lockedValue: Output?
+
+    /// Latest value.
+    ///
+    /// Can be read from any thread. The value is updated before the observers and subscribers are notified,
+    /// so it is always the same or newer than the value they receive.
     public internal(set) var value: Output? {
-        willSet {
+        get {
+            if let snapshot = snapshot {
+                return snapshot.load()
+            }
+
+            valueLock.lock()
+            defer { valueLock.unlock() }
+            return lockedValue
+        }
+        set {
+            // Swap atomically, so concurrent producers agree on what was the old value
+            let oldValue = exchangeValue(newValue)
+
             if let val = newValue {
-                if (!repeatedValues) && (newValue == value) {
+                if (!repeatedValues) && (val == oldValue) {
                     return
                 }
 
-                DispatchQueue.main.async {
-                    // send new value, old one can be accessed with `value` property
-                    self.subj?.send(val)
-                    self.objectWillChange.send()
-                }
+                notifyObservers(val)
+                enqueue(val)
             }
         }
     }
 
-    public init(with value: T?, repeatedValues: Bool = true) {
+    public init(with value: T?, repeatedValues: Bool = true, bufferingPolicy: BufferingPolicy = .dropOldest(capacity: 64)) {
+        self.bufferingPolicy = bufferingPolicy
+        self.pending = PowerOfTwoRingBuffer(minimumCapacity: bufferingPolicy.capacity)
         // First initialize value, so send() is not triggered
-        self.value = value
+        self.snapshot = _isPOD(Output?.self) ? SeqLock(value) : nil
+        self.lockedValue = value
         self.subj = PassthroughSubject<Output, Failure>()
         self.repeatedValues = repeatedValues
     }
 
-    public init(repeatedValues: Bool = true) {
+    public init(repeatedValues: Bool = true, bufferingPolicy: BufferingPolicy = .dropOldest(capacity: 64)) {
+        self.bufferingPolicy = bufferingPolicy
+        self.pending = PowerOfTwoRingBuffer(minimumCapacity: bufferingPolicy.capacity)
+        self.snapshot = _isPOD(Output?.self) ? SeqLock(nil) : nil
         self.subj = PassthroughSubject<Output, Failure>()
         self.repeatedValues = repeatedValues
     }
 
+    /// Replaces the value, but notifies the observers and subscribers only if `notify` is `true`.
+    ///
+    /// Keeps `value` current for readers while a fast producer publishes at a lower rate.
+    internal func store(_ newValue: Output, notify: Bool) {
+        let oldValue = exchangeValue(newValue)
+
+        guard notify, repeatedValues || newValue != oldValue else { return }
+
+        notifyObservers(newValue)
+        enqueue(newValue)
+    }
+
+    private func exchangeValue(_ newValue: Output?) -> Output? {
+        var oldValue: Output?
+
+        if let snapshot = snapshot {
+            snapshot.update {
+                oldValue = $0
+                $0 = newValue
+            }
+        } else {
+            valueLock.lock()
+            oldValue = lockedValue
+            lockedValue = newValue
+            valueLock.unlock()
+        }
+
+        return oldValue
+    }
+
+    /// Registers a callback that is called synchronously on the producer thread with every new value.
+    ///
+    /// Unlike subscribing with Combine, observers do not hop to the main queue and do not allocate per value.
+    /// The callback must be fast and must not block, as it delays the producer (usually the network thread).
+    ///
+    /// - Returns: Token to remove the observer with `removeObserver(_:)`.
+    @discardableResult
+    public func observe(_ callback: @escaping (Output) -> Void) -> ObserverToken {
+        observersLock.lock()
+        defer { observersLock.unlock() }
+
+        let id = nextObserverId
+        nextObserverId += 1
+        observers.append((id: id, callback: callback))
+
+        return ObserverToken(id: id)
+    }
+
+    /// Removes an observer registered with `observe(_:)`.
+    public func removeObserver(_ token: ObserverToken) {
+        observersLock.lock()
+        defer { observersLock.unlock() }
+
+        observers.removeAll { $0.id == token.id }
+    }
+
+    /// Same as `observe(_:)`, but the observer is removed when the returned cancellable is cancelled or deallocated.
+    public func observation(_ callback: @escaping (Output) -> Void) -> AnyCancellable {
+        let token = observe(callback)
+
+        return AnyCancellable { [weak self] in
+            self?.removeObserver(token)
+        }
+    }
+
+    private func notifyObservers(_ val: Output) {
+        // Copy-on-write snapshot, so observers may be added or removed from a callback
+        observersLock.lock()
+        let observers = self.observers
+        observersLock.unlock()
+
+        for observer in observers {
+            observer.callback(val)
+        }
+    }
+
+    /// Queues the value for delivery on the main queue.
+    ///
+    /// At most one delivery block is in flight, so a fast producer does not flood the main queue.
+    private func enqueue(_ val: Output) {
+        pendingLock.lock()
+        // The storage may be larger than the policy allows
+        if pending.count == bufferingPolicy.capacity {
+            drops.increment()
+
+            switch bufferingPolicy.overflow {
+            case .dropOldest:
+                _ = pending.read()
+            case .dropNewest:
+                pendingLock.unlock()
+                return
+            }
+        }
+        pending.append(val)
+
+        let schedule = !deliveryScheduled
+        deliveryScheduled = true
+        pendingLock.unlock()
+
+        if schedule {
+            DispatchQueue.main.async {
+                self.deliver()
+            }
+        }
+    }
+
+    private func deliver() {
+        while true {
+            pendingLock.lock()
+            guard let val = pending.read() else {
+                deliveryScheduled = false
+                pendingLock.unlock()
+                return
+            }
+            pendingLock.unlock()
+
+            // send new value, old one can be accessed with `value` property
+            subj?.send(val)
+            objectWillChange.send()
+        }
+    }
+
     public static func <- (left: Sensor<Output>, right: Output?) {
         left.value = right
     }
@@ -67,7 +235,155 @@ public class Sensor<T>: ObservableObject, Publisher where T: Equatable {
     }
 }
 
-public struct IsValid: Equatable {
+#if compiler(>=5.5.2) && canImport(_Concurrency)
+extension Sensor {
+    /// Returns the sensor values as an asynchronous sequence.
+    ///
+    /// The stream is fed by an observer on the producer thread (usually the network thread),
+    /// without hopping to the main queue. When the consumer falls behind, the values are
+    /// dropped according to `bufferingPolicy`. The observer is removed when the stream terminates.
+    ///
+    /// - Parameters:
+    ///   - bufferingPolicy: How many undelivered values to keep. By default keeps only the latest one.
+    public func stream(bufferingPolicy: BufferingPolicy = .latest) -> AsyncStream<Output> {
+        let policy: AsyncStream<Output>.Continuation.BufferingPolicy
+
+        switch bufferingPolicy.overflow {
+        case .dropOldest:
+            policy = .bufferingNewest(bufferingPolicy.capacity)
+        case .dropNewest:
+            policy = .bufferingOldest(bufferingPolicy.capacity)
+        }
+
+        return AsyncStream(Output.self, bufferingPolicy: policy) { continuation in
+            let token = self.observe { continuation.yield($0) }
+
+            continuation.onTermination = { [weak self] _ in
+                self?.removeObserver(token)
+            }
+        }
+    }
+
+    /// Suspends until a new value satisfies the predicate and returns that value.
+    ///
+    /// The predicate is called on the producer thread with the previous and the new value.
+    /// The `action` is called once the observer is registered, so the values it causes are not missed.
+    /// Canceling the task removes the observer and ends the wait.
+    ///
+    /// - Returns: The value, or `nil` if the task was canceled.
+    internal func first(where predicate: @escaping (_ previous: Output?, _ value: Output) -> Bool,
+                        after action: @escaping () -> Void = {}) async -> Output? {
+        let waiter = FirstValueWaiter<Output>(previous: value)
+
+        let wait = {
+            await withCheckedContinuation { (continuation: CheckedContinuation<Output?, Never>) in
+                // Canceled before it started
+                guard waiter.begin(continuation) else { return }
+
+                let token = self.observe { [weak self] val in
+                    if let token = waiter.offer(val, where: predicate) {
+                        self?.removeObserver(token)
+                    }
+                }
+
+                // The value might have arrived, or the task was canceled, before the token was stored
+                if !waiter.register(token) {
+                    self.removeObserver(token)
+                }
+
+                action()
+            }
+        }
+
+        let cancel = { [weak self] in
+            if let token = waiter.cancel() {
+                self?.removeObserver(token)
+            }
+        }
+
+        #if compiler(>=5.6)
+        return await withTaskCancellationHandler(operation: wait, onCancel: cancel)
+        #else
+        return await withTaskCancellationHandler(handler: cancel, operation: wait)
+        #endif
+    }
+}
+
+/// State of a `Sensor.first(where:after:)` call, finished exactly once by a value or by cancellation.
+private final class FirstValueWaiter<T> {
+    private let lock = NSLock()
+    private var previous: T?
+    private var continuation: CheckedContinuation<T?, Never>?
+    private var token: ObserverToken?
+    private var isFinished = false
+
+    init(previous: T?) {
+        self.previous = previous
+    }
+
+    /// - Returns: `false` if the wait was canceled already. The continuation is resumed with `nil` then.
+    func begin(_ continuation: CheckedContinuation<T?, Never>) -> Bool {
+        lock.lock()
+        guard !isFinished else {
+            lock.unlock()
+            continuation.resume(returning: nil)
+            return false
+        }
+        self.continuation = continuation
+        lock.unlock()
+        return true
+    }
+
+    /// - Returns: `false` if the wait finished already. The observer must be removed then.
+    func register(_ token: ObserverToken) -> Bool {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard !isFinished else { return false }
+        self.token = token
+        return true
+    }
+
+    /// Checks a new value against the predicate.
+    ///
+    /// - Returns: The observer to remove, if the wait finished with this value.
+    func offer(_ value: T, where predicate: (T?, T) -> Bool) -> ObserverToken? {
+        lock.lock()
+        let old = previous
+        previous = value
+        guard !isFinished, predicate(old, value) else {
+            lock.unlock()
+            return nil
+        }
+        return finish(with: value)
+    }
+
+    /// - Returns: The observer to remove, if the wait was still running.
+    func cancel() -> ObserverToken? {
+        lock.lock()
+        guard !isFinished else {
+            lock.unlock()
+            return nil
+        }
+        return finish(with: nil)
+    }
+
+    // Called with the lock held, releases it
+    private func finish(with value: T?) -> ObserverToken? {
+        isFinished = true
+        let continuation = self.continuation
+        let token = self.token
+        self.continuation = nil
+        self.token = nil
+        lock.unlock()
+
+        continuation?.resume(returning: value)
+        return token
+    }
+}
+#endif
+
+public struct IsValid: Equatable, Codable {
     var x: Bool
     var y: Bool
     var z: Bool
@@ -75,7 +391,7 @@ public struct IsValid: Equatable {
     public static var allValid: IsValid = .init(x: true, y: true, z: true)
 }
 
-public struct IsValidVelPos: Equatable {
+public struct IsValidVelPos: Equatable, Codable {
     var vel: IsValid
     var pos: IsValid
 
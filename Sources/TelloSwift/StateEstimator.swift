@@ -0,0 +1,408 @@
+//
+//  StateEstimator.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+import Transform
+
+/// Fused position, velocity and orientation estimate.
+public struct EstimatedState: PositionMeasurement, OrientationMeasurement {
+    /// Velocity in odometry frame.
+    public var velocity: simd_double3
+    /// Velocity covariance.
+    public var velocityCov: simd_double3x3
+    /// Position in odometry frame.
+    public var position: simd_double3
+    /// Position covariance.
+    public var positionCov: simd_double3x3
+    /// Cross-covariance between position (rows) and velocity (columns).
+    public var positionVelocityCov: simd_double3x3
+
+    /// Orientation: roll and pitch from IMU, filtered yaw.
+    public var orientation: simd_quatd
+    /// Filtered yaw.
+    public var yaw: Double
+    /// Yaw variance.
+    public var yawVariance: Double
+
+    /// Time of the latest measurement, `CACurrentMediaTime()` time base.
+    public var timestamp: CFTimeInterval
+
+    /// Per-axis validity. A velocity axis is valid while its variance is below `maxVelocityVariance`.
+    /// A position axis is valid while its variance is below `maxPositionVariance` and it was corrected
+    /// by a position measurement within `maxCorrectionAge`, see `StateEstimator.Configuration`.
+    public var isValid: IsValidVelPos
+}
+
+/// Extended Kalman filter fusing IMU, MVO, VO and proximity measurements.
+///
+/// The filter state is 3D position and velocity. IMU acceleration drives the prediction,
+/// position and velocity measurements correct it. The yaw is estimated by a separate scalar filter
+/// using gyro rate for prediction and IMU orientation for correction.
+///
+/// The covariance is kept as three 3x3 blocks, so the updates use fixed-size SIMD matrices only.
+/// The methods are thread-safe and are normally called from the network thread.
+public final class StateEstimator {
+    /// Filter parameters.
+    public struct Configuration {
+        /// Converts IMU acceleration to m/s^2. Tello reports acceleration in g.
+        public var accelScale: Double = 9.80665
+        /// Acceleration noise density, (m/s^2)^2 per second.
+        public var accelNoise: Double = 0.5
+        /// Yaw rate noise, rad^2 per second.
+        public var yawRateNoise: Double = 0.01
+        /// Variance of IMU yaw measurements, rad^2.
+        public var yawVariance: Double = 0.0003
+        /// Converts MVO velocity covariance to (m/s)^2. MVO reports it in (mm/s)^2.
+        public var mvoVelocityCovScale: Double = 1e-6
+        /// Variance added to reported MVO covariances to keep them positive definite.
+        public var mvoNoiseFloor: Double = 1e-4
+        /// Variance of VO position, m^2.
+        public var voPositionVariance: Double = 0.01
+        /// Variance of VO velocity, (m/s)^2.
+        public var voVelocityVariance: Double = 0.01
+        /// Variance of proximity measurements, m^2.
+        public var proximityVariance: Double = 0.0025
+        /// Use proximity sensor for altitude instead of odometry Z.
+        public var useProximity: Bool = true
+        /// Measurements with squared Mahalanobis distance above the threshold are rejected.
+        /// The default is the 99.9% quantile of chi-squared distribution with three degrees of freedom.
+        public var gate: Double = 16.27
+        /// Longest time step to propagate at once. Longer gaps reinitialize velocity uncertainty.
+        public var maxTimeStep: Double = 0.5
+        /// Position axes with larger variance are reported invalid, m^2.
+        public var maxPositionVariance: Double = 0.25
+        /// Velocity axes with larger variance are reported invalid, (m/s)^2.
+        public var maxVelocityVariance: Double = 0.25
+        /// Position axes not corrected by a measurement for longer are reported invalid, s.
+        /// Dead reckoning on IMU alone drifts quickly.
+        public var maxCorrectionAge: Double = 1.0
+
+        public init() {}
+    }
+
+    /// Filter parameters.
+    public var configuration: Configuration {
+        get {
+            lock.lock(); defer { lock.unlock() }
+            return config
+        }
+        set {
+            lock.lock(); defer { lock.unlock() }
+            config = newValue
+        }
+    }
+
+    /// Published estimate. Updated after every processed measurement.
+    public private(set) var state: Sensor<EstimatedState>
+
+    /// Number of measurements rejected by the gate.
+    public var rejectedCount: Int {
+        lock.lock(); defer { lock.unlock() }
+        return rejected
+    }
+
+    private let lock = NSLock()
+    private var config: Configuration
+
+    // Position and velocity
+    private var p: simd_double3 = .zero
+    private var v: simd_double3 = .zero
+    // Covariance blocks: pp = cov(p, p), pv = cov(p, v), vv = cov(v, v)
+    private var pp = simd_double3x3()
+    private var pv = simd_double3x3()
+    private var vv = simd_double3x3()
+
+    private var yaw: Double = 0.0
+    private var yawVar: Double = 0.0
+    private var yawRate: Double = 0.0
+    private var attitude: (roll: Double, pitch: Double) = (0.0, 0.0)
+
+    // Latest acceleration, applied as a control input between IMU samples
+    private var accel: simd_double3 = .zero
+
+    private var time: CFTimeInterval?
+    // Time of the latest position correction per axis
+    private var corrected = simd_double3(repeating: -.infinity)
+    private var positionInitialized = false
+    private var yawInitialized = false
+    private var rejected: Int = 0
+
+    public init(configuration: Configuration = .init()) {
+        self.config = configuration
+        self.state = Sensor<EstimatedState>()
+    }
+
+    /// Forgets the estimate. The filter reinitializes with the next measurements.
+    public func reset() {
+        lock.lock()
+        defer { lock.unlock() }
+
+        time = nil
+        corrected = simd_double3(repeating: -.infinity)
+        positionInitialized = false
+        yawInitialized = false
+        accel = .zero
+        rejected = 0
+    }
+
+    /// Returns the estimate propagated to `time` without changing the filter state.
+    ///
+    /// The `timestamp` of the returned state is still the time of the latest measurement.
+    public func estimate(at time: CFTimeInterval) -> EstimatedState? {
+        lock.lock()
+        defer { lock.unlock() }
+
+        guard positionInitialized, let last = self.time else { return nil }
+
+        let dt = (time - last).clamped(to: 0.0...config.maxTimeStep)
+        var s = makeState(at: time)
+        s.position = p + v * dt + 0.5 * accel * dt * dt
+        s.velocity = v + accel * dt
+
+        return s
+    }
+
+    // MARK: Measurements
+
+    /// Processes an IMU sample: prediction with acceleration and gyro, yaw correction.
+    public func update(imu: Imu, at time: CFTimeInterval = CACurrentMediaTime()) {
+        lock.lock()
+        predict(to: time)
+
+        accel = imu.accel * config.accelScale
+
+        let (roll, pitch, measuredYaw) = imu.orientation.rpy
+        attitude = (roll, pitch)
+
+        if yawInitialized {
+            // Scalar Kalman update, innovation wrapped to [-pi, pi]
+            let innovation = remainder(measuredYaw - yaw, 2.0 * .pi)
+            let k = yawVar / (yawVar + config.yawVariance)
+            yaw = remainder(yaw + k * innovation, 2.0 * .pi)
+            yawVar *= (1.0 - k)
+        } else {
+            yaw = measuredYaw
+            yawVar = config.yawVariance
+            yawInitialized = true
+        }
+
+        // The yaw is predicted with the rate of this sample until the next one
+        yawRate = imu.gyro.z
+
+        let s = positionInitialized ? makeState(at: time) : nil
+        lock.unlock()
+
+        publish(s)
+    }
+
+    /// Processes an MVO sample using its reported covariances.
+    public func update(mvo: Mvo, at time: CFTimeInterval = CACurrentMediaTime()) {
+        lock.lock()
+        predict(to: time)
+
+        let floor = simd_double3x3(diagonal: simd_double3(repeating: config.mvoNoiseFloor))
+        var zMask = config.useProximity ? simd_double3(1.0, 1.0, 0.0) : simd_double3(repeating: 1.0)
+        zMask *= mask(mvo.isValid.pos)
+
+        correctPosition(mvo.position, covariance: mvo.positionCov + floor, mask: zMask)
+        correctVelocity(mvo.velocity, covariance: mvo.velocityCov * config.mvoVelocityCovScale + floor, mask: mask(mvo.isValid.vel))
+
+        let s = positionInitialized ? makeState(at: time) : nil
+        lock.unlock()
+
+        publish(s)
+    }
+
+    /// Processes a VO sample.
+    public func update(vo: Vo, at time: CFTimeInterval = CACurrentMediaTime()) {
+        lock.lock()
+        predict(to: time)
+
+        var zMask = config.useProximity ? simd_double3(1.0, 1.0, 0.0) : simd_double3(repeating: 1.0)
+        zMask *= mask(vo.isValid.pos)
+
+        correctPosition(vo.position, covariance: simd_double3x3(diagonal: simd_double3(repeating: config.voPositionVariance)), mask: zMask)
+        correctVelocity(vo.velocity, covariance: simd_double3x3(diagonal: simd_double3(repeating: config.voVelocityVariance)), mask: mask(vo.isValid.vel))
+
+        let s = positionInitialized ? makeState(at: time) : nil
+        lock.unlock()
+
+        publish(s)
+    }
+
+    /// Processes a proximity (altitude) sample.
+    public func update(proximity: Double, at time: CFTimeInterval = CACurrentMediaTime()) {
+        lock.lock()
+        guard config.useProximity, positionInitialized else {
+            lock.unlock()
+            return
+        }
+        predict(to: time)
+
+        correctPosition(simd_double3(0.0, 0.0, proximity),
+                        covariance: simd_double3x3(diagonal: simd_double3(repeating: config.proximityVariance)),
+                        mask: simd_double3(0.0, 0.0, 1.0))
+
+        let s = makeState(at: time)
+        lock.unlock()
+
+        publish(s)
+    }
+
+    // MARK: Filter
+
+    private func predict(to now: CFTimeInterval) {
+        defer { time = now }
+        guard let last = time else { return }
+
+        let dt = now - last
+        guard dt > 0.0 else { return }
+
+        if yawInitialized {
+            yaw = remainder(yaw + yawRate * dt, 2.0 * .pi)
+            yawVar += config.yawRateNoise * dt
+        }
+
+        guard positionInitialized else { return }
+
+        if dt > config.maxTimeStep {
+            // Lost track of velocity, keep the position
+            v = .zero
+            vv = simd_double3x3(diagonal: simd_double3(repeating: 1.0))
+            pv = simd_double3x3()
+            return
+        }
+
+        // Constant acceleration model: p += v dt + a dt^2 / 2, v += a dt
+        p += v * dt + 0.5 * accel * dt * dt
+        v += accel * dt
+
+        // P = F P F' + Q, with F = [I, I dt; 0, I]
+        let q = config.accelNoise * dt
+        let dt2 = dt * dt
+        pp = pp + dt * (pv + pv.transpose) + dt2 * vv + simd_double3x3(diagonal: simd_double3(repeating: q * dt2 * dt2 / 4.0))
+        pv = pv + dt * vv + simd_double3x3(diagonal: simd_double3(repeating: q * dt2 * dt / 2.0))
+        vv = vv + simd_double3x3(diagonal: simd_double3(repeating: q * dt2))
+    }
+
+    /// Kalman update with position measurement `z`. Axes with zero `mask` are ignored.
+    private func correctPosition(_ z: simd_double3, covariance: simd_double3x3, mask: simd_double3) {
+        guard mask != .zero else { return }
+        let r = masked(covariance, mask)
+
+        guard positionInitialized else {
+            // Initialize from the first full position measurement
+            guard mask == simd_double3(repeating: 1.0) || (config.useProximity && mask == simd_double3(1.0, 1.0, 0.0)) else { return }
+
+            p = z * mask
+            v = .zero
+            corrected.replace(with: time ?? -.infinity, where: mask .!= 0.0)
+            pp = covariance + simd_double3x3(diagonal: simd_double3(1.0, 1.0, 1.0) - mask)
+            pv = simd_double3x3()
+            vv = simd_double3x3(diagonal: simd_double3(repeating: 1.0))
+            positionInitialized = true
+            return
+        }
+
+        let y = (z - p) * mask
+        let sInv = (pp + r).inverse
+
+        guard simd_dot(y, sInv * y) <= config.gate else {
+            rejected += 1
+            return
+        }
+
+        // K = [pp; pv'] S^-1
+        let kp = pp * sInv
+        let kv = pv.transpose * sInv
+
+        p += kp * y
+        v += kv * y
+        corrected.replace(with: time ?? -.infinity, where: mask .!= 0.0)
+
+        // P = (I - K H) P, H = [I, 0]
+        let newPp = pp - kp * pp
+        let newPv = pv - kp * pv
+        let newVv = vv - kv * pv
+
+        pp = symmetric(newPp)
+        pv = newPv
+        vv = symmetric(newVv)
+    }
+
+    /// Kalman update with velocity measurement `z`. Axes with zero `mask` are ignored.
+    private func correctVelocity(_ z: simd_double3, covariance: simd_double3x3, mask: simd_double3) {
+        guard positionInitialized, mask != .zero else { return }
+        let r = masked(covariance, mask)
+
+        let y = (z - v) * mask
+        let sInv = (vv + r).inverse
+
+        guard simd_dot(y, sInv * y) <= config.gate else {
+            rejected += 1
+            return
+        }
+
+        // K = [pv; vv] S^-1
+        let kp = pv * sInv
+        let kv = vv * sInv
+
+        p += kp * y
+        v += kv * y
+
+        // P = (I - K H) P, H = [0, I]
+        let newPp = pp - kp * pv.transpose
+        let newPv = pv - kp * vv
+        let newVv = vv - kv * vv
+
+        pp = symmetric(newPp)
+        pv = newPv
+        vv = symmetric(newVv)
+    }
+
+    private func makeState(at now: CFTimeInterval) -> EstimatedState {
+        let posVar = simd_double3(pp[0, 0], pp[1, 1], pp[2, 2])
+        let velVar = simd_double3(vv[0, 0], vv[1, 1], vv[2, 2])
+        let pos = (posVar .<= config.maxPositionVariance) .& (now - corrected .<= simd_double3(repeating: config.maxCorrectionAge))
+        let vel = velVar .<= config.maxVelocityVariance
+
+        return EstimatedState(velocity: v,
+                              velocityCov: vv,
+                              position: p,
+                              positionCov: pp,
+                              positionVelocityCov: pv,
+                              orientation: simd_quatd(roll: attitude.roll, pitch: attitude.pitch, yaw: yaw),
+                              yaw: yaw,
+                              yawVariance: yawVar,
+                              timestamp: time ?? 0.0,
+                              isValid: IsValidVelPos(vel: IsValid(x: vel[0], y: vel[1], z: vel[2]),
+                                                     pos: IsValid(x: pos[0], y: pos[1], z: pos[2])))
+    }
+
+    private func publish(_ s: EstimatedState?) {
+        guard let s = s else { return }
+        state <- s
+    }
+
+    // MARK: Helpers
+
+    private func mask(_ isValid: IsValid) -> simd_double3 {
+        return simd_double3(isValid.x ? 1.0 : 0.0, isValid.y ? 1.0 : 0.0, isValid.z ? 1.0 : 0.0)
+    }
+
+    /// Decouples the ignored axes and makes their variance huge, so they do not affect the update.
+    private func masked(_ cov: simd_double3x3, _ mask: simd_double3) -> simd_double3x3 {
+        let m = simd_double3x3(diagonal: mask)
+        return m * cov * m + simd_double3x3(diagonal: (simd_double3(repeating: 1.0) - mask) * 1e12)
+    }
+
+    private func symmetric(_ m: simd_double3x3) -> simd_double3x3 {
+        return 0.5 * (m + m.transpose)
+    }
+}
@@ -0,0 +1,241 @@
+//
+//  SwarmWorld.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+/// Shared simulation of many drones flying in one room.
+///
+/// Every agent is a `QuadrotorSimulator` connected, as its transport, to its own `Tello`,
+/// so the whole stack of every drone runs in process. All simulators share the world time
+/// and the room frame: the position a drone reports is its position in the room.
+///
+/// On top of the single drone model, the agents interact:
+/// - prop-wash: a flying drone pushes down the drones below it, with a Gaussian wake
+///   in the horizontal distance that decays with the vertical distance;
+/// - Wi-Fi contention: all sticks and sensor packets share one channel. Its utilization over
+///   the previous tick queues the packets of the next tick (M/M/1 waiting time), and, once the
+///   offered load exceeds the channel capacity, drops the excess.
+///
+/// The world advances in ticks of `tickInterval`. At the start of a tick the agents are partitioned
+/// into cells of a horizontal grid, as large as the wake. The cells are then stepped in parallel
+/// with `DispatchQueue.concurrentPerform`: each cell computes the wash on its agents from the agents in its
+/// own and the 8 neighboring cells, as they were at the start of the tick, and steps its agents through the tick.
+/// The interactions are frozen during a tick, so the result does not depend on the thread scheduling
+/// and the same configuration always produces the same flight.
+///
+///     let world = SwarmWorld(positions: (0..<100).map { simd_double2(Double($0 % 10), Double($0 / 10)) })
+///     world.agents.forEach { $0.tello.connect(); _ = $0.tello.takeoff() }
+///     world.run(for: 5.0)
+///
+/// - Remark: Step from a single thread, e.g. a background queue, so the main queue keeps delivering
+///   the `Sensor` values of the drones. `Tello` callbacks of different agents run concurrently.
+public final class SwarmWorld {
+    /// Downwash under a flying drone.
+    public struct PropWash {
+        /// Downward acceleration right under a drone, m/s^2.
+        public var strength: Double = 2.0
+        /// Standard deviation of the wake in the horizontal distance, m.
+        public var radius: Double = 0.15
+        /// Vertical distance the wake decays by e over, m.
+        public var decay: Double = 0.5
+        /// Largest vertical and horizontal distance the wake reaches, m. The size of the grid cells.
+        public var range: Double = 1.5
+
+        public init() {}
+    }
+
+    /// Shared Wi-Fi channel.
+    public struct WiFi {
+        /// Time a packet occupies the channel, with the contention overhead, s.
+        public var airtime: Double = 0.0001
+        /// Latency added to every packet on an idle channel, s.
+        public var baseLatency: Double = 0.002
+        /// Longest queueing delay, reached on a saturated channel, s.
+        public var maxQueueDelay: Double = 0.5
+        /// Packets per second per drone not simulated otherwise, e.g. the video stream.
+        public var backgroundRate: Double = 0.0
+
+        public init() {}
+    }
+
+    /// World parameters.
+    public struct Configuration {
+        /// Configuration of all agents. `seed`, `initialPosition` and `initialYaw` are set per agent.
+        public var agent = QuadrotorSimulator.Configuration()
+        /// Seed of the first agent, the following agents use the next seeds.
+        public var seed: UInt64 = 0
+        /// Interval the interactions are updated at, s. Rounded to whole agent time steps.
+        public var tickInterval: Double = 0.02
+        public var propWash = PropWash()
+        public var wifi = WiFi()
+
+        public init() {}
+    }
+
+    /// A simulated drone and the `Tello` flying it.
+    public struct Agent {
+        public let simulator: QuadrotorSimulator
+        public let tello: Tello
+    }
+
+    public let configuration: Configuration
+    public let agents: [Agent]
+
+    /// Current world time, s.
+    public private(set) var time: CFTimeInterval = 0.0
+    /// Fraction of the channel capacity offered over the tick before the last one, which sets the delay
+    /// and loss of the next tick. Above one the channel drops packets.
+    public private(set) var channelUtilization: Double = 0.0
+
+    private let stepsPerTick: Int
+    private let cellSize: Double
+
+    /// Creates landed agents at the positions.
+    ///
+    /// - Parameters:
+    ///   - positions: Start position of each agent in the room, m.
+    ///   - yaws: Start heading of each agent, rad. Agents without one keep `configuration.agent.initialYaw`.
+    public init(positions: [simd_double2], yaws: [Double] = [], configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+
+        stepsPerTick = Swift.max(Int((configuration.tickInterval / configuration.agent.timeStep).rounded()), 1)
+        cellSize = Swift.max(configuration.propWash.range, 1e-3)
+
+        agents = positions.enumerated().map { i, position in
+            var config = configuration.agent
+            config.seed = configuration.seed &+ UInt64(i)
+            config.initialPosition = position
+            if i < yaws.count {
+                config.initialYaw = yaws[i]
+            }
+
+            let simulator = QuadrotorSimulator(configuration: config)
+            return Agent(simulator: simulator, tello: Tello(transport: simulator))
+        }
+    }
+
+    // MARK: Stepping
+
+    /// Advances all agents by one tick.
+    public func step() {
+        let states = agents.map { $0.simulator.state }
+
+        // Spatial partition, cells are visited in the order they were first occupied
+        var cellIndex: [SIMD2<Int>: Int] = [:]
+        var cells: [[Int]] = []
+        for (i, state) in states.enumerated() {
+            let key = cell(of: state.position)
+            if let index = cellIndex[key] {
+                cells[index].append(i)
+            } else {
+                cellIndex[key] = cells.count
+                cells.append([i])
+            }
+        }
+
+        let link = self.link()
+        let steps = stepsPerTick
+
+        var packets = [Int](repeating: 0, count: cells.count)
+        packets.withUnsafeMutableBufferPointer { buffer in
+            DispatchQueue.concurrentPerform(iterations: cells.count) { c in
+                var count = 0
+                for i in cells[c] {
+                    let downwash = wash(on: i, states: states, cellIndex: cellIndex, cells: cells)
+                    let simulator = agents[i].simulator
+                    count += simulator.exchange(externalAcceleration: simd_double3(0.0, 0.0, -downwash),
+                                                linkDelay: link.delay, linkLoss: link.loss)
+                    for _ in 0..<steps {
+                        simulator.step()
+                    }
+                }
+                buffer[c] = count
+            }
+        }
+
+        // The exchange reports the packets before stepping, i.e. those of the previous tick
+        let tick = Double(steps) * configuration.agent.timeStep
+        let offered = Double(packets.reduce(0, +)) + configuration.wifi.backgroundRate * Double(agents.count) * tick
+        channelUtilization = offered * configuration.wifi.airtime / tick
+
+        time += tick
+    }
+
+    /// Steps the world for `duration` seconds of world time.
+    public func run(for duration: CFTimeInterval) {
+        let ticks = Int((duration / (Double(stepsPerTick) * configuration.agent.timeStep)).rounded())
+        for _ in 0..<Swift.max(ticks, 0) {
+            step()
+        }
+    }
+
+    /// Steps the world until `condition` holds, checked after every tick.
+    ///
+    /// - Returns: `false` if `timeout` seconds of world time passed first.
+    @discardableResult
+    public func run(until condition: () -> Bool, timeout: CFTimeInterval) -> Bool {
+        let ticks = Int((timeout / (Double(stepsPerTick) * configuration.agent.timeStep)).rounded())
+        for _ in 0..<Swift.max(ticks, 0) {
+            step()
+            if condition() {
+                return true
+            }
+        }
+        return false
+    }
+
+    // MARK: Interactions
+
+    private func cell(of position: simd_double3) -> SIMD2<Int> {
+        return SIMD2<Int>(Int(floor(position.x / cellSize)), Int(floor(position.y / cellSize)))
+    }
+
+    /// Downward acceleration of agent `i` in the wakes of the flying agents above it.
+    private func wash(on i: Int, states: [QuadrotorSimulator.State], cellIndex: [SIMD2<Int>: Int], cells: [[Int]]) -> Double {
+        let w = configuration.propWash
+        guard w.strength > 0.0, w.radius > 0.0 else { return 0.0 }
+
+        let position = states[i].position
+        let center = cell(of: position)
+        var res = 0.0
+
+        for dx in -1...1 {
+            for dy in -1...1 {
+                guard let index = cellIndex[center &+ SIMD2<Int>(dx, dy)] else { continue }
+
+                for j in cells[index] where j != i {
+                    let other = states[j]
+                    let height = other.position.z - position.z
+                    guard other.flightState != .landed, height > 0.0, height < w.range else { continue }
+
+                    let offset = simd_double2(other.position.x - position.x, other.position.y - position.y)
+                    let distance2 = simd_length_squared(offset)
+                    guard distance2 < w.range * w.range else { continue }
+
+                    res += w.strength * exp(-distance2 / (2.0 * w.radius * w.radius) - height / w.decay)
+                }
+            }
+        }
+
+        return res
+    }
+
+    /// Delay and loss of the packets of the next tick, from the utilization of the last one.
+    private func link() -> (delay: Double, loss: Double) {
+        let wifi = configuration.wifi
+        let u = channelUtilization
+
+        guard u < 1.0 else {
+            // Saturated: the excess is dropped, the rest waits in full queues
+            return (wifi.baseLatency + wifi.maxQueueDelay, 1.0 - 1.0 / u)
+        }
+
+        let queueing = Swift.min(wifi.airtime * u / (1.0 - u), wifi.maxQueueDelay)
+        return (wifi.baseLatency + queueing, 0.0)
+    }
+}
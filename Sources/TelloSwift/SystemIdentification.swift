@@ -0,0 +1,289 @@
+//
+//  SystemIdentification.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+import Transform
+
+/// Offline identification of the drone response to sticks commands.
+///
+/// Each axis is modeled as a first-order process with dead time (FOPDT) from the control
+/// to the velocity in body frame: `timeConstant * dv/dt + v = gain * u(t - delay)`.
+/// Controls are taken in `PositionController` convention, i.e. a positive control moves the axis
+/// in the positive direction. Lanes are x, y, z, and yaw.
+///
+/// Recordings are resampled to a uniform grid and reduced to least-squares statistics of the discrete
+/// model `v[k+1] = a * v[k] + b * u[k - d]` for every delay `d` of the grid, in parallel across flights.
+/// The statistics of all flights are summed, and the delay with the smallest residual is selected per axis.
+public struct SystemIdentification {
+    /// Source of the measured velocity.
+    public enum VelocitySource {
+        case mvo
+        case vo
+    }
+
+    /// Identification and tuning parameters.
+    public struct Configuration {
+        /// Resampling period, s. Defaults to the sticks rate.
+        public var sampleTime: Double = 0.05
+        /// Longest delay to consider, s.
+        public var maxDelay: Double = 0.6
+        /// Samples further apart than this are not interpolated, s.
+        public var maxGap: Double = 0.3
+        /// Source of the measured velocity.
+        public var velocitySource: VelocitySource = .mvo
+        /// Least number of samples for an axis model.
+        public var minSamples: Int = 100
+        /// Desired closed-loop time constant relative to the delay, 1 is the tight SIMC setting.
+        public var closedLoopTimeFactor: Double = 1.0
+        /// Shortest desired closed-loop time constant, s.
+        public var minClosedLoopTime: Double = 0.3
+        /// Suggest integral gains. The position loop is integrating, so it does not need them to reach the target.
+        public var integralAction: Bool = false
+
+        public init() {}
+    }
+
+    /// Identified response of an axis.
+    public struct AxisModel {
+        /// Steady-state velocity per unit of control, m/s or rad/s.
+        public var gain: Double
+        /// Dead time, s.
+        public var delay: Double
+        /// Time constant, s.
+        public var timeConstant: Double
+        /// Fraction of the output variance explained by the model, up to 1.
+        public var fit: Double
+        /// Number of samples used.
+        public var samples: Int
+    }
+
+    /// Identified models, `nil` for axes without enough excitation or with an implausible fit.
+    public struct Result {
+        public var x: AxisModel?
+        public var y: AxisModel?
+        public var z: AxisModel?
+        public var yaw: AxisModel?
+    }
+
+    // Least-squares sums of one delay, per lane
+    private struct Statistics {
+        var yy = simd_double4.zero
+        var yu = simd_double4.zero
+        var uu = simd_double4.zero
+        var ny = simd_double4.zero
+        var nu = simd_double4.zero
+        var nn = simd_double4.zero
+        var n = simd_double4.zero
+        var count = simd_double4.zero
+
+        static func + (lhs: Statistics, rhs: Statistics) -> Statistics {
+            return Statistics(yy: lhs.yy + rhs.yy, yu: lhs.yu + rhs.yu, uu: lhs.uu + rhs.uu,
+                              ny: lhs.ny + rhs.ny, nu: lhs.nu + rhs.nu, nn: lhs.nn + rhs.nn,
+                              n: lhs.n + rhs.n, count: lhs.count + rhs.count)
+        }
+    }
+
+    public var configuration: Configuration
+
+    public init(configuration: Configuration = Configuration()) {
+        self.configuration = configuration
+    }
+
+    /// Identifies the axis models from the recorded flights. Flights are processed in parallel.
+    public func identify(_ flights: [FlightRecording]) -> Result {
+        let delays = Int((configuration.maxDelay / configuration.sampleTime).rounded()) + 1
+
+        var partial = [[Statistics]](repeating: [], count: flights.count)
+        partial.withUnsafeMutableBufferPointer { buffer in
+            DispatchQueue.concurrentPerform(iterations: flights.count) { i in
+                buffer[i] = statistics(of: flights[i], delays: delays)
+            }
+        }
+
+        var total = [Statistics](repeating: Statistics(), count: delays)
+        for stats in partial where !stats.isEmpty {
+            for d in 0..<delays {
+                total[d] = total[d] + stats[d]
+            }
+        }
+
+        var best = [AxisModel?](repeating: nil, count: 4)
+        var bestResidual = [Double](repeating: .infinity, count: 4)
+
+        for d in 0..<delays {
+            let s = total[d]
+            let det = s.yy * s.uu - s.yu * s.yu
+            let a = (s.ny * s.uu - s.nu * s.yu) / det
+            let b = (s.nu * s.yy - s.ny * s.yu) / det
+            let residual = s.nn - a * s.ny - b * s.nu
+            let variance = s.nn - s.n * s.n / s.count
+
+            for lane in 0..<4 {
+                // Stable, non-oscillating discrete pole and enough samples
+                guard s.count[lane] >= Double(configuration.minSamples), det[lane] > 0.0,
+                      a[lane] > 0.0, a[lane] < 1.0, residual[lane] < bestResidual[lane] else { continue }
+
+                bestResidual[lane] = residual[lane]
+                best[lane] = AxisModel(gain: b[lane] / (1.0 - a[lane]),
+                                       delay: Double(d) * configuration.sampleTime,
+                                       timeConstant: -configuration.sampleTime / log(a[lane]),
+                                       fit: variance[lane] > 0.0 ? 1.0 - residual[lane] / variance[lane] : 0.0,
+                                       samples: Int(s.count[lane]))
+            }
+        }
+
+        return Result(x: best[0], y: best[1], z: best[2], yaw: best[3])
+    }
+
+    /// Suggests position controller gains for the identified models, in `Pid.dictionary()` format.
+    ///
+    /// Uses SIMC rules for an integrating process with lag, since the position integrates the velocity.
+    /// Deadbands and window sizes are copied from `current`, if given.
+    ///
+    /// - Returns: Dictionaries keyed by axis: `x`, `y`, `z`, and `yaw`. Axes without a model are omitted.
+    public func suggestedPids(for result: Result, current: (x: Pid, y: Pid, z: Pid, yaw: Pid)? = nil) -> [String: Dictionary<String, Any>] {
+        let axes: [(String, AxisModel?, Pid?)] = [("x", result.x, current?.x),
+                                                  ("y", result.y, current?.y),
+                                                  ("z", result.z, current?.z),
+                                                  ("yaw", result.yaw, current?.yaw)]
+        var res: [String: Dictionary<String, Any>] = [:]
+
+        for (axis, model, pid) in axes {
+            guard let model = model else { continue }
+            guard model.gain > 0.0 else {
+                print("error: Axis \(axis) responds in the opposite direction (gain \(model.gain)), no gains suggested")
+                continue
+            }
+
+            // Series PID for k * exp(-delay * s) / (s * (timeConstant * s + 1))
+            let tc = Swift.max(configuration.closedLoopTimeFactor * model.delay, configuration.minClosedLoopTime)
+            let kc = 1.0 / (model.gain * (tc + model.delay))
+            let ti = 4.0 * (tc + model.delay)
+            let td = model.timeConstant
+
+            // Converted to the parallel form of `Pid`
+            let p = kc * (1.0 + td / ti)
+            let i = configuration.integralAction ? p / (ti + td) : 0.0
+            let d = p * ti * td / (ti + td)
+
+            if let suggested = Pid(p: p, i: i, d: d,
+                                   deadband: pid?.deadband ?? 0.001,
+                                   windowSize: pid?.windowSize ?? 5) {
+                res[axis] = suggested.dictionary()
+            }
+        }
+
+        return res
+    }
+
+    /// Resamples a flight and accumulates the least-squares statistics for every delay.
+    private func statistics(of flight: FlightRecording, delays: Int) -> [Statistics] {
+        let (inputs, outputs) = resample(flight)
+        var stats = [Statistics](repeating: Statistics(), count: delays)
+
+        guard outputs.count > delays else { return stats }
+
+        for k in (delays - 1)..<(outputs.count - 1) {
+            let current = outputs[k]
+            let following = outputs[k + 1]
+            // NaN is not equal to itself
+            let measured = (current .== current) .& (following .== following)
+
+            for d in 0..<delays {
+                let control = inputs[k - d]
+                let valid = measured .& (control .== control)
+                let y = current.replacing(with: 0.0, where: .!valid)
+                let next = following.replacing(with: 0.0, where: .!valid)
+                let u = control.replacing(with: 0.0, where: .!valid)
+
+                stats[d].yy += y * y
+                stats[d].yu += y * u
+                stats[d].uu += u * u
+                stats[d].ny += next * y
+                stats[d].nu += next * u
+                stats[d].nn += next * next
+                stats[d].n += next
+                stats[d].count += simd_double4.one.replacing(with: 0.0, where: .!valid)
+            }
+        }
+
+        return stats
+    }
+
+    /// Resamples controls and body-frame velocities on a uniform grid. Unknown values are NaN.
+    private func resample(_ flight: FlightRecording) -> (inputs: [simd_double4], outputs: [simd_double4]) {
+        let velocities: [(time: CFTimeInterval, velocity: simd_double3, isValid: IsValidVelPos)]
+        switch configuration.velocitySource {
+        case .mvo:
+            velocities = flight.mvo.map { ($0.time, $0.value.velocity, $0.value.isValid) }
+        case .vo:
+            velocities = flight.vo.map { ($0.time, $0.value.velocity, $0.value.isValid) }
+        }
+
+        guard let sticksStart = flight.sticks.first?.time, let sticksEnd = flight.sticks.last?.time,
+              let velStart = velocities.first?.time, let velEnd = velocities.last?.time,
+              let imuStart = flight.imu.first?.time, let imuEnd = flight.imu.last?.time else { return ([], []) }
+
+        let start = Swift.max(sticksStart, velStart, imuStart)
+        let end = Swift.min(sticksEnd, velEnd, imuEnd)
+        guard end > start else { return ([], []) }
+
+        let ts = configuration.sampleTime
+        let count = Int((end - start) / ts) + 1
+        var inputs = [simd_double4]()
+        var outputs = [simd_double4]()
+        inputs.reserveCapacity(count)
+        outputs.reserveCapacity(count)
+
+        var s = 0, v = 0, m = 0
+        for k in 0..<count {
+            let t = start + Double(k) * ts
+
+            while s + 1 < flight.sticks.count && flight.sticks[s + 1].time <= t { s += 1 }
+            while v + 1 < velocities.count && velocities[v + 1].time <= t { v += 1 }
+            while m + 1 < flight.imu.count && flight.imu[m + 1].time <= t { m += 1 }
+
+            // Sticks are held between commands
+            let sticks = flight.sticks[s]
+            if t - sticks.time <= configuration.maxGap {
+                let c = sticks.value
+                inputs.append(simd_double4(c.pitch ?? 0.0, -(c.roll ?? 0.0), c.thrust ?? 0.0, -(c.yaw ?? 0.0)))
+            } else {
+                inputs.append(simd_double4(repeating: .nan))
+            }
+
+            // Yaw and yaw rate are held between IMU samples
+            let imu = flight.imu[m]
+            guard t - imu.time <= configuration.maxGap, v + 1 < velocities.count,
+                  velocities[v + 1].time - velocities[v].time <= configuration.maxGap else {
+                outputs.append(simd_double4(repeating: .nan))
+                continue
+            }
+
+            // Velocities are interpolated
+            let a = velocities[v], b = velocities[v + 1]
+            let w = (t - a.time) / (b.time - a.time)
+            let vel = a.velocity + (b.velocity - a.velocity) * w
+            let planar = a.isValid.vel.x && a.isValid.vel.y && b.isValid.vel.x && b.isValid.vel.y
+            let vertical = a.isValid.vel.z && b.isValid.vel.z
+
+            // Rotate to body frame
+            let yaw = imu.value.orientation.rpy.yaw
+            let bx = cos(yaw) * vel.x + sin(yaw) * vel.y
+            let by = -sin(yaw) * vel.x + cos(yaw) * vel.y
+
+            outputs.append(simd_double4(planar ? bx : .nan,
+                                        planar ? by : .nan,
+                                        vertical ? vel.z : .nan,
+                                        imu.value.gyro.z))
+        }
+
+        return (inputs, outputs)
+    }
+}
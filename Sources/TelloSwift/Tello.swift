@@ -10,6 +10,7 @@ import Foundation
 import Network
 import simd
 import Combine
+import QuartzCore.CoreAnimation
 
 import Transform
 import TelloSwiftObjC
@@ -63,12 +64,16 @@ public enum PositionSource {
     case mvo
     case vo
     case mvoProximity
+    /// Fused estimate of `Tello.estimator`.
+    case ekf
     case user(Sensor<AnyPositionMeasurement>)
 }
 
 /// Orientation source for position controller.
 public enum OrientationSource {
     case imu
+    /// Fused estimate of `Tello.estimator`.
+    case ekf
     case user(Sensor<AnyOrientationMeasurement>)
 }
 
@@ -93,6 +98,13 @@ public class Tello {
 
     private var connection: NWConnection?
     private let netQueue: DispatchQueue
+    // Replaces the connection if set, e.g. by a simulator
+    private let transport: TelloTransport?
+
+    /// Time base of the sensors, the estimator and the control loop.
+    ///
+    /// `CACurrentMediaTime()`, or the time of the transport if created with one.
+    public let clock: () -> CFTimeInterval
 
     private var connTimer: Timer?
     public private(set) var timeoutInterval: TimeInterval = 2.0
@@ -103,9 +115,29 @@ public class Tello {
     private var messageHandlers: [MessageId:((PacketPreambula, Data?) -> Void)] = [:]
 
     private var posCtrl: PositionController
-    private var ctrl: QuadrotorControls
 
-    public var fastMode: Bool = false
+    /// Sticks command sent by the keep-alive timer.
+    private struct StickCommand {
+        var controls: QuadrotorControls
+        var fastMode: Bool
+    }
+
+    // Written by the controller and the user, read by the keep-alive timer on a background queue
+    private let stickCommand = SeqLock(StickCommand(controls: QuadrotorControls(roll: 0.0, pitch: 0.0, yaw: 0.0, thrust: 0.0),
+                                                    fastMode: false))
+
+    private var ctrl: QuadrotorControls {
+        get { stickCommand.load().controls }
+        set { stickCommand.update { $0.controls = newValue } }
+    }
+
+    public var fastMode: Bool {
+        get { stickCommand.load().fastMode }
+        set { stickCommand.update { $0.fastMode = newValue } }
+    }
+    /// Maximum time difference between matched MVO and proximity measurements
+    /// for `.mvoProximity` position source, in seconds.
+    public var mvoProximitySlop: TimeInterval = 0.05
     public var resetOriginOnTakeoff: Bool = true
     /* Debug stuff */
     private let stopWatch: StopWatch = StopWatch(maxWindow: 100)
@@ -138,6 +170,27 @@ public class Tello {
     public private(set) var vo  = Sensor<Vo>()
     /// Proximity.
     public private(set) var proximity = Sensor<Double>()
+    /// Sticks commands sent to the drone, updated on the thread that sends them.
+    public private(set) var sticks = Sensor<QuadrotorControls>(bufferingPolicy: .latest)
+
+    /// State estimator fusing IMU, MVO, VO and proximity measurements.
+    public let estimator = StateEstimator()
+    /// Predicts the estimator state at the moment the sticks commands reach the drone.
+    public let predictor: PosePredictor
+
+    /// Rate of the control loop started by `setControllerSourcePredicted()`, in Hz.
+    ///
+    /// Clamped to `ControlLoop.rateLimits`. Applies the next time the source is set.
+    public var controlRate: Double = 20.0
+    /// Control loop driving the position controller, if started by `setControllerSourcePredicted()`.
+    public private(set) var controlLoop: ControlLoop?
+    // The control loop sends the sticks instead of the keep-alive timer
+    private let controlLoopActive = SeqLock(false)
+    // Time of the pending connection request, to measure the link round trip
+    private var connReqTime: CFTimeInterval?
+
+    /// Relay-feedback autotuner of the position controller, see `autotune(_:configuration:)`.
+    public private(set) lazy var autotuner = Autotuner(controller: self.posCtrl, flightState: self.flightState)
 
     /// Controller data streams.
     public private(set) lazy var controller = (state: self.posCtrl.state,
@@ -152,7 +205,10 @@ public class Tello {
     /// - Parameters:
     ///   - host: IP address or hostname of the drone. Defaults to `192.168.10.1`.
     ///   - port: Tello control port. Defaults to `8889`.
-    public init(host: String = "192.168.10.1", port: UInt16 = 8889) {
+    ///   - transport: link to use instead of the UDP connection, e.g. `QuadrotorSimulator`.
+    ///     Host and port are ignored then. The controller is driven by `setControllerSourcePredicted()`,
+    ///     stepped by the transport; sensor-driven sources run on the wall clock.
+    public init(host: String = "192.168.10.1", port: UInt16 = 8889, transport: TelloTransport? = nil) {
         connectionState <- .disconnected
         flightState <- .unknown
 
@@ -161,6 +217,13 @@ public class Tello {
 
         self.netQueue = DispatchQueue(label: "ch.volaly.tellokit.network", qos: .utility)
 
+        self.transport = transport
+        if let transport = transport {
+            self.clock = { transport.now() }
+        } else {
+            self.clock = CACurrentMediaTime
+        }
+
 //        posCtrl = PositionController(x:   Pid(p: 0.9, i: 0.007, d: 0.08, deadband: 0.01)!,
 //                                     y:   Pid(p: 0.9, i: 0.007, d: 0.08, deadband: 0.01)!,
 //                                     z:   Pid(p: 2.0, i: 0.005, d: 0.01,  deadband: 0.05)!,
@@ -171,10 +234,23 @@ public class Tello {
                                      z:   Pid(p: 2.0, i: 0.005, d: 0.01, deadband: 0.05)!,
                                      yaw: Pid(p: 0.7, i: 0.0, d: 0.5,  deadband: deg2rad(1.0))!)
 
-        ctrl = QuadrotorControls(roll: 0.0, pitch: 0.0, yaw: 0.0, thrust: 0.0)
+        predictor = PosePredictor(estimator: estimator)
+
+        // Feed the estimator on the network thread as the measurements arrive
+        let estimator = self.estimator
+        let clock = self.clock
+        imu.observe { estimator.update(imu: $0, at: clock()) }
+        mvo.observe { estimator.update(mvo: $0, at: clock()) }
+        vo.observe { estimator.update(vo: $0, at: clock()) }
+        proximity.observe { estimator.update(proximity: $0, at: clock()) }
 
         // Set default sensor sources for controller
-        setControllerSource(position: .vo, orientation: .imu)
+        if transport != nil {
+            // Runs in the time of the transport
+            setControllerSourcePredicted()
+        } else {
+            setControllerSource(position: .vo, orientation: .imu)
+        }
 
         setMessageHandler(messageId: .flightMsg, callback: flightDataHandler)
         setMessageHandler(messageId: .wifiMsg, callback: wifiPacketHandler)
@@ -213,10 +289,9 @@ public class Tello {
             print("ack: palmLandCmd")
         }
 
-        flightState.sink {
-            let newValue = $0
-            let oldValue = self.flightState.value!
-            self.justTookOff =
+        // The value is already updated when the sink is called, so the old one comes from the stream itself
+        flightState.withPrevious(flightState.value).sink { [weak self] oldValue, newValue in
+            self?.justTookOff =
                 (oldValue == .takingOff && newValue == .hovering) ||
                 (oldValue == .landed    && newValue == .hovering)
                 ? true : false
@@ -268,6 +343,7 @@ public class Tello {
             // Any meaningful data?
             if data != nil && isComplete && err == nil {
                 if (String(data: data!, encoding: .ascii)?.starts(with: "conn_ack:"))! {
+                    self.connReqAcknowledged()
                     self.connectionState <- .connected
 
                     self.startKeepAliveTimer()
@@ -280,9 +356,21 @@ public class Tello {
         // Schedule connection timeout timer
         self.timerSet(timeout: timeoutInterval)
         // Send connection request
+        let sent = CACurrentMediaTime()
+        netQueue.async {
+            self.connReqTime = sent
+        }
         sendData(data: conn_req)
     }
 
+    // Must be called on the network queue
+    private func connReqAcknowledged() {
+        if let sent = connReqTime {
+            predictor.setRoundTrip(CACurrentMediaTime() - sent)
+            connReqTime = nil
+        }
+    }
+
     private func startKeepAliveTimer() {
 //        DispatchQueue.main.async {
 //            self.keepAliveTimer?.invalidate()
@@ -297,11 +385,22 @@ public class Tello {
 
     // MARK: Keep Alive Timer
     private func keepAliveCallback(_ : BackgroundTimer) {
-        self.sendSticksData(ctrlRx: self.ctrl.roll ?? 0.0,
-                            ctrlRy: self.ctrl.pitch ?? 0.0,
-                            ctrlLx: self.ctrl.yaw ?? 0.0,
-                            ctrlLy: self.ctrl.thrust ?? 0.0,
-                            fastMode: self.fastMode)
+        guard !controlLoopActive.load() else { return }
+
+        sendStickCommand()
+    }
+
+    private func sendStickCommand() {
+        // Controls and fast mode flag are read together, so they are never mixed from different commands
+        let cmd = stickCommand.load()
+
+        self.sendSticksData(ctrlRx: cmd.controls.roll ?? 0.0,
+                            ctrlRy: cmd.controls.pitch ?? 0.0,
+                            ctrlLx: cmd.controls.yaw ?? 0.0,
+                            ctrlLy: cmd.controls.thrust ?? 0.0,
+                            fastMode: cmd.fastMode)
+
+        sticks.value = cmd.controls
     }
 
     private func receiveData() {
@@ -322,6 +421,7 @@ public class Tello {
                             let wrongCmdData = data!.advanced(by: unknownCmdStr.count + 1) // plus space
                             print(unknownCmdStr, wrongCmdData.hex)
                         } else if str.starts(with: "conn_ack:") {
+                            self.connReqAcknowledged()
                             self.connectionState <- .connected
                         }
                     } else {
@@ -339,6 +439,11 @@ public class Tello {
     }
 
     private func sendData(data: Data) {
+        if let transport = transport {
+            transport.send(data)
+            return
+        }
+
         guard let conn = connection else {return}
 
         //print("send:", data.hexEncodedString())
@@ -364,6 +469,31 @@ public class Tello {
         }
     }
 
+    // MARK: Transport
+    private func transportEventHandler(_ event: TelloTransportEvent) {
+        switch event {
+        case .connected:
+            connectionState <- .connected
+        case .keepAlive:
+            // Step the control loop in the time of the transport, it sends the sticks itself
+            if controlLoopActive.load(), let loop = controlLoop {
+                loop.step()
+            } else {
+                sendStickCommand()
+            }
+        case .flightData(let fd):
+            process(flightData: fd)
+        case .imu(let imu):
+            self.imu <- imu
+        case .mvo(let mvo):
+            self.mvo <- mvo
+        case .vo(let vo):
+            self.vo <- vo
+        case .proximity(let dist):
+            self.proximity <- dist
+        }
+    }
+
     // MARK: Message Handlers
 
     private func setMessageHandler(messageId: MessageId, callback: ((PacketPreambula, Data?) -> Void)?) {
@@ -377,54 +507,56 @@ public class Tello {
     // MARK: Flight Data
     private func flightDataHandler(pre: PacketPreambula, payload: Data?) {
         if let data = payload {
-            let fd = TelloFlightDataParser.flightData(from: data)
-            self.flightData <- fd
+            process(flightData: TelloFlightDataParser.flightData(from: data))
+        } else {
+            print("error: flight data payload is empty")
+        }
+    }
 
-            // TODO: Handle battery state
+    private func process(flightData fd: FlightData) {
+        self.flightData <- fd
 
-            switch(fd.flyMode) {
-            case 1:  // moving
-                if fd.emSky == 1 {
-                    flightState <- .flying
-                } else {
-                    // FIXME: Drone still could be landing while motors are off
+        // TODO: Handle battery state
 
-                    //flightState = .unknown
-                }
-            case 6:  // still
-                if fd.emSky == 1 {
-                    flightState <- .hovering
-                } else {
-                    flightState <- .landed
-                }
-            case 11: // taking off
-                if fd.emSky == 1 {
-                    flightState <- .takingOff
-                } else {
-                    // FIXME: Motors are not running yet but the state is takingOff
-                    // Just before it takes off, the motors are not spinning yet
+        switch(fd.flyMode) {
+        case 1:  // moving
+            if fd.emSky == 1 {
+                flightState <- .flying
+            } else {
+                // FIXME: Drone still could be landing while motors are off
 
-                    //flightState = .unknown
-                }
-            case 12: // landing
-                if fd.emSky == 1 {
-                    flightState <- .landing
-                } else {
-                    // FIXME: Drone still could be landing while motors are off
+                //flightState = .unknown
+            }
+        case 6:  // still
+            if fd.emSky == 1 {
+                flightState <- .hovering
+            } else {
+                flightState <- .landed
+            }
+        case 11: // taking off
+            if fd.emSky == 1 {
+                flightState <- .takingOff
+            } else {
+                // FIXME: Motors are not running yet but the state is takingOff
+                // Just before it takes off, the motors are not spinning yet
 
-                    //flightState = .unknown
-                }
-            default:
                 //flightState = .unknown
-                break
             }
+        case 12: // landing
+            if fd.emSky == 1 {
+                flightState <- .landing
+            } else {
+                // FIXME: Drone still could be landing while motors are off
 
-            if flightState == .unknown {
-                print("warn: Unknown flight state: emSky=\(fd.emSky), flyMode=\(fd.flyMode)")
+                //flightState = .unknown
             }
+        default:
+            //flightState = .unknown
+            break
+        }
 
-        } else {
-            print("error: flight data payload is empty")
+        if flightState == .unknown {
+            print("warn: Unknown flight state: emSky=\(fd.emSky), flyMode=\(fd.flyMode)")
         }
     }
 
@@ -697,7 +829,17 @@ public class Tello {
     ///
     /// The connection state can be monitored through the delegate
     /// method `didUpdateConnectionState()`.
+    ///
+    /// With a transport, the transport is started instead.
     public func connect() {
+        if let transport = transport {
+            connectionState <- .connecting
+            transport.start { [weak self] in
+                self?.transportEventHandler($0)
+            }
+            return
+        }
+
         if connection == nil {
             connection = NWConnection(host: self.host, port: self.port, using: .udp)
         }
@@ -733,6 +875,15 @@ public class Tello {
     ///
     /// Note that this method forcefully lands the drone before disconnecting.
     public func disconnect() {
+        if let transport = transport {
+            guard connectionState != .disconnected else {return}
+
+            land()
+            transport.stop()
+            connectionState <- .disconnected
+            return
+        }
+
         guard let conn = connection else {return}
 
         // FIXME: Wait for acknowledgement
@@ -826,11 +977,12 @@ public class Tello {
     public func manualSticks(roll ctrlRx: Double, pitch ctrlRy: Double, yaw ctrlLx: Double, thrust ctrlLy: Double, fastMode: Bool = false) {
         self.cancelGoTo()
 
-        self.ctrl = QuadrotorControls(roll:   ctrlRx.clamped(to: -1.0...1.0),
-                                      pitch:  ctrlRy.clamped(to: -1.0...1.0),
-                                      yaw:    ctrlLx.clamped(to: -1.0...1.0),
-                                      thrust: ctrlLy.clamped(to: -1.0...1.0))
-        self.fastMode = fastMode
+        // Publish controls and fast mode as a single command
+        stickCommand.store(StickCommand(controls: QuadrotorControls(roll:   ctrlRx.clamped(to: -1.0...1.0),
+                                                                    pitch:  ctrlRy.clamped(to: -1.0...1.0),
+                                                                    yaw:    ctrlLx.clamped(to: -1.0...1.0),
+                                                                    thrust: ctrlLy.clamped(to: -1.0...1.0)),
+                                        fastMode: fastMode))
     }
 
     /// Automatically takes off the drone to a factory-predefined altitude (about 1.0-1.2m)
@@ -839,9 +991,9 @@ public class Tello {
 
         let future = Future<Void, Never>() { promise in
             self.flightState
+                .withPrevious(self.flightState.value)
                 .receive(on: DispatchQueue.global(qos: .userInteractive))
-                .sink { (newState: FlightState) in
-                    let oldState = self.flightState.value!
+                .sink { (oldState: FlightState?, newState: FlightState) in
                     if (oldState == .takingOff && newState == .hovering) || (oldState == .landed && newState == .hovering) {
                         promise(.success(()))
                     }
@@ -858,9 +1010,9 @@ public class Tello {
     public func throwAndGo() -> Future<Void, Never> {
         let future = Future<Void, Never>() { promise in
             self.flightState
+                .withPrevious(self.flightState.value)
                 .receive(on: DispatchQueue.global(qos: .userInteractive))
-                .sink { (newState: FlightState) in
-                    let oldState = self.flightState.value!
+                .sink { (oldState: FlightState?, newState: FlightState) in
                     if (oldState == .takingOff && newState == .hovering) || (oldState == .landed && newState == .hovering) {
                         promise(.success(()))
                     }
@@ -936,6 +1088,17 @@ public class Tello {
         posCtrl.setTarget(target: .init(x: x, y: y, z: z, yaw: yaw))
     }
 
+    /// Moves the drone along a smooth minimum-snap trajectory from its current pose through the waypoints.
+    ///
+    /// Waypoints are in the same frame as for `goTo(x:y:z:yaw:)`, `nil` components keep
+    /// the value of the previous waypoint. The motion is planned within the `limits`.
+    ///
+    /// - Returns: `false` if the current pose is unknown or the trajectory cannot be made.
+    @discardableResult
+    public func goTo(waypoints: [QuadrotorPose], limits: Trajectory.Limits = Trajectory.Limits()) -> Bool {
+        return posCtrl.setTrajectory(waypoints: waypoints, limits: limits)
+    }
+
     /// Rotates the drone to a specified heading.
     ///
     /// - Parameters:
@@ -957,6 +1120,8 @@ public class Tello {
     // MARK: Position Controller
     /// Sets position controller input sources.
     public func setControllerSource(position: PositionSource, orientation: OrientationSource) {
+        stopControlLoop()
+
         var posSensor = Sensor<AnyPositionMeasurement>()
         var oriSensor = Sensor<AnyOrientationMeasurement>()
 
@@ -965,18 +1130,38 @@ public class Tello {
 
         switch position {
         case .mvo:
-            mvo.sink {
+            // Forward on the network thread, so the measurement hops to the main queue only once
+            mvo.observation {
                 posSensor.value = AnyPositionMeasurement($0)
             }.store(in: &controllerSubs)
         case .mvoProximity:
-            mvo.combineLatest(proximity) {
-                return AnyPositionMeasurement(velocity: .zero, position: simd_double3(x: $0.position.x, y: $0.position.y, z: $1), isValid: $0.isValid)
-            }.sink {
-                print($0)
-                posSensor.value = AnyPositionMeasurement($0)
+            // MVO reports at 5 Hz, so match each sample with the closest proximity measurement
+            // instead of the latest one, which might be hundreds of milliseconds old.
+            // Stamped and matched on the network thread, before any hop to the main queue
+            let clock = self.clock
+            let stampedMvo = PassthroughSubject<(Mvo, CFTimeInterval), Never>()
+            let stampedProximity = PassthroughSubject<(Double, CFTimeInterval), Never>()
+            mvo.observation {
+                stampedMvo.send(($0, clock()))
+            }.store(in: &controllerSubs)
+            proximity.observation {
+                stampedProximity.send(($0, clock()))
             }.store(in: &controllerSubs)
+
+            stampedMvo.approximateTimeSync(with: stampedProximity, slop: mvoProximitySlop, queueSize: 10,
+                                           time: { $0.1 }, { $0.1 })
+                .map { stamped, height in
+                    let mvo = stamped.0
+                    return AnyPositionMeasurement(velocity: mvo.velocity, position: simd_double3(x: mvo.position.x, y: mvo.position.y, z: height.0), isValid: mvo.isValid)
+                }.sink {
+                    posSensor.value = $0
+                }.store(in: &controllerSubs)
         case .vo:
-            vo.sink {
+            vo.observation {
+                posSensor.value = AnyPositionMeasurement($0)
+            }.store(in: &controllerSubs)
+        case .ekf:
+            estimator.state.observation {
                 posSensor.value = AnyPositionMeasurement($0)
             }.store(in: &controllerSubs)
         case .user(let userSensor):
@@ -985,7 +1170,11 @@ public class Tello {
 
         switch orientation {
         case .imu:
-            imu.sink {
+            imu.observation {
+                oriSensor.value = AnyOrientationMeasurement($0)
+            }.store(in: &controllerSubs)
+        case .ekf:
+            estimator.state.observation {
                 oriSensor.value = AnyOrientationMeasurement($0)
             }.store(in: &controllerSubs)
         case .user(let userSensor):
@@ -997,6 +1186,54 @@ public class Tello {
             .store(in: &controllerSubs)
     }
 
+    /// Drives the position controller from a fixed-rate `ControlLoop` with the `estimator` state
+    /// predicted to the moment each sticks packet reaches the drone.
+    ///
+    /// The controls are evaluated at `controlRate` instead of the sensors rate and are sent
+    /// to the drone in the same tick. Call `setControllerSource(position:orientation:)` to switch back.
+    public func setControllerSourcePredicted() {
+        stopControlLoop()
+
+        // Clean any previously subscribed sources
+        controllerSubs = []
+        posCtrl.disconnectSources()
+
+        let predictor = self.predictor
+        // Called on the loop thread only
+        var controlling = false
+        let loop = ControlLoop(rate: controlRate, clock: clock, controller: posCtrl, pose: { now in
+            predictor.predict(sendTime: now)
+        }, output: { [weak self] controls, _ in
+            guard let self = self else { return }
+
+            if let controls = controls {
+                self.ctrl = controls
+                controlling = true
+            } else if controlling {
+                // The target is gone: release the sticks once, so manual sticks set afterwards are kept
+                self.ctrl = QuadrotorControls()
+                controlling = false
+            }
+            // The loop also keeps the connection alive
+            if self.connectionState == .connected {
+                self.sendStickCommand()
+            }
+        })
+
+        controlLoop = loop
+        controlLoopActive.store(true)
+        // The transport steps the loop on its keep-alive events
+        if transport == nil {
+            loop.start()
+        }
+    }
+
+    private func stopControlLoop() {
+        controlLoopActive.store(false)
+        controlLoop?.stop()
+        controlLoop = nil
+    }
+
     /// Sets position controller gains.
     ///
     /// - Parameters:
@@ -1046,6 +1283,37 @@ public class Tello {
         }
     }
 
+    /// Selects the algorithm of the position controller: PIDs or model-predictive control.
+    ///
+    /// The targets, trajectories and controller sources stay the same, only the computation of the controls changes.
+    ///
+    /// - Parameters:
+    ///   - algorithm: `.pid`, or `.mpc` with a configured `MpcController`.
+    public func setControllerAlgorithm(_ algorithm: PositionController.Algorithm) {
+        posCtrl.algorithm = algorithm
+    }
+
+    /// Tunes the position controller gains of an axis while hovering, see `Autotuner`.
+    ///
+    /// The suggested gains are not applied, use `setControllerPids(x:y:z:yaw:)` to apply them.
+    /// The tuning is aborted by `cancelGoTo()`, landing, or a position sensor failure.
+    ///
+    /// - Parameters:
+    ///   - axis: axis to tune.
+    ///   - configuration: relay and tuning parameters.
+    public func autotune(_ axis: Autotuner.Axis, configuration: Autotuner.Configuration = Autotuner.Configuration()) -> Future<Autotuner.Tuning, Autotuner.Failure> {
+        let pids = getControllerPids()
+        let current: Pid
+        switch axis {
+        case .x:   current = pids.x
+        case .y:   current = pids.y
+        case .z:   current = pids.z
+        case .yaw: current = pids.yaw
+        }
+
+        return autotuner.tune(axis, current: current, configuration: configuration)
+    }
+
     /// Returns position controller gains.
     ///
     /// - Returns: Taged tuple with corresponding arrays of PID gains for each axis.
@@ -1058,6 +1326,9 @@ public class Tello {
 
     /// Returns position controller PIDs.
     ///
+    /// Only their gains, deadbands and window sizes are used. The controller state, e.g. the integral,
+    /// is kept by the controller engine and is not reflected in the returned PIDs.
+    ///
     /// - Returns: Taged tuple with corresponding Pid objects for each axis.
     public func getControllerPids() -> (x: Pid, y: Pid, z: Pid, yaw: Pid) {
         return (x: posCtrl.pid.x,
@@ -1110,4 +1381,102 @@ public class Tello {
         posCtrl.setOriginToCurrentPose()
     }
 }
+
+#if compiler(>=5.5.2) && canImport(_Concurrency)
+// MARK: Concurrency
+extension Tello {
+    /// Automatically takes off the drone to a factory-predefined altitude (about 1.0-1.2m).
+    ///
+    /// Returns once the drone is hovering, at once if it is hovering already.
+    /// The drone may refuse to take off, e.g. on low battery: cancel the task to stop waiting.
+    public func takeoff() async {
+        guard flightState.value != .hovering else { return }
+
+        _ = await flightState.first(where: { old, new in
+            (old == .takingOff && new == .hovering) || (old == .landed && new == .hovering)
+        }, after: {
+            self.cancelGoTo()
+            self.sendTakeoff()
+        })
+    }
+
+    /// Automatically lands the drone.
+    ///
+    /// The method immediatelly cancels a position controller target and returns once the drone has landed,
+    /// at once if it has landed already. Cancel the task to stop waiting.
+    public func land() async {
+        guard flightState.value != .landed else { return }
+
+        _ = await flightState.first(where: { _, new in
+            new == .landed
+        }, after: {
+            self.cancelGoTo()
+            self.sendLand()
+        })
+    }
+
+    /// Moves the drone to specified `x`, `y`, `z` coordinates in its
+    /// odometry frame and orientation `yaw` in its body frame. See `goTo(x:y:z:yaw:)`.
+    ///
+    /// Completion is detected on the thread that updates the controller, not on the main queue.
+    /// Canceling the task cancels the target.
+    ///
+    /// - Returns: `true` when the controller has converged, `false` if the target was canceled
+    ///   or the controller was reset for any other reason.
+    @discardableResult
+    public func goTo(x: Double?, y: Double?, z: Double?, yaw: Double? = nil) async -> Bool {
+        return await waitForGoTo {
+            self.posCtrl.setTarget(target: .init(x: x, y: y, z: z, yaw: yaw))
+        }
+    }
+
+    /// Moves the drone along a minimum-snap trajectory through the waypoints. See `goTo(waypoints:limits:)`.
+    ///
+    /// Canceling the task cancels the trajectory.
+    ///
+    /// - Returns: `true` when the controller has converged at the last waypoint, `false` if
+    ///   the trajectory cannot be made, was canceled or the controller was reset for any other reason.
+    @discardableResult
+    public func goTo(waypoints: [QuadrotorPose], limits: Trajectory.Limits = Trajectory.Limits()) async -> Bool {
+        // Planned up front, so a failure does not leave the wait below without an end
+        guard let current = posCtrl.input.value,
+              let trajectory = Trajectory(waypoints: [current] + waypoints, limits: limits) else { return false }
+
+        return await waitForGoTo {
+            self.posCtrl.setTrajectory(trajectory)
+        }
+    }
+
+    /// Issues a go-to command and waits until the controller converges or resets.
+    ///
+    /// The command is issued once the state observer is registered, so its outcome is not missed.
+    /// Setting a target moves the controller out of `.idle`, so a cancellation always ends the wait with `.reset`.
+    private func waitForGoTo(_ issue: @escaping () -> Void) async -> Bool {
+        let wait = {
+            await self.posCtrl.state.first(where: { _, new in
+                switch new {
+                case .running(.converged), .reset:
+                    return true
+                default:
+                    return false
+                }
+            }, after: {
+                issue()
+                // Canceled before the target was set, the handler had nothing to cancel
+                if Task.isCancelled {
+                    self.cancelGoTo()
+                }
+            })
+        }
+
+        #if compiler(>=5.6)
+        let state = await withTaskCancellationHandler(operation: wait, onCancel: { self.cancelGoTo() })
+        #else
+        let state = await withTaskCancellationHandler(handler: { self.cancelGoTo() }, operation: wait)
+        #endif
+
+        return state == .running(.converged)
+    }
+}
+#endif
 /* */
@@ -39,13 +39,77 @@ public struct Imu: OrientationMeasurement {
 }
 
 /// Holds VO measurements reported by the drone.
-public struct Vo: PositionMeasurement {
+public struct Vo: PositionMeasurement, Codable {
     public var velocity: simd_double3
     public var position: simd_double3
 
     public var isValid: IsValidVelPos
 }
 
+// MARK: Codable
+
+// simd matrices and quaternions are not Codable, they are coded as columns and as a vector
+
+extension Mvo: Codable {
+    private enum CodingKeys: String, CodingKey {
+        case velocity, velocityCov, position, positionCov, height, heightVariance, isValid
+    }
+
+    public init(from decoder: Decoder) throws {
+        let container = try decoder.container(keyedBy: CodingKeys.self)
+        velocity = try container.decode(simd_double3.self, forKey: .velocity)
+        velocityCov = try container.decodeMatrix(forKey: .velocityCov)
+        position = try container.decode(simd_double3.self, forKey: .position)
+        positionCov = try container.decodeMatrix(forKey: .positionCov)
+        height = try container.decode(Double.self, forKey: .height)
+        heightVariance = try container.decode(Double.self, forKey: .heightVariance)
+        isValid = try container.decode(IsValidVelPos.self, forKey: .isValid)
+    }
+
+    public func encode(to encoder: Encoder) throws {
+        var container = encoder.container(keyedBy: CodingKeys.self)
+        try container.encode(velocity, forKey: .velocity)
+        try container.encode([velocityCov.columns.0, velocityCov.columns.1, velocityCov.columns.2], forKey: .velocityCov)
+        try container.encode(position, forKey: .position)
+        try container.encode([positionCov.columns.0, positionCov.columns.1, positionCov.columns.2], forKey: .positionCov)
+        try container.encode(height, forKey: .height)
+        try container.encode(heightVariance, forKey: .heightVariance)
+        try container.encode(isValid, forKey: .isValid)
+    }
+}
+
+extension Imu: Codable {
+    private enum CodingKeys: String, CodingKey {
+        case accel, gyro, orientation, temperature
+    }
+
+    public init(from decoder: Decoder) throws {
+        let container = try decoder.container(keyedBy: CodingKeys.self)
+        accel = try container.decode(simd_double3.self, forKey: .accel)
+        gyro = try container.decode(simd_double3.self, forKey: .gyro)
+        orientation = simd_quatd(vector: try container.decode(simd_double4.self, forKey: .orientation))
+        temperature = try container.decode(Float.self, forKey: .temperature)
+    }
+
+    public func encode(to encoder: Encoder) throws {
+        var container = encoder.container(keyedBy: CodingKeys.self)
+        try container.encode(accel, forKey: .accel)
+        try container.encode(gyro, forKey: .gyro)
+        try container.encode(orientation.vector, forKey: .orientation)
+        try container.encode(temperature, forKey: .temperature)
+    }
+}
+
+private extension KeyedDecodingContainer {
+    func decodeMatrix(forKey key: Key) throws -> simd_double3x3 {
+        let columns = try decode([simd_double3].self, forKey: key)
+        guard columns.count == 3 else {
+            throw DecodingError.dataCorruptedError(forKey: key, in: self, debugDescription: "Expected 3 columns, got \(columns.count)")
+        }
+        return simd_double3x3(columns)
+    }
+}
+
 /// Flight log records.
 enum FlightLog {
     /// Multimotion visual odometry (?) (MVO).
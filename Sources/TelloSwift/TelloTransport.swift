@@ -0,0 +1,42 @@
+//
+//  TelloTransport.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+
+import TelloSwiftObjC
+
+/// Data delivered by a `TelloTransport`, already parsed and in the frames `Tello` publishes,
+/// i.e. with Z-axis pointing up.
+public enum TelloTransportEvent {
+    /// The link is up.
+    case connected
+    /// The link is ready for the next sticks command.
+    ///
+    /// Replaces the keep-alive timer: `Tello` sends the sticks, or steps its control loop, in response.
+    case keepAlive
+    case flightData(FlightData)
+    case imu(Imu)
+    case mvo(Mvo)
+    case vo(Vo)
+    case proximity(Double)
+}
+
+/// Link to a drone that `Tello` uses in place of the UDP connection, e.g. `QuadrotorSimulator`.
+///
+/// Commands are sent as raw Tello packets, the same ones that go over the network.
+/// Events are delivered synchronously on the thread that produces them. All times are
+/// in the time base of the transport, which becomes `Tello.clock`.
+public protocol TelloTransport: AnyObject {
+    /// Current time, in seconds.
+    func now() -> CFTimeInterval
+    /// Opens the link. `receive` is called with every event until `stop()`.
+    func start(_ receive: @escaping (TelloTransportEvent) -> Void)
+    /// Sends a raw Tello packet.
+    func send(_ packet: Data)
+    /// Closes the link.
+    func stop()
+}
@@ -0,0 +1,335 @@
+//
+//  Trajectory.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore.CoreAnimation
+import simd
+
+/// Reference sampled from a `Trajectory`. Lanes are x, y, z, and yaw.
+public struct TrajectorySample {
+    /// Time since the start of the trajectory, in seconds.
+    public var time: CFTimeInterval
+    /// Desired position and yaw. Yaw is unwrapped, i.e. continuous along the trajectory.
+    public var position: simd_double4
+    /// Desired velocity and yaw rate, the velocity feed-forward.
+    public var velocity: simd_double4
+    /// Desired acceleration and yaw acceleration, the acceleration feed-forward.
+    public var acceleration: simd_double4
+    /// `true` if the time is past the end of the trajectory.
+    public var isFinished: Bool
+
+    /// Desired pose.
+    public var pose: QuadrotorPose {
+        return QuadrotorPose(x: position.x, y: position.y, z: position.z, yaw: position.w)
+    }
+}
+
+/// Minimum-snap trajectory through a list of waypoints.
+///
+/// Each segment between two waypoints is a 7th order polynomial of normalized time.
+/// The trajectory starts and ends at rest (zero velocity, acceleration and jerk), passes through
+/// every waypoint and is continuous up to the 6th derivative at the waypoints, which makes it
+/// the unconstrained minimum-snap solution for the given segment durations.
+///
+/// The coefficients are solved once, at initialization. Sampling is O(1) for increasing times,
+/// which is the case when the trajectory is followed at a control rate.
+public struct Trajectory {
+    /// Kinematic limits used for time allocation.
+    public struct Limits {
+        /// Largest speed, m/s.
+        public var velocity: Double = 0.5
+        /// Largest acceleration, m/s^2.
+        public var acceleration: Double = 0.5
+        /// Largest yaw rate, rad/s.
+        public var yawRate: Double = deg2rad(60.0)
+        /// Largest yaw acceleration, rad/s^2.
+        public var yawAcceleration: Double = deg2rad(90.0)
+        /// Shortest segment duration, s.
+        public var minSegmentDuration: Double = 0.5
+
+        public init() {}
+    }
+
+    /// Polynomial order of the segments.
+    public static let order = 7
+    private static let coefficientCount = order + 1
+    // Samples per segment used to find velocity and acceleration peaks
+    private static let peakSamples = 32
+
+    /// Waypoints the trajectory passes through, with yaw unwrapped.
+    public let waypoints: [simd_double4]
+    /// Segment durations, in seconds.
+    public let durations: [CFTimeInterval]
+    /// Total duration, in seconds.
+    public let duration: CFTimeInterval
+
+    // `coefficientCount` per segment, ascending powers of normalized time
+    private let coefficients: [simd_double4]
+    private let startTimes: [CFTimeInterval]
+    // Segment of the latest sample
+    private var cursor: Int = 0
+
+    /// Creates a trajectory through the waypoints, respecting the limits.
+    ///
+    /// `nil` components of a waypoint keep the value of the previous waypoint,
+    /// so the first waypoint, normally the current pose, must be complete.
+    /// Consecutive duplicate waypoints are skipped.
+    ///
+    /// Segment durations are first allocated from trapezoidal velocity profiles, and then scaled
+    /// uniformly until the sampled velocity and acceleration peaks are within the limits.
+    ///
+    /// - Returns: `nil` if there are less than two distinct waypoints or the first one is incomplete.
+    public init?(waypoints: [QuadrotorPose], limits: Limits = Limits()) {
+        guard let first = waypoints.first,
+              let x = first.x, let y = first.y, let z = first.z, let yaw = first.yaw else {
+            print("error: The first waypoint must have all of x, y, z and yaw set")
+            return nil
+        }
+
+        var points = [simd_double4(x, y, z, yaw)]
+        for wp in waypoints.dropFirst() {
+            let last = points[points.count - 1]
+            // Shortest rotation from the previous heading
+            let yaw = wp.yaw.map { last.w + remainder($0 - last.w, 2.0 * .pi) } ?? last.w
+            let point = simd_double4(wp.x ?? last.x, wp.y ?? last.y, wp.z ?? last.z, yaw)
+
+            if point != last {
+                points.append(point)
+            }
+        }
+
+        guard points.count >= 2 else {
+            print("error: Trajectory needs at least two distinct waypoints")
+            return nil
+        }
+
+        let segments = points.count - 1
+        var durations = (0..<segments).map { i -> Double in
+            let delta = points[i + 1] - points[i]
+            let move = Trajectory.trapezoidTime(distance: simd_length(simd_double3(delta.x, delta.y, delta.z)),
+                                                velocity: limits.velocity, acceleration: limits.acceleration)
+            let turn = Trajectory.trapezoidTime(distance: abs(delta.w),
+                                                velocity: limits.yawRate, acceleration: limits.yawAcceleration)
+            return Swift.max(move, turn, limits.minSegmentDuration)
+        }
+
+        guard let coefficients = Trajectory.solve(points: points, durations: durations) else {
+            print("error: Unable to solve the trajectory")
+            return nil
+        }
+
+        // Uniform time scaling does not change the normalized polynomials,
+        // it divides the velocity by the scale and the acceleration by its square
+        let scale = Trajectory.peakRatio(coefficients: coefficients, durations: durations, limits: limits)
+        if scale > 1.0 {
+            durations = durations.map { $0 * scale }
+        }
+
+        var startTimes = [CFTimeInterval]()
+        startTimes.reserveCapacity(segments)
+        var t = 0.0
+        for d in durations {
+            startTimes.append(t)
+            t += d
+        }
+
+        self.waypoints = points
+        self.durations = durations
+        self.duration = t
+        self.coefficients = coefficients
+        self.startTimes = startTimes
+    }
+
+    /// Returns the reference at `time` seconds since the start of the trajectory.
+    ///
+    /// Times before the start and after the end are clamped, the trajectory is at rest there.
+    public mutating func sample(at time: CFTimeInterval) -> TrajectorySample {
+        let t = time.clamped(to: 0.0...duration)
+
+        // Normally moves forward by at most one segment per tick
+        while cursor + 1 < startTimes.count && t >= startTimes[cursor + 1] {
+            cursor += 1
+        }
+        while cursor > 0 && t < startTimes[cursor] {
+            cursor -= 1
+        }
+
+        let T = durations[cursor]
+        let tau = ((t - startTimes[cursor]) / T).clamped(to: 0.0...1.0)
+        let (p, v, a) = Trajectory.evaluate(coefficients, segment: cursor, at: tau)
+
+        // The yaw is continuous along the trajectory, the controller wraps its error
+        return TrajectorySample(time: time,
+                                position: p,
+                                velocity: v / T,
+                                acceleration: a / (T * T),
+                                isFinished: time >= duration)
+    }
+
+    /// Position, first and second derivatives w.r.t. normalized time, by Horner's scheme.
+    private static func evaluate(_ coefficients: [simd_double4], segment: Int, at tau: Double) -> (simd_double4, simd_double4, simd_double4) {
+        let base = segment * coefficientCount
+        var p = coefficients[base + order]
+        var v = simd_double4.zero
+        var a = simd_double4.zero
+
+        for j in stride(from: order - 1, through: 0, by: -1) {
+            a = a * tau + v
+            v = v * tau + p
+            p = p * tau + coefficients[base + j]
+        }
+
+        return (p, v, 2.0 * a)
+    }
+
+    /// Time to cover `distance` from rest to rest with a trapezoidal velocity profile.
+    private static func trapezoidTime(distance: Double, velocity: Double, acceleration: Double) -> Double {
+        guard distance > 0.0 else { return 0.0 }
+
+        if distance <= velocity * velocity / acceleration {
+            // Never reaches the top speed
+            return 2.0 * (distance / acceleration).squareRoot()
+        }
+        return distance / velocity + velocity / acceleration
+    }
+
+    /// Scale of the durations needed to bring the velocity and acceleration peaks within the limits.
+    private static func peakRatio(coefficients: [simd_double4], durations: [Double], limits: Limits) -> Double {
+        var ratio = 0.0
+
+        for (segment, T) in durations.enumerated() {
+            for k in 0...peakSamples {
+                let (_, v, a) = evaluate(coefficients, segment: segment, at: Double(k) / Double(peakSamples))
+                let vel = v / T
+                let acc = a / (T * T)
+
+                ratio = Swift.max(ratio,
+                                  simd_length(simd_double3(vel.x, vel.y, vel.z)) / limits.velocity,
+                                  abs(vel.w) / limits.yawRate,
+                                  (simd_length(simd_double3(acc.x, acc.y, acc.z)) / limits.acceleration).squareRoot(),
+                                  (abs(acc.w) / limits.yawAcceleration).squareRoot())
+            }
+        }
+
+        return ratio
+    }
+
+    /// Solves the coefficients of all segments at once.
+    ///
+    /// Unknowns are the coefficients in normalized time, all four axes share the matrix.
+    /// Per segment there are eight equations: rest at both ends of the trajectory (4 + 4),
+    /// and at every inner waypoint two position constraints and continuity of the derivatives 1 to 6.
+    private static func solve(points: [simd_double4], durations: [Double]) -> [simd_double4]? {
+        let n = coefficientCount
+        let segments = durations.count
+        let size = n * segments
+
+        var a = [Double](repeating: 0.0, count: size * size)
+        var b = [simd_double4](repeating: .zero, count: size)
+        var row = 0
+
+        // Start at rest
+        for k in 0..<4 {
+            a[row * size + k] = factorial(k)
+            b[row] = k == 0 ? points[0] : .zero
+            row += 1
+        }
+
+        for i in 1..<segments {
+            let prev = (i - 1) * n
+            let next = i * n
+            let s = durations[i - 1] / durations[i]
+
+            // End of the previous segment and start of the next one at the waypoint
+            for j in 0..<n {
+                a[row * size + prev + j] = 1.0
+            }
+            b[row] = points[i]
+            row += 1
+
+            a[row * size + next] = 1.0
+            b[row] = points[i]
+            row += 1
+
+            // Continuity of the derivatives w.r.t. real time
+            for k in 1..<(n - 1) {
+                for j in k..<n {
+                    a[row * size + prev + j] = falling(j, k)
+                }
+                a[row * size + next + k] = -pow(s, Double(k)) * factorial(k)
+                row += 1
+            }
+        }
+
+        // Finish at rest
+        let last = (segments - 1) * n
+        for k in 0..<4 {
+            for j in k..<n {
+                a[row * size + last + j] = falling(j, k)
+            }
+            b[row] = k == 0 ? points[segments] : .zero
+            row += 1
+        }
+
+        return gaussianElimination(&a, &b, size: size) ? b : nil
+    }
+}
+
+private func factorial(_ k: Int) -> Double {
+    return falling(k, k)
+}
+
+/// `k`-th derivative of `tau^j` at `tau = 1`, i.e. `j! / (j - k)!`.
+private func falling(_ j: Int, _ k: Int) -> Double {
+    guard j >= k else { return 0.0 }
+
+    var res = 1.0
+    for m in stride(from: j, to: j - k, by: -1) {
+        res *= Double(m)
+    }
+    return res
+}
+
+/// Solves `a * x = b` in place with partial pivoting, `a` is row-major. The solution replaces `b`.
+///
+/// - Returns: `false` if the matrix is singular.
+private func gaussianElimination(_ a: inout [Double], _ b: inout [simd_double4], size n: Int) -> Bool {
+    for col in 0..<n {
+        var pivot = col
+        for r in (col + 1)..<n where abs(a[r * n + col]) > abs(a[pivot * n + col]) {
+            pivot = r
+        }
+        guard abs(a[pivot * n + col]) > 1e-12 else { return false }
+
+        if pivot != col {
+            for c in col..<n {
+                a.swapAt(col * n + c, pivot * n + c)
+            }
+            b.swapAt(col, pivot)
+        }
+
+        let inv = 1.0 / a[col * n + col]
+        for r in (col + 1)..<n {
+            let f = a[r * n + col] * inv
+            guard f != 0.0 else { continue }
+
+            for c in col..<n {
+                a[r * n + c] -= f * a[col * n + c]
+            }
+            b[r] -= f * b[col]
+        }
+    }
+
+    for col in stride(from: n - 1, through: 0, by: -1) {
+        var x = b[col]
+        for c in (col + 1)..<n {
+            x -= a[col * n + c] * b[c]
+        }
+        b[col] = x / a[col * n + col]
+    }
+
+    return true
+}
@@ -84,6 +84,17 @@
     return data;
 }
 
++ (SticksData)sticksDataFrom: (nonnull NSData *) data {
+    SticksData sticksData = {0};
+
+    // Sticks packets carry the time after the axes
+    if (data.length >= sizeof(SticksData)) {
+        [data getBytes:&sticksData length:sizeof(SticksData)];
+    }
+
+    return sticksData;
+}
+
 @end
 
 @implementation LogRecordCreator : NSObject
@@ -0,0 +1,117 @@
+//
+//  Atomics.h
+//  TelloSwift
+//
+// Thin wrappers around C11 atomic builtins, so Swift code can use
+// lock-free counters and seqlocks without extra dependencies. The functions are
+// defined inline, which lets the compiler inline them into Swift callers.
+
+#import <Foundation/Foundation.h>
+
+static inline int64_t tello_atomic_load_relaxed(const int64_t * _Nonnull ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static inline int64_t tello_atomic_load_acquire(const int64_t * _Nonnull ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void tello_atomic_store_relaxed(int64_t * _Nonnull ptr, int64_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+}
+
+static inline void tello_atomic_store_release(int64_t * _Nonnull ptr, int64_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static inline int64_t tello_atomic_fetch_add(int64_t * _Nonnull ptr, int64_t value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+/// Returns true and stores `desired` if `*ptr == *expected`, otherwise loads `*ptr` into `*expected`.
+static inline bool tello_atomic_compare_exchange(int64_t * _Nonnull ptr, int64_t * _Nonnull expected, int64_t desired) {
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline void tello_atomic_thread_fence_acquire(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static inline void tello_atomic_thread_fence_release(void) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// MARK: Seqlock
+//
+// A sequence counter guards a block of 64-bit words. Writers make the counter odd,
+// store the words and make it even again. Readers never block writers: they copy the
+// words and retry if the counter was odd or has changed meanwhile. All accesses to
+// the guarded words are atomic, so there are no data races even when a read is retried.
+
+/// Waits for other writers and makes the sequence odd. Returns the (even) sequence before the write.
+static inline int64_t tello_seqlock_write_begin(int64_t * _Nonnull seq) {
+    int64_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    for (;;) {
+        if ((s & 1) == 0 && __atomic_compare_exchange_n(seq, &s, s + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    }
+    // Data stores must not become visible before the odd sequence
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return s;
+}
+
+/// Publishes the write started with `tello_seqlock_write_begin`.
+static inline void tello_seqlock_write_end(int64_t * _Nonnull seq, int64_t s) {
+    __atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
+
+/// Waits until no write is in progress. Returns the sequence to pass to `tello_seqlock_read_retry`.
+static inline int64_t tello_seqlock_read_begin(const int64_t * _Nonnull seq) {
+    int64_t s;
+    while ((s = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1) {}
+    return s;
+}
+
+/// Returns true if the words read since `tello_seqlock_read_begin` may be torn.
+static inline bool tello_seqlock_read_retry(const int64_t * _Nonnull seq, int64_t s) {
+    // Data loads must complete before the sequence is checked again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != s;
+}
+
+/// Copies `size` bytes from `src` to the guarded words with relaxed atomic stores.
+static inline void tello_seqlock_store_bytes(int64_t * _Nonnull words, const void * _Nonnull src, size_t size) {
+    for (size_t offset = 0; offset < size; offset += sizeof(int64_t)) {
+        int64_t w = 0;
+        size_t n = size - offset < sizeof(int64_t) ? size - offset : sizeof(int64_t);
+        memcpy(&w, (const uint8_t *)src + offset, n);
+        __atomic_store_n(&words[offset / sizeof(int64_t)], w, __ATOMIC_RELAXED);
+    }
+}
+
+/// Copies `size` bytes from the guarded words to `dst` with relaxed atomic loads.
+static inline void tello_seqlock_load_bytes(const int64_t * _Nonnull words, void * _Nonnull dst, size_t size) {
+    for (size_t offset = 0; offset < size; offset += sizeof(int64_t)) {
+        int64_t w = __atomic_load_n(&words[offset / sizeof(int64_t)], __ATOMIC_RELAXED);
+        size_t n = size - offset < sizeof(int64_t) ? size - offset : sizeof(int64_t);
+        memcpy((uint8_t *)dst + offset, &w, n);
+    }
+}
+
+/// Writes `size` bytes from `src` under the seqlock.
+static inline void tello_seqlock_write(int64_t * _Nonnull seq, int64_t * _Nonnull words, const void * _Nonnull src, size_t size) {
+    int64_t s = tello_seqlock_write_begin(seq);
+    tello_seqlock_store_bytes(words, src, size);
+    tello_seqlock_write_end(seq, s);
+}
+
+/// Reads a consistent copy of `size` bytes into `dst`, retrying while a write is in progress.
+static inline void tello_seqlock_read(const int64_t * _Nonnull seq, const int64_t * _Nonnull words, void * _Nonnull dst, size_t size) {
+    int64_t s;
+    do {
+        s = tello_seqlock_read_begin(seq);
+        tello_seqlock_load_bytes(words, dst, size);
+    } while (tello_seqlock_read_retry(seq, s));
+}
@@ -124,6 +124,7 @@ typedef struct __attribute__((packed)) {
 @interface TelloSticksDataCreator : NSObject
 
 + (nonnull NSData *)dataFrom:(SticksData) sticks;
++ (SticksData)sticksDataFrom:(nonnull NSData *) data;
 
 @end
 
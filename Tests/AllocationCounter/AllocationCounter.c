@@ -0,0 +1,131 @@
+//
+//  AllocationCounter.c
+//  TelloSwift
+//
+//
+
+#include "AllocationCounter.h"
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#include <pthread.h>
+
+#define MAX_ZONES 16
+
+typedef struct {
+    malloc_zone_t *zone;
+    void *(*malloc)(malloc_zone_t *zone, size_t size);
+    void *(*calloc)(malloc_zone_t *zone, size_t count, size_t size);
+    void *(*realloc)(malloc_zone_t *zone, void *ptr, size_t size);
+    void *(*memalign)(malloc_zone_t *zone, size_t alignment, size_t size);
+} original_zone_t;
+
+static original_zone_t originals[MAX_ZONES];
+static unsigned zone_count = 0;
+
+// Thread being counted, compared with pthread_self(), which never allocates
+static pthread_t counted_thread = NULL;
+static int64_t count = 0;
+
+static pthread_once_t install_once = PTHREAD_ONCE_INIT;
+static bool installed = false;
+
+static inline void count_allocation(void) {
+    if (pthread_equal(pthread_self(), __atomic_load_n(&counted_thread, __ATOMIC_RELAXED))) {
+        __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static inline original_zone_t *original(malloc_zone_t *zone) {
+    for (unsigned i = 0; i < zone_count; i++) {
+        if (originals[i].zone == zone) {
+            return &originals[i];
+        }
+    }
+    return &originals[0];
+}
+
+static void *counting_malloc(malloc_zone_t *zone, size_t size) {
+    count_allocation();
+    return original(zone)->malloc(zone, size);
+}
+
+static void *counting_calloc(malloc_zone_t *zone, size_t n, size_t size) {
+    count_allocation();
+    return original(zone)->calloc(zone, n, size);
+}
+
+static void *counting_realloc(malloc_zone_t *zone, void *ptr, size_t size) {
+    count_allocation();
+    return original(zone)->realloc(zone, ptr, size);
+}
+
+static void *counting_memalign(malloc_zone_t *zone, size_t alignment, size_t size) {
+    count_allocation();
+    return original(zone)->memalign(zone, alignment, size);
+}
+
+static void install(void) {
+    vm_address_t *zones = NULL;
+    unsigned n = 0;
+    if (malloc_get_all_zones(mach_task_self(), NULL, &zones, &n) != KERN_SUCCESS) {
+        return;
+    }
+
+    for (unsigned i = 0; i < n && zone_count < MAX_ZONES; i++) {
+        malloc_zone_t *zone = (malloc_zone_t *)zones[i];
+
+        // Zone function tables are read-only
+        if (vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS) {
+            continue;
+        }
+
+        original_zone_t *o = &originals[zone_count];
+        o->zone = zone;
+        o->malloc = zone->malloc;
+        o->calloc = zone->calloc;
+        o->realloc = zone->realloc;
+        zone->malloc = counting_malloc;
+        zone->calloc = counting_calloc;
+        zone->realloc = counting_realloc;
+        if (zone->version >= 5 && zone->memalign != NULL) {
+            o->memalign = zone->memalign;
+            zone->memalign = counting_memalign;
+        }
+        zone_count++;
+
+        vm_protect(mach_task_self(), (vm_address_t)zone, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+    }
+
+    installed = zone_count > 0;
+}
+
+bool allocation_counter_install(void) {
+    pthread_once(&install_once, install);
+    return installed;
+}
+
+void allocation_counter_begin(void) {
+    __atomic_store_n(&count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&counted_thread, pthread_self(), __ATOMIC_RELAXED);
+}
+
+int64_t allocation_counter_end(void) {
+    __atomic_store_n(&counted_thread, NULL, __ATOMIC_RELAXED);
+    return __atomic_load_n(&count, __ATOMIC_RELAXED);
+}
+
+#else
+
+bool allocation_counter_install(void) {
+    return false;
+}
+
+void allocation_counter_begin(void) {}
+
+int64_t allocation_counter_end(void) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,19 @@
+//
+//  AllocationCounter.h
+//  TelloSwift
+//
+// Counts heap allocations of a single thread, so tests can check that hot paths
+// do not allocate. The malloc zones of the process are hooked once; allocations
+// of other threads (e.g. the test runner) are not counted.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Hooks the malloc zones of the process. Returns false if allocations can not be counted on this platform.
+bool allocation_counter_install(void);
+
+/// Starts counting the allocations of the calling thread.
+void allocation_counter_begin(void);
+
+/// Stops counting and returns the number of allocations since `allocation_counter_begin()`.
+int64_t allocation_counter_end(void);
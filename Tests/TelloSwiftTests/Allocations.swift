@@ -0,0 +1,47 @@
+//
+//  Allocations.swift
+//  TelloSwift
+//
+//
+
+import Foundation
+import QuartzCore
+import AllocationCounter
+
+/// Counts heap allocations of the current thread, see `AllocationCounter.h`.
+enum Allocations {
+    /// Whether allocations can be counted on this platform.
+    static let isAvailable: Bool = {
+        guard allocation_counter_install() else { return false }
+
+        // A class instance always goes to the heap
+        let calibration = count {
+            keep(NSObject())
+        }
+        return calibration > 0
+    }()
+
+    /// Number of heap allocations the current thread makes in `body`.
+    static func count(_ body: () throws -> Void) rethrows -> Int {
+        allocation_counter_begin()
+        defer { _ = allocation_counter_end() }
+
+        try body()
+        return Int(allocation_counter_end())
+    }
+
+    private static var kept: AnyObject?
+
+    /// Keeps the optimizer from removing the allocation.
+    @inline(never)
+    static func keep(_ object: AnyObject) {
+        kept = object
+    }
+}
+
+/// Wall-clock time of `body`, in seconds.
+func measureTime(_ body: () throws -> Void) rethrows -> Double {
+    let start = CACurrentMediaTime()
+    try body()
+    return CACurrentMediaTime() - start
+}
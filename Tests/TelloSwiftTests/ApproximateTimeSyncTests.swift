@@ -0,0 +1,84 @@
+//
+//  ApproximateTimeSyncTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import Combine
+@testable import TelloSwift
+
+final class ApproximateTimeSyncTests: XCTestCase {
+    private let a = PassthroughSubject<Double, Never>()
+    private let b = PassthroughSubject<Double, Never>()
+    private var matched: [[Double]] = []
+    private var sub: AnyCancellable?
+
+    /// Synchronizes `a` and `b`, the elements are their own time stamps.
+    private func sync(slop: TimeInterval = 0.02, queueSize: Int = 10) -> Publishers.ApproximateTimeSyncStatistics {
+        let publisher = a.approximateTimeSync(with: b, slop: slop, queueSize: queueSize, time: { $0 }, { $0 })
+        sub = publisher.sink { [unowned self] in self.matched.append([$0.0, $0.1]) }
+        return publisher.statistics
+    }
+
+    override func tearDown() {
+        sub?.cancel()
+        matched = []
+        super.tearDown()
+    }
+
+    func testMatchesClosestInsideSlop() {
+        let statistics = sync()
+
+        a.send(1.0)
+        b.send(0.97)
+        b.send(0.99)
+        // The later candidate is farther from the pivot than the one before it
+        b.send(1.03)
+
+        XCTAssertEqual(matched, [[1.0, 0.99]])
+        XCTAssertEqual(statistics.matched, 1)
+        XCTAssertEqual(statistics.dropped, [0, 1])
+    }
+
+    func testRejectsOutsideSlop() {
+        let statistics = sync()
+
+        a.send(1.0)
+        b.send(1.2)
+        XCTAssertEqual(matched, [])
+        XCTAssertEqual(statistics.dropped, [1, 0])
+
+        a.send(1.21)
+        b.send(1.4)
+
+        XCTAssertEqual(matched, [[1.21, 1.2]])
+        XCTAssertEqual(statistics.dropped, [1, 0])
+    }
+
+    func testWaitsForLaterCandidate() {
+        let statistics = sync()
+
+        a.send(1.0)
+        b.send(0.99)
+        // Inside the slop, but the next element of `b` might be closer
+        XCTAssertEqual(matched, [])
+
+        b.send(1.001)
+
+        XCTAssertEqual(matched, [[1.0, 1.001]])
+        XCTAssertEqual(statistics.dropped, [0, 1])
+    }
+
+    func testQueueOverflowDropsOldest() {
+        let statistics = sync(queueSize: 3)
+
+        [1.0, 1.1, 1.2, 1.3].forEach { a.send($0) }
+        XCTAssertEqual(statistics.dropped, [1, 0])
+
+        b.send(1.1)
+
+        XCTAssertEqual(matched, [[1.1, 1.1]])
+        XCTAssertEqual(statistics.dropped, [1, 0])
+    }
+}
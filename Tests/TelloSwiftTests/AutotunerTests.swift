@@ -0,0 +1,91 @@
+//
+//  AutotunerTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import Combine
+import simd
+@testable import TelloSwift
+
+final class AutotunerTests: XCTestCase {
+    private let hold = simd_double3(0.0, 0.0, 1.0)
+
+    /// Takes off and settles at `hold`. The simulator steps the control loop on this thread, the main one.
+    private func hover(_ simulator: QuadrotorSimulator) -> Tello {
+        let tello = Tello(transport: simulator)
+
+        tello.connect()
+        _ = tello.takeoff()
+        XCTAssertTrue(simulator.run(until: { tello.flightState.value == .hovering }, timeout: 10.0))
+
+        tello.goTo(x: hold.x, y: hold.y, z: hold.z, yaw: 0.0)
+        XCTAssertTrue(simulator.run(until: { tello.controller.state.value == .running(.converged) }, timeout: 20.0))
+        return tello
+    }
+
+    private func tune(_ tello: Tello, _ axis: Autotuner.Axis) -> (result: () -> Result<Autotuner.Tuning, Autotuner.Failure>?, subscription: AnyCancellable) {
+        var result: Result<Autotuner.Tuning, Autotuner.Failure>?
+        let subscription = tello.autotune(axis).sink(receiveCompletion: { completion in
+            if case .failure(let failure) = completion {
+                result = .failure(failure)
+            }
+        }, receiveValue: { tuning in
+            result = .success(tuning)
+        })
+
+        return ({ result }, subscription)
+    }
+
+    /// The relay ends within the controller update, the result must not wait for the main queue.
+    func testTunesXInClosedLoop() throws {
+        let simulator = QuadrotorSimulator()
+        let tello = hover(simulator)
+        defer { tello.disconnect() }
+
+        let (result, subscription) = tune(tello, .x)
+        defer { subscription.cancel() }
+
+        XCTAssertTrue(tello.autotuner.isTuning)
+        XCTAssertTrue(simulator.run(until: { result() != nil }, timeout: 60.0))
+        XCTAssertFalse(tello.autotuner.isTuning)
+
+        let tuning = try result()?.get()
+        XCTAssertEqual(tuning?.axis, .x)
+        let gain = try XCTUnwrap(tuning?.ultimateGain)
+        let period = try XCTUnwrap(tuning?.ultimatePeriod)
+        let pid = try XCTUnwrap(tuning?.pid)
+        XCTAssertTrue(gain.isFinite && gain > 0.0, "ultimate gain \(gain)")
+        XCTAssertTrue(period.isFinite && period > 0.0, "ultimate period \(period)")
+        XCTAssertTrue(pid.p.isFinite && pid.p > 0.0 && pid.d.isFinite, "\(pid.dictionary())")
+        XCTAssertEqual(pid.i, 0.0)
+
+        // Back to the pose held at the start, on the next updates
+        simulator.run(for: 1.0)
+        XCTAssertTrue(simulator.run(until: { tello.controller.state.value == .running(.converged) }, timeout: 20.0))
+        XCTAssertLessThan(simd_length(simulator.state.position - hold), 0.15)
+    }
+
+    /// The drone lands by itself, e.g. on low battery.
+    func testLandingAbortsTheTuning() {
+        let simulator = QuadrotorSimulator()
+        let tello = hover(simulator)
+        defer { tello.disconnect() }
+
+        let (result, subscription) = tune(tello, .x)
+        defer { subscription.cancel() }
+
+        simulator.run(for: 2.0)
+        XCTAssertNil(result())
+
+        simulator.land()
+        XCTAssertTrue(simulator.run(until: { result() != nil }, timeout: 5.0))
+
+        guard case .failure(.flightStateChanged)? = result() else {
+            return XCTFail("\(String(describing: result()))")
+        }
+        XCTAssertFalse(tello.autotuner.isTuning)
+        XCTAssertNil(tello.controller.controlOverride)
+    }
+}
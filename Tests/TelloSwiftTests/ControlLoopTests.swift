@@ -0,0 +1,114 @@
+//
+//  ControlLoopTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class ControlLoopTests: XCTestCase {
+    private let latency = 0.03
+
+    private func makeController() -> PositionController {
+        let controller = PositionController(x: Pid(p: 0.5, i: 0.0, d: 0.0)!,
+                                            y: Pid(p: 0.5, i: 0.0, d: 0.0)!,
+                                            z: Pid(p: 0.8, i: 0.0, d: 0.0)!,
+                                            yaw: Pid(p: 1.0, i: 0.0, d: 0.0)!)
+        controller.setTarget(target: QuadrotorPose(x: 1.0, y: 0.0, z: 1.0, yaw: 0.0))
+        return controller
+    }
+
+    /// Pose measured `latency` seconds before the tick.
+    private func state(at time: CFTimeInterval) -> EstimatedState {
+        return EstimatedState(velocity: .zero, velocityCov: simd_double3x3(diagonal: simd_double3(repeating: 0.01)),
+                              position: simd_double3(0.0, 0.0, 1.0), positionCov: simd_double3x3(diagonal: simd_double3(repeating: 0.01)),
+                              positionVelocityCov: simd_double3x3(),
+                              orientation: simd_quatd(angle: 0.0, axis: simd_double3(0.0, 0.0, 1.0)), yaw: 0.0, yawVariance: 0.01,
+                              timestamp: time - latency, isValid: .allValid)
+    }
+
+    func testStepUpdatesOncePerTick() throws {
+        let clock = ManualClock()
+        var poses: [CFTimeInterval] = []
+        var outputs: [(controls: QuadrotorControls?, time: CFTimeInterval)] = []
+
+        let loop = ControlLoop(rate: 50.0, clock: clock.time, controller: makeController(), pose: { now in
+            poses.append(now)
+            return self.state(at: now)
+        }, output: { controls, time in
+            outputs.append((controls, time))
+        })
+
+        XCTAssertNil(loop.timing)
+
+        let ticks = 50
+        for tick in 0..<ticks {
+            clock.now = 10.0 + Double(tick) * 0.02
+            loop.step()
+        }
+
+        let times = (0..<ticks).map { 10.0 + Double($0) * 0.02 }
+        XCTAssertEqual(poses, times)
+        XCTAssertEqual(outputs.map { $0.time }, times)
+        XCTAssertTrue(outputs.allSatisfy { $0.controls != nil })
+        // Toward the target
+        XCTAssertGreaterThan(outputs[0].controls?.pitch ?? 0.0, 0.0)
+
+        let timing = try XCTUnwrap(loop.timing)
+        XCTAssertEqual(timing.window, ticks - 1)
+        XCTAssertEqual(timing.period, 0.02, accuracy: 1e-9)
+        XCTAssertEqual(timing.jitter, 0.0, accuracy: 1e-9)
+        XCTAssertEqual(timing.maxPeriodDeviation, 0.0, accuracy: 1e-9)
+        XCTAssertEqual(timing.latency, latency, accuracy: 1e-9)
+        XCTAssertEqual(timing.maxLatency, latency, accuracy: 1e-9)
+
+        loop.resetTiming()
+        XCTAssertNil(loop.timing)
+    }
+
+    func testNoPoseOutputsNoControls() {
+        var outputs: [QuadrotorControls?] = []
+        let loop = ControlLoop(rate: 50.0, clock: ManualClock().time, controller: makeController(),
+                               pose: { _ in nil }, output: { controls, _ in outputs.append(controls) })
+
+        loop.step()
+
+        XCTAssertEqual(outputs.count, 1)
+        XCTAssertNil(outputs[0])
+    }
+
+    func testStopHaltsOutput() {
+        let lock = NSLock()
+        var outputs = 0
+        let ticked = expectation(description: "ticks")
+        ticked.assertForOverFulfill = false
+
+        let loop = ControlLoop(rate: 50.0, controller: makeController(), pose: { self.state(at: $0) }, output: { _, _ in
+            lock.lock()
+            outputs += 1
+            let count = outputs
+            lock.unlock()
+
+            if count >= 3 {
+                ticked.fulfill()
+            }
+        })
+
+        loop.start()
+        wait(for: [ticked], timeout: 2.0)
+        loop.stop()
+
+        // A tick may still be running when the timer is canceled
+        Thread.sleep(forTimeInterval: 0.05)
+        lock.lock()
+        let stopped = outputs
+        lock.unlock()
+
+        Thread.sleep(forTimeInterval: 0.2)
+        lock.lock()
+        XCTAssertEqual(outputs, stopped)
+        lock.unlock()
+    }
+}
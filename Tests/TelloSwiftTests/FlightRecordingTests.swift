@@ -0,0 +1,46 @@
+//
+//  FlightRecordingTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class FlightRecordingTests: XCTestCase {
+    func testJsonRoundTrip() throws {
+        var recording = FlightRecording()
+        recording.sticks = [.init(time: 1.0, value: QuadrotorControls(roll: 0.1, pitch: nil, yaw: -0.2, thrust: 0.0))]
+        recording.imu = [.init(time: 1.1, value: Imu(accel: simd_double3(0.0, 0.1, -1.0), gyro: simd_double3(0.01, 0.0, 0.2),
+                                                      orientation: simd_quatd(angle: 0.3, axis: simd_double3(0.0, 0.0, 1.0)),
+                                                      temperature: 45.5))]
+        recording.mvo = [.init(time: 1.2, value: Mvo(velocity: simd_double3(0.5, 0.0, 0.0),
+                                                      velocityCov: simd_double3x3(rows: [simd_double3(1.0, 0.1, 0.0),
+                                                                                         simd_double3(0.1, 2.0, 0.0),
+                                                                                         simd_double3(0.0, 0.0, 3.0)]),
+                                                      position: simd_double3(1.0, 2.0, 0.5),
+                                                      positionCov: simd_double3x3(diagonal: simd_double3(0.01, 0.02, 0.03)),
+                                                      height: 0.5, heightVariance: 0.001,
+                                                      isValid: IsValidVelPos(vel: .allValid, pos: IsValid(x: true, y: true, z: false))))]
+        recording.vo = [.init(time: 1.3, value: Vo(velocity: .zero, position: simd_double3(1.0, 2.0, 0.4), isValid: .allValid))]
+
+        let data = try JSONEncoder().encode(recording)
+        let decoded = try JSONDecoder().decode(FlightRecording.self, from: data)
+
+        XCTAssertEqual(decoded.sticks.map { $0.time }, [1.0])
+        XCTAssertEqual(decoded.sticks.first?.value, recording.sticks.first?.value)
+
+        let imu = try XCTUnwrap(decoded.imu.first?.value)
+        XCTAssertEqual(imu.accel, recording.imu[0].value.accel)
+        XCTAssertEqual(imu.orientation.vector, recording.imu[0].value.orientation.vector)
+        XCTAssertEqual(imu.temperature, 45.5)
+
+        let mvo = try XCTUnwrap(decoded.mvo.first?.value)
+        XCTAssertEqual(mvo.velocityCov, recording.mvo[0].value.velocityCov)
+        XCTAssertEqual(mvo.positionCov, recording.mvo[0].value.positionCov)
+        XCTAssertEqual(mvo.isValid, recording.mvo[0].value.isValid)
+
+        XCTAssertEqual(decoded.vo.first?.value.position, recording.vo[0].value.position)
+    }
+}
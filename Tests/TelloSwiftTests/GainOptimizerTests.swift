@@ -0,0 +1,73 @@
+//
+//  GainOptimizerTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+@testable import TelloSwift
+
+final class GainOptimizerTests: XCTestCase {
+    private func candidate(_ settleTime: Double, _ overshoot: Double, failureRate: Double = 0.0, p: Double = 1.0) -> GainOptimizer.Candidate {
+        return GainOptimizer.Candidate(p: p, i: 0.0, d: 0.0, settleTime: settleTime, overshoot: overshoot, failureRate: failureRate)
+    }
+
+    func testParetoFront() {
+        let candidates = [candidate(1.0, 0.5, p: 1.0),
+                          // Ties the settle time of the previous one, with less overshoot
+                          candidate(1.0, 0.3, p: 2.0),
+                          // Ties the overshoot of the previous one, slower
+                          candidate(2.0, 0.3, p: 3.0),
+                          candidate(2.0, 0.1, p: 4.0),
+                          // Same score as the previous one
+                          candidate(2.0, 0.1, p: 5.0),
+                          candidate(0.5, 0.05, failureRate: 0.5, p: 6.0),
+                          // All runs failed
+                          candidate(.infinity, .infinity, failureRate: 1.0, p: 7.0),
+                          candidate(0.8, .infinity, p: 8.0),
+                          candidate(3.0, 0.0, p: 9.0)]
+
+        let front = GainOptimizer.paretoFront(candidates.shuffled(), maxFailureRate: 0.25)
+        XCTAssertEqual(front.map { $0.settleTime }, [1.0, 2.0, 3.0])
+        XCTAssertEqual(front.map { $0.overshoot }, [0.3, 0.1, 0.0])
+        XCTAssertEqual(front[0].p, 2.0)
+
+        // The partly failed candidate is feasible now, and dominates all but the one without overshoot
+        let tolerant = GainOptimizer.paretoFront(candidates, maxFailureRate: 1.0)
+        XCTAssertEqual(tolerant.map { $0.p }, [6.0, 9.0])
+
+        XCTAssertTrue(GainOptimizer.paretoFront([], maxFailureRate: 0.0).isEmpty)
+        XCTAssertTrue(GainOptimizer.paretoFront([candidate(.infinity, .infinity, failureRate: 1.0)], maxFailureRate: 1.0).isEmpty)
+    }
+
+    /// A second search over the same space only reads the cache.
+    func testSecondOptimizeSimulatesNothing() {
+        var configuration = GainOptimizer.Configuration()
+        configuration.x = GainOptimizer.SearchSpace(p: 0.5...1.0, d: 0.0...0.0)
+        configuration.gridPoints = 2
+        configuration.refinements = 1
+        configuration.runs = 2
+        let optimizer = GainOptimizer(configuration: configuration)
+
+        var results: [[GainOptimizer.AxisResult]] = []
+        var simulated: [Int] = []
+        let done = expectation(description: "optimized")
+        DispatchQueue.global(qos: .userInitiated).async {
+            for _ in 0..<2 {
+                results.append(optimizer.optimize([.x]))
+                simulated.append(optimizer.simulatedRuns)
+            }
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 600.0)
+
+        // Both grid points, and any refined ones, each with all runs
+        XCTAssertGreaterThanOrEqual(simulated[0], 2 * configuration.runs)
+        XCTAssertEqual(simulated[0] % configuration.runs, 0)
+        XCTAssertEqual(simulated[1], simulated[0])
+
+        let candidates = results.map { $0[0].candidates.map { [$0.p, $0.i, $0.d, $0.settleTime, $0.overshoot, $0.failureRate] } }
+        XCTAssertEqual(candidates[0], candidates[1])
+        XCTAssertEqual(candidates[0].count, simulated[0] / configuration.runs)
+    }
+}
@@ -0,0 +1,107 @@
+//
+//  MonteCarloHarnessTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+@testable import TelloSwift
+
+final class MonteCarloHarnessTests: XCTestCase {
+    private let mission: [MonteCarloHarness.Step] = [.takeoff,
+                                                     .goTo(QuadrotorPose(x: 1.0, y: 0.5, z: 1.0, yaw: 0.5)),
+                                                     .land]
+
+    private func makeHarness(runs: Int, seed: UInt64 = 0) -> MonteCarloHarness {
+        var configuration = MonteCarloHarness.Configuration()
+        configuration.runs = runs
+        configuration.seed = seed
+        return MonteCarloHarness(configuration: configuration)
+    }
+
+    /// Evaluates on a background queue, as `evaluate` requires.
+    private func evaluate(_ harness: MonteCarloHarness, _ mission: [MonteCarloHarness.Step]) -> MonteCarloHarness.Report {
+        var report: MonteCarloHarness.Report?
+        let done = expectation(description: "evaluated")
+        DispatchQueue.global(qos: .userInitiated).async {
+            report = harness.evaluate(mission)
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 300.0)
+        return report!
+    }
+
+    private func assertEqual(_ a: MonteCarloHarness.Run, _ b: MonteCarloHarness.Run, file: StaticString = #file, line: UInt = #line) {
+        XCTAssertEqual(String(describing: a.failure), String(describing: b.failure), file: file, line: line)
+        XCTAssertEqual(a.convergenceTimes, b.convergenceTimes, file: file, line: line)
+        XCTAssertEqual(a.overshoots, b.overshoots, file: file, line: line)
+        XCTAssertEqual(a.yawOvershoots, b.yawOvershoots, file: file, line: line)
+        XCTAssertEqual(a.duration, b.duration, file: file, line: line)
+    }
+
+    /// Same seed, same runs, whatever the threads they run on. Run `i` draws with seed `seed + i`.
+    func testSameSeedSameRuns() {
+        let first = evaluate(makeHarness(runs: 4), mission)
+        let second = evaluate(makeHarness(runs: 4), mission)
+        let shifted = evaluate(makeHarness(runs: 3, seed: 1), mission)
+
+        XCTAssertEqual(first.runs.map { $0.index }, [0, 1, 2, 3])
+        XCTAssertEqual(first.failureRate, second.failureRate)
+
+        for (a, b) in zip(first.runs, second.runs) {
+            assertEqual(a, b)
+        }
+        for (a, b) in zip(first.runs.dropFirst(), shifted.runs) {
+            assertEqual(a, b)
+        }
+        // Different draws
+        XCTAssertNotEqual(first.runs[0].duration, first.runs[1].duration)
+    }
+
+    func testStepTimeoutFailsTheRun() {
+        var harness = makeHarness(runs: 2)
+        harness.configuration.stepTimeout = 5.0
+
+        // Out of reach in 5 s
+        let report = evaluate(harness, [.takeoff, .hold(1.0), .goTo(QuadrotorPose(x: 20.0, y: 0.0, z: 1.0, yaw: nil))])
+
+        for run in report.runs {
+            guard case .timeout(step: 2)? = run.failure else {
+                XCTFail("run \(run.index): \(String(describing: run.failure))")
+                continue
+            }
+            XCTAssertTrue(run.convergenceTimes.isEmpty)
+        }
+        XCTAssertEqual(report.failureRate, 1.0)
+        XCTAssertEqual(report.convergenceTime.count, 0)
+    }
+
+    func testDistributionPercentiles() {
+        var random = SeededRandom(seed: 3)
+        let distribution = MonteCarloHarness.Distribution((1...100).map { Double($0) }.shuffled(using: &random))
+
+        XCTAssertEqual(distribution.count, 100)
+        XCTAssertEqual(distribution.mean, 50.5, accuracy: 1e-12)
+        // Population standard deviation of 1...n
+        XCTAssertEqual(distribution.standardDeviation, (9999.0 / 12.0).squareRoot(), accuracy: 1e-12)
+        XCTAssertEqual(distribution.min, 1.0)
+        XCTAssertEqual(distribution.max, 100.0)
+        // Nearest rank below the middle, and nearest rank of the 95th percentile
+        XCTAssertEqual(distribution.median, 50.0)
+        XCTAssertEqual(distribution.percentile95, 95.0)
+
+        let single = MonteCarloHarness.Distribution([2.5])
+        XCTAssertEqual([single.mean, single.min, single.median, single.percentile95, single.max], [2.5, 2.5, 2.5, 2.5, 2.5])
+        XCTAssertEqual(single.standardDeviation, 0.0)
+    }
+
+    func testEmptyDistributionIsNaN() {
+        let distribution = MonteCarloHarness.Distribution([])
+
+        XCTAssertEqual(distribution.count, 0)
+        for value in [distribution.mean, distribution.standardDeviation, distribution.min,
+                      distribution.median, distribution.percentile95, distribution.max] {
+            XCTAssertTrue(value.isNaN)
+        }
+    }
+}
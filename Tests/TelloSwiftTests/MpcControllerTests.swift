@@ -0,0 +1,53 @@
+//
+//  MpcControllerTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class MpcControllerTests: XCTestCase {
+    /// One core runs the MPC of a fleet at the control rate, closing the loop on the model of the controller.
+    func testBenchmarkFleetAtControlRate() {
+        let drones = 24
+        let rate = 50.0
+        let seconds = 10.0
+        let dt = 1.0 / rate
+
+        let config = MpcController.Configuration()
+        let controllers = (0..<drones).map { _ in MpcController(configuration: config) }
+        var positions = (0..<drones).map { i in simd_double4(Double(i % 5), Double(i / 5), 0.0, 0.0) }
+        var velocities = [simd_double4](repeating: .zero, count: drones)
+        let setPoint = simd_double4(1.0, 1.0, 1.0, 0.5)
+
+        let ticks = Int(seconds * rate)
+        var iterations = 0
+
+        let time = measureTime {
+            for tick in 0..<ticks {
+                let t = Double(tick) * dt
+
+                for i in 0..<drones {
+                    let controls = controllers[i].update(setPoint: setPoint, measured: positions[i],
+                                                         measuredVelocity: velocities[i], at: t)
+                    iterations += controllers[i].iterations
+
+                    // First-order velocity response, as in the controller model
+                    velocities[i] += (config.inputGain * controls - config.damping * velocities[i]) * dt
+                    positions[i] += velocities[i] * dt
+                }
+            }
+        }
+
+        let solves = Double(ticks * drones)
+        let realTime = seconds / time
+        print("MpcController: \(drones) drones at \(rate) Hz, \(time * 1e6 / solves) us/solve, "
+              + "\(Double(iterations) / solves) iterations/solve, \(realTime)x real time on one core")
+
+        XCTAssertGreaterThan(realTime, 1.0)
+        // Converges to the set point
+        XCTAssertLessThan(simd_length(positions[0] - setPoint), 0.05)
+    }
+}
@@ -0,0 +1,71 @@
+//
+//  Pid4Tests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class Pid4Tests: XCTestCase {
+    private func makePids() -> [Pid] {
+        return [Pid(p: 0.9, i: 0.1, d: 0.3, deadband: 0.05, windowSize: 3)!,
+                Pid(p: 1.2, i: 0.0, d: 0.45, deadband: 0.15, windowSize: 5)!,
+                Pid(p: 2.0, i: 0.005, d: 0.01, deadband: 0.05, windowSize: 1)!,
+                Pid(p: 0.7, i: 0.2, d: 0.5, deadband: 0.02, windowSize: 4)!]
+    }
+
+    /// Each lane behaves exactly as a scalar `Pid` fed with the same errors.
+    func testMatchesFourScalarPids() {
+        let pids = makePids()
+        var pid4 = Pid4(x: Pid(from: pids[0]), y: Pid(from: pids[1]), z: Pid(from: pids[2]), yaw: Pid(from: pids[3]))
+        var random = SeededRandom(seed: 3)
+
+        var time = 5.0
+        for step in 0..<500 {
+            // Irregular periods, errors that decay into the deadbands
+            time += 0.01 + 0.02 * random.uniform()
+            let decay = exp(-Double(step) / 100.0)
+            let setPoint = simd_double4(1.0, -2.0, 0.5, 0.3)
+            let measured = setPoint - simd_double4(repeating: decay) * simd_double4(random.gaussian(), random.gaussian(),
+                                                                                  random.gaussian(), random.gaussian())
+
+            let lanes = pid4.update(setPoint: setPoint, measured: measured, at: time)
+
+            for lane in 0..<4 {
+                let scalar = pids[lane].update(setPoint: setPoint[lane], measuredValue: measured[lane], at: time)
+                XCTAssertEqual(lanes[lane], scalar, accuracy: 1e-9, "step \(step), lane \(lane)")
+                XCTAssertEqual(pid4.converged[lane], pids[lane].converged, "step \(step), lane \(lane)")
+            }
+        }
+
+        // The sequence converged
+        XCTAssertTrue(all(pid4.converged))
+    }
+
+    /// Two updates at the same time keep the integral and the derivative finite.
+    func testRepeatedTimeStaysFinite() {
+        let pids = makePids()
+        var pid4 = Pid4(x: pids[0], y: pids[1], z: pids[2], yaw: pids[3])
+        let setPoint = simd_double4(1.0, 1.0, 1.0, 1.0)
+
+        _ = pid4.update(setPoint: setPoint, measured: .zero, at: 1.0)
+        let once = pid4.update(setPoint: setPoint, measured: simd_double4(repeating: 0.1), at: 1.02)
+        let integral = pid4.integralError
+        let again = pid4.update(setPoint: setPoint, measured: simd_double4(repeating: 0.2), at: 1.02)
+
+        XCTAssertTrue(all(again .== again), "\(again)")
+        XCTAssertEqual(pid4.integralError, integral)
+        // Proportional to the new error, the integral is kept and the derivative dropped
+        for lane in 0..<4 {
+            XCTAssertEqual(again[lane], pids[lane].p * 0.8 + pids[lane].i * integral[lane], accuracy: 1e-12)
+        }
+        XCTAssertNotEqual(again, once)
+
+        // The next update differentiates against the last update that moved the time on
+        let next = pid4.update(setPoint: setPoint, measured: simd_double4(repeating: 0.3), at: 1.04)
+        XCTAssertLessThan(simd_length(pid4.lastDError - simd_double4(repeating: -0.2)), 1e-12)
+        XCTAssertTrue(all(next .== next))
+    }
+}
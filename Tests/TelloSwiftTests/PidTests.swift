@@ -0,0 +1,57 @@
+//
+//  PidTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+@testable import TelloSwift
+
+final class PidTests: XCTestCase {
+    func testConvergesWithinDeadbandOverWindow() {
+        let pid = Pid(p: 1.0, i: 0.0, d: 0.0, deadband: 0.01, windowSize: 3)!
+
+        // Convergence is judged on the full window of the previous errors
+        for i in 0..<3 {
+            _ = pid.update(setPoint: 0.0, measuredValue: 0.001, at: Double(i) * 0.1)
+            XCTAssertFalse(pid.converged)
+        }
+
+        _ = pid.update(setPoint: 0.0, measuredValue: 0.5, at: 0.3)
+        XCTAssertTrue(pid.converged)
+
+        _ = pid.update(setPoint: 0.0, measuredValue: 0.5, at: 0.4)
+        XCTAssertFalse(pid.converged)
+    }
+
+    /// The convergence window is tracked in O(1), so the cost of an update does not grow with `windowSize`.
+    func testBenchmarkUpdateCostIsIndependentOfWindowSize() {
+        let updates = 200_000
+
+        func perUpdate(windowSize: Int) -> Double {
+            let pid = Pid(p: 1.0, i: 0.1, d: 0.05, deadband: 0.001, windowSize: windowSize)!
+            var sum = 0.0
+
+            let time = measureTime {
+                for i in 0..<updates {
+                    sum += pid.update(setPoint: 1.0, measuredValue: sin(Double(i) * 0.01), at: Double(i) * 0.01)
+                }
+            }
+            XCTAssertFalse(sum.isNaN)
+            return time / Double(updates)
+        }
+
+        // Warm up
+        _ = perUpdate(windowSize: 5)
+
+        let sizes = [5, 50, 500, 5000]
+        let costs = sizes.map { perUpdate(windowSize: $0) }
+
+        for (size, cost) in zip(sizes, costs) {
+            print("Pid.update, window \(size): \(cost * 1e9) ns/update")
+        }
+
+        // Generous bound against timing noise, a linear scan would be ~1000 times slower
+        XCTAssertLessThan(costs.last!, costs.first! * 3.0)
+    }
+}
@@ -0,0 +1,134 @@
+//
+//  PositionControllerTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class PositionControllerTests: XCTestCase {
+    private func makeController() -> PositionController {
+        return PositionController(x: Pid(p: 0.5, i: 0.01, d: 0.1)!,
+                                  y: Pid(p: 0.5, i: 0.01, d: 0.1)!,
+                                  z: Pid(p: 0.8, i: 0.0, d: 0.0)!,
+                                  yaw: Pid(p: 1.0, i: 0.0, d: 0.0)!)
+    }
+
+    private func pose(at time: CFTimeInterval) -> (AnyPositionMeasurement, AnyOrientationMeasurement) {
+        let position = AnyPositionMeasurement(velocity: simd_double3(0.1, 0.0, 0.0),
+                                              position: simd_double3(0.1 * time, 0.0, 1.0),
+                                              isValid: .allValid)
+        return (position, AnyOrientationMeasurement(orientation: simd_quatd(angle: 0.1, axis: simd_double3(0.0, 0.0, 1.0))))
+    }
+
+    /// At 50 Hz the controller publishes its input and output at `publishInterval` only, but keeps the values current.
+    func testUpdatePublishesAtPublishInterval() {
+        let controller = makeController()
+        controller.setTarget(target: QuadrotorPose(x: 2.0, y: 0.0, z: 1.0, yaw: 0.0))
+
+        var published = 0
+        let observation = controller.output.observation { _ in published += 1 }
+        defer { observation.cancel() }
+
+        var last: QuadrotorControls?
+        for tick in 0..<500 {
+            let t = Double(tick) * 0.02
+            let (position, orientation) = pose(at: t)
+            last = controller.update(position: position, orientation: orientation, at: t)
+        }
+
+        // 10 s at no more than 10 Hz
+        XCTAssertGreaterThan(published, 50)
+        XCTAssertLessThanOrEqual(published, 101)
+        XCTAssertEqual(controller.output.value, last)
+        XCTAssertEqual(controller.input.value?.x ?? .nan, 0.1 * 499 * 0.02, accuracy: 1e-9)
+    }
+
+    /// A control tick must not allocate, at any rate.
+    ///
+    /// Publication is disabled: delivering to the main queue allocates, and is throttled by `publishInterval`.
+    func testUpdateDoesNotAllocate() throws {
+        try XCTSkipUnless(Allocations.isAvailable, "Allocations can not be counted on this platform")
+
+        let controller = makeController()
+        controller.publishInterval = .infinity
+        // Out of reach during the test, so the state does not change to converged
+        controller.setTarget(target: QuadrotorPose(x: 5.0, y: 0.0, z: 1.0, yaw: 0.0))
+
+        var t = 0.0
+        func tick() {
+            let (position, orientation) = pose(at: t)
+            controller.update(position: position, orientation: orientation, at: t)
+            t += 0.02
+        }
+
+        // Warm up: the first publication and the state change to running schedule their delivery
+        for _ in 0..<100 {
+            tick()
+        }
+
+        var time = 0.0
+        let allocations = Allocations.count {
+            time = measureTime {
+                for _ in 0..<1000 {
+                    tick()
+                }
+            }
+        }
+
+        print("PositionController.update: \(allocations) allocations in 1000 ticks, \(time * 1e6 / 1000.0) us/tick")
+        XCTAssertEqual(allocations, 0)
+    }
+
+    /// Largest distance behind a ramp reference along X, once settled, with the horizontal model of the simulator.
+    private func rampLag(feedForward: PositionController.FeedForward) -> Double {
+        let dynamics = QuadrotorSimulator.Dynamics()
+        let controller = PositionController(x: Pid(p: 0.5, i: 0.0, d: 0.0)!,
+                                            y: Pid(p: 0.5, i: 0.0, d: 0.0)!,
+                                            z: Pid(p: 0.8, i: 0.0, d: 0.0)!,
+                                            yaw: Pid(p: 1.0, i: 0.0, d: 0.0)!)
+        controller.publishInterval = .infinity
+        controller.feedForward = feedForward
+
+        let speed = 0.5
+        let dt = 0.005
+        let tiltAlpha = 1.0 - exp(-dt / dynamics.tiltTimeConstant)
+        let orientation = AnyOrientationMeasurement(orientation: simd_quatd(angle: 0.0, axis: simd_double3(0.0, 0.0, 1.0)))
+        var x = 0.0, v = 0.0, tilt = 0.0
+        var lag = 0.0
+
+        for tick in 0...1000 {
+            let t = Double(tick) * 0.02
+            controller.setReference(TrackingReference(time: t, position: simd_double4(speed * t, 0.0, 1.0, 0.0),
+                                                      velocity: simd_double4(speed, 0.0, 0.0, 0.0)))
+            let position = AnyPositionMeasurement(velocity: simd_double3(v, 0.0, 0.0), position: simd_double3(x, 0.0, 1.0),
+                                                  isValid: .allValid)
+            let pitch = controller.update(position: position, orientation: orientation, at: t)?.pitch ?? 0.0
+
+            if t >= 15.0 {
+                lag = max(lag, abs(speed * t - x))
+            }
+
+            // Tilt lag and linear drag, as stepped by the simulator
+            for _ in 0..<4 {
+                tilt += (pitch.clamped(to: -1.0...1.0) * dynamics.maxTilt - tilt) * tiltAlpha
+                v += (9.80665 * tan(tilt) - dynamics.drag * v) * dt
+                x += v * dt
+            }
+        }
+
+        return lag
+    }
+
+    /// Without feed-forward a P controller trails a ramp by speed / (stick gain * P), here about 0.6 m.
+    /// The default feed-forward supplies the stick that holds the reference velocity, leaving the PID almost nothing.
+    func testFeedForwardReducesRampLag() {
+        let withoutFeedForward = rampLag(feedForward: .zero)
+        let withFeedForward = rampLag(feedForward: PositionController.FeedForward())
+
+        XCTAssertEqual(withoutFeedForward, 0.5 / (QuadrotorSimulator.Dynamics().stickGain.x * 0.5), accuracy: 0.05)
+        XCTAssertLessThan(withFeedForward, 0.1 * withoutFeedForward, "\(withFeedForward) m vs \(withoutFeedForward) m")
+    }
+}
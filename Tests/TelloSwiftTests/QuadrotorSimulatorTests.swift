@@ -0,0 +1,74 @@
+//
+//  QuadrotorSimulatorTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class QuadrotorSimulatorTests: XCTestCase {
+    /// Takes off, flies to a target with the predicted control loop and returns the ground truth
+    /// and the controller state at the end.
+    private func fly(seed: UInt64, to target: simd_double3 = simd_double3(1.0, 0.5, 1.0), duration: Double = 10.0) -> (QuadrotorSimulator.State, PositionController.State?) {
+        var config = QuadrotorSimulator.Configuration()
+        config.seed = seed
+        let simulator = QuadrotorSimulator(configuration: config)
+        let tello = Tello(transport: simulator)
+
+        tello.connect()
+        _ = tello.takeoff()
+        XCTAssertTrue(simulator.run(until: { tello.flightState.value == .hovering }, timeout: 10.0))
+
+        tello.goTo(x: target.x, y: target.y, z: target.z, yaw: 0.0)
+        simulator.run(for: duration)
+
+        let state = simulator.state
+        let controllerState = tello.controller.state.value
+        tello.disconnect()
+        return (state, controllerState)
+    }
+
+    func testSameSeedSameFlight() {
+        let (a, _) = fly(seed: 7)
+        let (b, _) = fly(seed: 7)
+
+        XCTAssertEqual(a.time, b.time)
+        XCTAssertEqual(a.position, b.position)
+        XCTAssertEqual(a.velocity, b.velocity)
+        XCTAssertEqual(a.yaw, b.yaw)
+    }
+
+    func testDifferentSeedDifferentNoise() {
+        let (a, _) = fly(seed: 7)
+        let (b, _) = fly(seed: 8)
+
+        XCTAssertNotEqual(a.position, b.position)
+    }
+
+    /// Closed loop through the whole stack: sensors, estimator, predictor, controller and sticks.
+    func testClosedLoopReachesTarget() {
+        let target = simd_double3(1.0, 0.5, 1.0)
+        let (state, controllerState) = fly(seed: 1, to: target, duration: 15.0)
+
+        XCTAssertEqual(state.flightState, .hovering)
+        XCTAssertLessThan(simd_length(state.position - target), 0.15)
+        XCTAssertLessThan(abs(remainder(state.yaw, 2.0 * .pi)), 0.1)
+        XCTAssertEqual(controllerState, .running(.converged))
+    }
+
+    func testLandsAfterLandCommand() {
+        let simulator = QuadrotorSimulator()
+        let tello = Tello(transport: simulator)
+        defer { tello.disconnect() }
+
+        tello.connect()
+        _ = tello.takeoff()
+        XCTAssertTrue(simulator.run(until: { tello.flightState.value == .hovering }, timeout: 10.0))
+
+        tello.land()
+        XCTAssertTrue(simulator.run(until: { tello.flightState.value == .landed }, timeout: 10.0))
+        XCTAssertEqual(simulator.state.position.z, 0.0, accuracy: 0.01)
+    }
+}
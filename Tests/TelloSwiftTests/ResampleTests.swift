@@ -0,0 +1,102 @@
+//
+//  ResampleTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import Combine
+import simd
+@testable import TelloSwift
+
+final class ResampleTests: XCTestCase {
+    // 8 Hz keeps the tick times exact in binary
+    private let rate = 8.0
+    private let clock = ManualClock()
+    private let ticker = ResampleTicker()
+
+    /// Holds the latest sample at the sampling time, even when a later one arrived.
+    func testZeroOrderHoldStampsOnTheClock() {
+        let subject = PassthroughSubject<Double, Never>()
+        var received: [Double] = []
+        let sub = subject.resample(rate: rate, delay: 0.125, clock: clock.time)
+            .ticking(with: ticker)
+            .sink { received.append($0) }
+        defer { sub.cancel() }
+
+        // Nothing to sample yet
+        clock.now = 0.125
+        ticker.fire()
+        XCTAssertEqual(received, [])
+
+        clock.now = 0.2
+        subject.send(1.0)
+        clock.now = 0.3
+        subject.send(2.0)
+
+        // Sampled at 0.25
+        clock.now = 0.375
+        ticker.fire()
+        XCTAssertEqual(received, [1.0])
+    }
+
+    /// The elements carry their own time stamps: x is the time, y the value.
+    func testLinearSkipsMissedTicksAndDoesNotExtrapolate() {
+        let subject = PassthroughSubject<simd_double2, Never>()
+        var received: [simd_double2] = []
+        let sub = subject.resample(rate: rate, mode: .linear, delay: 0.125, clock: clock.time, time: { $0.x })
+            .ticking(with: ticker)
+            .sink { received.append($0) }
+        defer { sub.cancel() }
+
+        // Delivered in one burst, long after they were produced
+        clock.now = 0.25
+        [0.0, 0.2, 0.4, 0.6].forEach { subject.send(simd_double2($0, 2.0 * $0)) }
+
+        // Tick 2, sampled at 0.125
+        ticker.fire()
+        // The timer missed ticks 3 and 4, tick 5 is sampled at 0.5
+        clock.now = 0.625
+        ticker.fire()
+        // Tick 6 is due at 0.75, sampled at 0.625, after the latest sample
+        ticker.fire()
+
+        XCTAssertEqual(received.count, 3)
+        XCTAssertEqual(received[0].x, 0.125, accuracy: 1e-12)
+        XCTAssertEqual(received[0].y, 0.25, accuracy: 1e-12)
+        XCTAssertEqual(received[1].x, 0.5, accuracy: 1e-12)
+        XCTAssertEqual(received[1].y, 1.0, accuracy: 1e-12)
+        XCTAssertEqual(received[2], simd_double2(0.6, 1.2))
+    }
+
+    /// Interpolates along the shortest arc, although the second sample has the opposite sign.
+    func testSlerpTakesTheShortestArc() throws {
+        let subject = PassthroughSubject<simd_quatd, Never>()
+        var received: [simd_quatd] = []
+        let sub = subject.resample(rate: rate, mode: .slerp, delay: 0.125, clock: clock.time)
+            .ticking(with: ticker)
+            .sink { received.append($0) }
+        defer { sub.cancel() }
+
+        subject.send(simd_quatd(angle: 0.0, axis: simd_double3(0.0, 0.0, 1.0)))
+        clock.now = 0.25
+        subject.send(-simd_quatd(angle: .pi / 2.0, axis: simd_double3(0.0, 0.0, 1.0)))
+
+        // Sampled at 0.125, half way
+        ticker.fire()
+
+        let x = try XCTUnwrap(received.first).act(simd_double3(1.0, 0.0, 0.0))
+        XCTAssertEqual(x.x, cos(.pi / 4.0), accuracy: 1e-9)
+        XCTAssertEqual(x.y, sin(.pi / 4.0), accuracy: 1e-9)
+        XCTAssertEqual(x.z, 0.0, accuracy: 1e-9)
+    }
+}
+
+/// Clock that only moves when told to.
+final class ManualClock {
+    var now: CFTimeInterval = 0.0
+
+    var time: () -> CFTimeInterval {
+        return { [unowned self] in self.now }
+    }
+}
@@ -0,0 +1,109 @@
+//
+//  RingBufferTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import Combine
+@testable import TelloSwift
+
+final class RingBufferTests: XCTestCase {
+    func testWindowSlidesOverElements() {
+        let subject = PassthroughSubject<Int, Never>()
+        var windows: [[Int]] = []
+        let sub = subject.ringBuffer(size: 3).sink { windows.append(Array($0)) }
+
+        (0..<5).forEach { subject.send($0) }
+        sub.cancel()
+
+        XCTAssertEqual(windows, [[0], [0, 1], [0, 1, 2], [1, 2, 3], [2, 3, 4]])
+    }
+
+    func testRetainedWindowKeepsItsContents() {
+        let subject = PassthroughSubject<Int, Never>()
+        var retained: [Publishers.RingBuffer<PassthroughSubject<Int, Never>>.Window] = []
+        let sub = subject.ringBuffer(size: 2).sink { retained.append($0) }
+
+        (0..<4).forEach { subject.send($0) }
+        sub.cancel()
+
+        XCTAssertEqual(retained.map { Array($0) }, [[0], [0, 1], [1, 2], [2, 3]])
+    }
+
+    func testBufferedWindowIsDetachedFromTheRing() {
+        let subject = PassthroughSubject<Int, Never>()
+        let subscriber = DemandSubscriber<Publishers.RingBuffer<PassthroughSubject<Int, Never>>.Window>()
+        subject.ringBuffer(size: 2, buffering: .latest).subscribe(subscriber)
+
+        // No demand: the windows wait in the buffer while the ring slides on
+        (0..<3).forEach { subject.send($0) }
+        subscriber.request(1)
+        (3..<5).forEach { subject.send($0) }
+        subscriber.request(1)
+
+        XCTAssertEqual(subscriber.received.map { Array($0) }, [[1, 2], [3, 4]])
+    }
+
+    /// Size 100 at 100 Hz: one second of samples through a full window, as views and as array copies.
+    func testBenchmarkWindowAllocations() throws {
+        try XCTSkipUnless(Allocations.isAvailable, "Allocations can not be counted on this platform")
+
+        let size = 100
+        let samples = 100
+
+        func run(copying: Bool) -> (allocations: Int, time: Double) {
+            let subject = PassthroughSubject<Double, Never>()
+            var sum = 0.0
+            let sub = subject.ringBuffer(size: size).sink { window in
+                sum += copying ? Array(window).last! : window.last!
+            }
+            defer { sub.cancel() }
+
+            // Fill the window first, so only the steady state is measured
+            (0..<size).forEach { subject.send(Double($0)) }
+
+            var time = 0.0
+            let allocations = Allocations.count {
+                time = measureTime {
+                    (0..<samples).forEach { subject.send(Double($0)) }
+                }
+            }
+            XCTAssertGreaterThan(sum, 0.0)
+            return (allocations, time)
+        }
+
+        let views = run(copying: false)
+        let copies = run(copying: true)
+
+        print("RingBuffer size \(size), \(samples) samples: views \(views.allocations) allocations, \(views.time * 1e6 / Double(samples)) us/sample; "
+              + "copies \(copies.allocations) allocations, \(copies.time * 1e6 / Double(samples)) us/sample")
+
+        // Every copy allocates its array, the views share the ring storage
+        XCTAssertGreaterThanOrEqual(copies.allocations, samples)
+        XCTAssertLessThan(views.allocations, samples)
+    }
+}
+
+/// Subscriber that requests elements only when asked to.
+final class DemandSubscriber<Input>: Subscriber {
+    typealias Failure = Never
+
+    private(set) var received: [Input] = []
+    private var subscription: Subscription?
+
+    func receive(subscription: Subscription) {
+        self.subscription = subscription
+    }
+
+    func receive(_ input: Input) -> Subscribers.Demand {
+        received.append(input)
+        return .none
+    }
+
+    func receive(completion: Subscribers.Completion<Never>) {}
+
+    func request(_ demand: Int) {
+        subscription?.request(.max(demand))
+    }
+}
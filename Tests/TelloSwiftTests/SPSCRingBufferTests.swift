@@ -0,0 +1,136 @@
+//
+//  SPSCRingBufferTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+@testable import TelloSwift
+
+final class SPSCRingBufferTests: XCTestCase {
+    func testCapacityIsRoundedUpToPowerOfTwo() {
+        XCTAssertEqual(SPSCRingBuffer<Int>(minimumCapacity: 1).capacity, 1)
+        XCTAssertEqual(SPSCRingBuffer<Int>(minimumCapacity: 5).capacity, 8)
+        XCTAssertEqual(SPSCRingBuffer<Int>(minimumCapacity: 8).capacity, 8)
+    }
+
+    func testFullAndEmpty() {
+        let ring = SPSCRingBuffer<Int>(minimumCapacity: 4)
+        XCTAssertTrue(ring.isEmpty)
+        XCTAssertNil(ring.pop())
+
+        for i in 0..<4 {
+            XCTAssertTrue(ring.push(i))
+        }
+        XCTAssertEqual(ring.count, 4)
+        XCTAssertFalse(ring.push(4))
+        XCTAssertEqual(ring.write(contentsOf: [5, 6]), 0)
+
+        XCTAssertEqual((0..<4).map { _ in ring.pop() }, [0, 1, 2, 3])
+        XCTAssertTrue(ring.isEmpty)
+        XCTAssertNil(ring.pop())
+    }
+
+    func testWrapsAround() {
+        let ring = SPSCRingBuffer<Int>(minimumCapacity: 4)
+        var popped: [Int] = []
+
+        // Three laps of the storage, one element behind the producer
+        for i in 0..<12 {
+            XCTAssertTrue(ring.push(i))
+            if i > 0 {
+                popped.append(ring.pop()!)
+            }
+        }
+        popped.append(ring.pop()!)
+
+        XCTAssertEqual(popped, Array(0..<12))
+        XCTAssertTrue(ring.isEmpty)
+    }
+
+    func testBulkWriteAndReadAcrossTheSeam() {
+        let ring = SPSCRingBuffer<Int>(minimumCapacity: 8)
+        let buffer = UnsafeMutableBufferPointer<Int>.allocate(capacity: 8)
+        defer { buffer.deallocate() }
+
+        // Move the indices close to the end of the storage
+        XCTAssertEqual(ring.write(contentsOf: 0..<6), 6)
+        XCTAssertEqual(ring.read(into: UnsafeMutableBufferPointer(rebasing: buffer[0..<6])), 6)
+
+        // Only 8 fit, the write wraps after 2 elements
+        XCTAssertEqual(ring.write(contentsOf: Array(10..<20)), 8)
+        XCTAssertEqual(ring.count, 8)
+
+        // The read wraps as well, and takes no more than there is
+        XCTAssertEqual(ring.read(into: UnsafeMutableBufferPointer(rebasing: buffer[0..<5])), 5)
+        XCTAssertEqual(Array(buffer[0..<5]), [10, 11, 12, 13, 14])
+        XCTAssertEqual(ring.read(into: buffer), 3)
+        XCTAssertEqual(Array(buffer[0..<3]), [15, 16, 17])
+        XCTAssertTrue(ring.isEmpty)
+    }
+
+    /// The producer and the consumer run on two threads: every element arrives once and in order.
+    func testStressProducerConsumer() {
+        let elements = 1_000_000
+        let ring = SPSCRingBuffer<Int>(minimumCapacity: 64)
+        var result = (received: 0, outOfOrder: 0)
+
+        DispatchQueue.concurrentPerform(iterations: 2) { thread in
+            if thread == 0 {
+                var next = 0
+                while next < elements {
+                    // Alternate single and bulk writes of odd length, so they keep crossing the seam
+                    if next % 2 == 0 {
+                        if ring.push(next) {
+                            next += 1
+                        }
+                    } else {
+                        next += ring.write(contentsOf: next..<Swift.min(next + 7, elements))
+                    }
+                }
+            } else {
+                let buffer = UnsafeMutableBufferPointer<Int>.allocate(capacity: 5)
+                defer { buffer.deallocate() }
+
+                var expected = 0
+                var outOfOrder = 0
+                while expected < elements {
+                    if expected % 2 == 0 {
+                        if let value = ring.pop() {
+                            outOfOrder += value == expected ? 0 : 1
+                            expected += 1
+                        }
+                    } else {
+                        let n = ring.read(into: buffer)
+                        for value in buffer[0..<n] {
+                            outOfOrder += value == expected ? 0 : 1
+                            expected += 1
+                        }
+                    }
+                }
+                result = (expected, outOfOrder)
+            }
+        }
+
+        XCTAssertEqual(result.received, elements)
+        XCTAssertEqual(result.outOfOrder, 0)
+        XCTAssertTrue(ring.isEmpty)
+    }
+
+    func testPowerOfTwoRingSlicesAcrossTheSeam() {
+        let ring = PowerOfTwoRingBuffer<Int>(minimumCapacity: 4)
+        (0..<6).forEach { ring.append($0) }
+
+        XCTAssertTrue(ring.isFull)
+        XCTAssertEqual(ring[0], 2)
+        ring.withContiguousSlices { first, second in
+            XCTAssertEqual(Array(first), [2, 3])
+            XCTAssertEqual(Array(second), [4, 5])
+        }
+
+        XCTAssertEqual(ring.read(), 2)
+        XCTAssertEqual(ring.write(contentsOf: [6, 7]), 1)
+        XCTAssertEqual((0..<4).map { _ in ring.read() }, [3, 4, 5, 6])
+        XCTAssertNil(ring.read())
+    }
+}
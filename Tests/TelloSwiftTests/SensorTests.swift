@@ -0,0 +1,195 @@
+//
+//  SensorTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import Combine
+import simd
+@testable import TelloSwift
+
+final class SensorTests: XCTestCase {
+    func testObserversReceiveEveryValueOnTheProducerThread() {
+        let sensor = Sensor<Int>()
+        var received: [Int] = []
+        let token = sensor.observe { received.append($0) }
+
+        (0..<3).forEach { sensor.value = $0 }
+        sensor.removeObserver(token)
+        sensor.value = 3
+
+        XCTAssertEqual(received, [0, 1, 2])
+    }
+
+    /// Producers write vectors with equal lanes while readers read `value`: a snapshot is never mixed from two writes.
+    func testStressValueSnapshot() {
+        let writes = 100_000
+        let sensor = Sensor<simd_double4>(with: .zero, bufferingPolicy: .latest)
+        var torn = [Int](repeating: 0, count: 2)
+
+        torn.withUnsafeMutableBufferPointer { torn in
+            DispatchQueue.concurrentPerform(iterations: 4) { thread in
+                if thread < 2 {
+                    for i in 0..<writes {
+                        sensor.value = simd_double4(repeating: Double(i * 2 + thread))
+                    }
+                } else {
+                    var count = 0
+                    for _ in 0..<writes {
+                        let v = sensor.value!
+                        if v != simd_double4(repeating: v.x) {
+                            count += 1
+                        }
+                    }
+                    torn[thread - 2] = count
+                }
+            }
+        }
+
+        XCTAssertEqual(torn, [0, 0])
+    }
+
+    /// Same for values that are not trivially copyable, which are guarded by a lock.
+    func testStressLockedValue() {
+        let writes = 20_000
+        let sensor = Sensor<String>(with: "/", bufferingPolicy: .latest)
+        var torn = [Int](repeating: 0, count: 2)
+
+        torn.withUnsafeMutableBufferPointer { torn in
+            DispatchQueue.concurrentPerform(iterations: 4) { thread in
+                if thread < 2 {
+                    for i in 0..<writes {
+                        let word = String(i * 2 + thread)
+                        sensor.value = word + "/" + word
+                    }
+                } else {
+                    var count = 0
+                    for _ in 0..<writes {
+                        let parts = sensor.value!.split(separator: "/", omittingEmptySubsequences: false)
+                        if parts.count != 2 || parts[0] != parts[1] {
+                            count += 1
+                        }
+                    }
+                    torn[thread - 2] = count
+                }
+            }
+        }
+
+        XCTAssertEqual(torn, [0, 0])
+    }
+
+    /// Observers are added and removed while a producer notifies them.
+    ///
+    /// A permanent observer gets every value in order, the value is never older than what the observers received.
+    func testStressObserversWhileProducing() {
+        let writes = 50_000
+        let sensor = Sensor<Int>(with: -1, bufferingPolicy: .latest)
+
+        var received: [Int] = []
+        received.reserveCapacity(writes)
+        var stale = 0
+        let token = sensor.observe { val in
+            received.append(val)
+            if sensor.value! < val {
+                stale += 1
+            }
+        }
+
+        var transient = [Int](repeating: 0, count: 2)
+        transient.withUnsafeMutableBufferPointer { transient in
+            DispatchQueue.concurrentPerform(iterations: 3) { thread in
+                if thread == 0 {
+                    for i in 0..<writes {
+                        sensor.value = i
+                    }
+                } else {
+                    // Incremented on the producer thread
+                    let lock = NSLock()
+                    var calls = 0
+                    for _ in 0..<writes / 10 {
+                        let token = sensor.observe { _ in
+                            lock.lock()
+                            calls += 1
+                            lock.unlock()
+                        }
+                        sensor.removeObserver(token)
+
+                        let cancellable = sensor.observation { _ in
+                            lock.lock()
+                            calls += 1
+                            lock.unlock()
+                        }
+                        cancellable.cancel()
+                    }
+                    lock.lock()
+                    transient[thread - 1] = calls
+                    lock.unlock()
+                }
+            }
+        }
+        sensor.removeObserver(token)
+
+        XCTAssertEqual(received, Array(0..<writes))
+        XCTAssertEqual(stale, 0)
+        XCTAssertTrue(transient.allSatisfy { $0 <= writes })
+    }
+
+    /// Cost of one sample from the producer thread to the consumer, through an observer and through Combine.
+    ///
+    /// The producer waits for every sample to arrive, so the Combine path pays the main queue hop per sample,
+    /// as it does at the rate of the state packets.
+    func testBenchmarkObserverVersusCombine() throws {
+        try XCTSkipUnless(Allocations.isAvailable, "Allocations can not be counted on this platform")
+
+        let samples = 1000
+
+        func run(name: String, subscribe: (Sensor<Double>, DispatchSemaphore) -> AnyCancellable) -> (allocations: Int, time: Double) {
+            let sensor = Sensor<Double>()
+            let delivered = DispatchSemaphore(value: 0)
+            let sub = subscribe(sensor, delivered)
+            defer { sub.cancel() }
+
+            var result = (allocations: 0, time: 0.0)
+            let done = expectation(description: name)
+
+            DispatchQueue.global(qos: .userInitiated).async {
+                // Warm up
+                for i in 0..<10 {
+                    sensor.value = Double(i)
+                    delivered.wait()
+                }
+
+                result.allocations = Allocations.count {
+                    result.time = measureTime {
+                        for i in 0..<samples {
+                            sensor.value = Double(i)
+                            delivered.wait()
+                        }
+                    }
+                }
+                done.fulfill()
+            }
+
+            // Spins the main run loop, which delivers the Combine values
+            wait(for: [done], timeout: 30.0)
+            return result
+        }
+
+        let observer = run(name: "observer") { sensor, delivered in
+            sensor.observation { _ in delivered.signal() }
+        }
+        let combine = run(name: "combine") { sensor, delivered in
+            sensor.sink { _ in delivered.signal() }
+        }
+
+        print("Sensor, \(samples) samples: observer \(Double(observer.allocations) / Double(samples)) allocations, "
+              + "\(observer.time * 1e6 / Double(samples)) us/sample; "
+              + "combine \(Double(combine.allocations) / Double(samples)) allocations, "
+              + "\(combine.time * 1e6 / Double(samples)) us/sample")
+
+        // Both paths still queue the value for Combine, but only the Combine consumer waits for each hop
+        XCTAssertLessThan(observer.allocations, combine.allocations)
+        XCTAssertLessThan(observer.time, combine.time)
+    }
+}
@@ -0,0 +1,75 @@
+//
+//  SeqLockTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+@testable import TelloSwift
+
+final class SeqLockTests: XCTestCase {
+    /// Same layout as the stick command `Tello` hands to the keep-alive timer.
+    private struct StickCommand {
+        var controls: QuadrotorControls
+        var fastMode: Bool
+    }
+
+    private static func sticks(_ value: Double) -> QuadrotorControls {
+        return QuadrotorControls(roll: value, pitch: value, yaw: value, thrust: value)
+    }
+
+    func testStoreAndLoad() {
+        let lock = SeqLock(StickCommand(controls: Self.sticks(0.0), fastMode: false))
+        lock.store(StickCommand(controls: Self.sticks(0.5), fastMode: true))
+
+        let cmd = lock.load()
+        XCTAssertEqual(cmd.controls, Self.sticks(0.5))
+        XCTAssertTrue(cmd.fastMode)
+    }
+
+    /// The controller and the user write the sticks and the fast mode flag, while the keep-alive timer reads them.
+    ///
+    /// Readers must never see the sticks of two different commands, and the writers must not lose each other's updates.
+    func testStressStickHandOff() {
+        let writes = 100_000
+        let reads = 400_000
+        let readers = 2
+
+        let lock = SeqLock(StickCommand(controls: Self.sticks(0.0), fastMode: false))
+        var torn = [Int](repeating: 0, count: readers)
+
+        torn.withUnsafeMutableBufferPointer { torn in
+            DispatchQueue.concurrentPerform(iterations: 2 + readers) { thread in
+                switch thread {
+                case 0:
+                    // Controller, like the `ctrl` setter
+                    for i in 1...writes {
+                        lock.update { $0.controls = Self.sticks(Double(i)) }
+                    }
+                case 1:
+                    // User, like the `fastMode` setter
+                    for _ in 0..<writes {
+                        lock.update { $0.fastMode.toggle() }
+                    }
+                default:
+                    // Keep-alive timer
+                    var count = 0
+                    for _ in 0..<reads {
+                        let controls = lock.load().controls
+                        if controls != Self.sticks(controls.roll!) {
+                            count += 1
+                        }
+                    }
+                    torn[thread - 2] = count
+                }
+            }
+        }
+
+        XCTAssertEqual(torn, [Int](repeating: 0, count: readers))
+
+        let last = lock.load()
+        XCTAssertEqual(last.controls, Self.sticks(Double(writes)))
+        // An even number of toggles
+        XCTAssertFalse(last.fastMode)
+    }
+}
@@ -0,0 +1,75 @@
+//
+//  StateEstimatorTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class StateEstimatorTests: XCTestCase {
+    private let imu = Imu(accel: .zero, gyro: .zero, orientation: simd_quatd(ix: 0.0, iy: 0.0, iz: 0.0, r: 1.0), temperature: 40.0)
+    private let mvo = Mvo(velocity: .zero,
+                          velocityCov: simd_double3x3(diagonal: simd_double3(repeating: 100.0)),
+                          position: simd_double3(1.0, 2.0, 0.0),
+                          positionCov: simd_double3x3(diagonal: simd_double3(repeating: 0.001)),
+                          height: 0.0, heightVariance: 0.0,
+                          isValid: .allValid)
+
+    func testPositionIsValidOnlyWhileCorrected() {
+        let estimator = StateEstimator()
+
+        estimator.update(mvo: mvo, at: 0.0)
+        estimator.update(proximity: 1.0, at: 0.01)
+        XCTAssertEqual(estimator.estimate(at: 0.02)?.isValid.pos, .allValid)
+
+        // IMU only: the estimate is propagated, but not corrected
+        var t = 0.02
+        while t < 2.0 {
+            estimator.update(imu: imu, at: t)
+            t += 0.01
+        }
+        let pos = estimator.estimate(at: t)!.isValid.pos
+        XCTAssertFalse(pos.x || pos.y || pos.z)
+
+        estimator.update(mvo: mvo, at: t)
+        let corrected = estimator.estimate(at: t)!.isValid.pos
+        // Z is corrected by proximity only
+        XCTAssertTrue(corrected.x && corrected.y)
+        XCTAssertFalse(corrected.z)
+    }
+
+    func testAltitudeIsInvalidUntilProximity() {
+        let estimator = StateEstimator()
+
+        estimator.update(mvo: mvo, at: 0.0)
+        XCTAssertFalse(estimator.estimate(at: 0.0)!.isValid.pos.z)
+    }
+
+    /// Filter updates per second, at the mix of the drone: IMU at 100 Hz, MVO and proximity at 10 Hz.
+    func testBenchmarkUpdatesPerSecond() {
+        let estimator = StateEstimator()
+        estimator.update(mvo: mvo, at: 0.0)
+        estimator.update(proximity: 1.0, at: 0.0)
+
+        let seconds = 100
+        var t = 0.0
+        var updates = 0
+
+        let time = measureTime {
+            for _ in 0..<seconds * 10 {
+                for _ in 0..<10 {
+                    t += 0.01
+                    estimator.update(imu: imu, at: t)
+                }
+                estimator.update(mvo: mvo, at: t)
+                estimator.update(proximity: 1.0, at: t)
+                updates += 12
+            }
+        }
+
+        print("StateEstimator: \(Double(updates) / time) updates/s, \(time * 1e6 / Double(updates)) us/update")
+        XCTAssertEqual(estimator.rejectedCount, 0)
+    }
+}
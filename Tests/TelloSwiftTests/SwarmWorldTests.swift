@@ -0,0 +1,124 @@
+//
+//  SwarmWorldTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class SwarmWorldTests: XCTestCase {
+    private func grid(_ count: Int, spacing: Double) -> [simd_double2] {
+        let side = Int(Double(count).squareRoot().rounded(.up))
+        return (0..<count).map { simd_double2(Double($0 % side) * spacing, Double($0 / side) * spacing) }
+    }
+
+    /// 100 drones, all flying with their whole stack, must run at least 10 times faster than real time.
+    func testBenchmarkHundredDrones() {
+        let world = SwarmWorld(positions: grid(100, spacing: 1.0))
+        world.agents.forEach {
+            $0.tello.connect()
+            _ = $0.tello.takeoff()
+        }
+        defer {
+            world.agents.forEach { $0.tello.disconnect() }
+        }
+
+        // Takeoff, then hover under the controllers
+        world.run(for: 5.0)
+        for (i, agent) in world.agents.enumerated() {
+            let start = agent.simulator.configuration.initialPosition
+            agent.tello.goTo(x: start.x + 0.5, y: start.y, z: 1.0 + 0.2 * Double(i % 3), yaw: 0.0)
+        }
+
+        let duration = 10.0
+        let time = measureTime {
+            world.run(for: duration)
+        }
+
+        let realTime = duration / time
+        print("SwarmWorld: \(world.agents.count) drones, \(realTime)x real time, "
+              + "\(time * 1e6 / (duration / world.configuration.tickInterval)) us/tick, "
+              + "channel utilization \(world.channelUtilization)")
+
+        XCTAssertGreaterThanOrEqual(realTime, 10.0)
+        XCTAssertTrue(world.agents.allSatisfy { $0.simulator.state.flightState != .landed })
+    }
+
+    /// Hovering on the simulators alone, without controllers: a drone under another sinks, one beside it does not.
+    func testPropWashPushesDownOnlyUnderTheWake() {
+        // No gusts, the drones stay where they took off
+        var configuration = SwarmWorld.Configuration()
+        configuration.agent.dynamics.gustAcceleration = 0.0
+        // Under, above, and beside the one above, well outside the wake radius
+        let world = SwarmWorld(positions: [simd_double2(0.0, 0.0), simd_double2(0.0, 0.0), simd_double2(0.8, 0.0)],
+                               configuration: configuration)
+        let (under, above, beside) = (world.agents[0].simulator, world.agents[1].simulator, world.agents[2].simulator)
+
+        world.agents.forEach { $0.simulator.takeoff() }
+        XCTAssertTrue(world.run(until: { world.agents.allSatisfy { $0.simulator.state.flightState == .hovering } }, timeout: 10.0))
+        // Same altitude, no wash yet
+        XCTAssertEqual(under.state.position.z, beside.state.position.z, accuracy: 1e-9)
+
+        above.command(QuadrotorControls(roll: 0.0, pitch: 0.0, yaw: 0.0, thrust: 1.0))
+        world.run(for: 0.5)
+        above.command(QuadrotorControls(roll: 0.0, pitch: 0.0, yaw: 0.0, thrust: 0.0))
+        world.run(for: 0.5)
+        XCTAssertGreaterThan(above.state.position.z - under.state.position.z, 0.3)
+
+        let start = (under: under.state.position.z, beside: beside.state.position.z)
+        world.run(for: 3.0)
+
+        XCTAssertLessThan(under.state.position.z - start.under, -0.1)
+        XCTAssertEqual(beside.state.position.z, start.beside, accuracy: 0.01)
+    }
+
+    /// Number of sensor packets the agents deliver over `duration`, and the channel utilization at the end.
+    private func deliveredPackets(airtime: Double, duration: Double = 5.0) -> (packets: Int, utilization: Double) {
+        var configuration = SwarmWorld.Configuration()
+        configuration.wifi.airtime = airtime
+        // As long as the 10 Hz sampling period, so every tick offers about the same load
+        configuration.tickInterval = 0.1
+        let world = SwarmWorld(positions: grid(4, spacing: 1.0), configuration: configuration)
+
+        // Agents are stepped concurrently
+        let lock = NSLock()
+        var packets = 0
+        for agent in world.agents {
+            agent.simulator.start { event in
+                if case .keepAlive = event { return }
+                lock.lock()
+                packets += 1
+                lock.unlock()
+            }
+        }
+        defer {
+            world.agents.forEach { $0.simulator.stop() }
+        }
+
+        lock.lock()
+        packets = 0
+        lock.unlock()
+
+        world.run(for: duration)
+
+        lock.lock()
+        defer { lock.unlock() }
+        return (packets, world.channelUtilization)
+    }
+
+    /// Four landed drones send about 45 packets/s each: 10 ms of airtime per packet offer the channel 1.6 to 2 times its capacity.
+    func testSaturatedChannelDropsPackets() {
+        let idle = deliveredPackets(airtime: SwarmWorld.WiFi().airtime)
+        let saturated = deliveredPackets(airtime: 0.01)
+
+        XCTAssertLessThan(idle.utilization, 0.05)
+        XCTAssertGreaterThan(saturated.utilization, 1.0)
+        // Without losses every sample arrives, about 45 per second per drone
+        XCTAssertGreaterThan(idle.packets, 4 * 40 * 4)
+        // Saturated, about 1 - 1 / utilization of them are dropped
+        XCTAssertLessThan(Double(saturated.packets), 0.75 * Double(idle.packets),
+                          "\(saturated.packets) of \(idle.packets) packets at utilization \(saturated.utilization)")
+    }
+}
@@ -0,0 +1,126 @@
+//
+//  SystemIdentificationTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class SystemIdentificationTests: XCTestCase {
+    private let sampleTime = 0.05
+    // Per lane: x, y, z, and yaw
+    private let gain = simd_double4(1.7, 1.5, 1.0, 1.75)
+    private let delay = simd_double4(0.15, 0.2, 0.1, 0.05)
+    private let timeConstant = simd_double4(0.7, 0.6, 0.15, 0.1)
+
+    /// A flight of the exact discrete FOPDT model on the resampling grid, excited with random steps.
+    ///
+    /// The heading stays at zero, so the body frame is the world frame.
+    private func flight(seed: UInt64, duration: Double = 60.0) -> FlightRecording {
+        var random = SeededRandom(seed: seed)
+        let a = simd_double4((0..<4).map { exp(-sampleTime / timeConstant[$0]) })
+        let b = gain * (1.0 - a)
+        let lags = (0..<4).map { Int((delay[$0] / sampleTime).rounded()) }
+
+        var recording = FlightRecording()
+        var controls: [simd_double4] = []
+        var control = simd_double4.zero
+        var hold = simd_double4.zero
+        var velocity = simd_double4.zero
+
+        for k in 0..<Int(duration / sampleTime) {
+            let time = Double(k) * sampleTime
+
+            for lane in 0..<4 where hold[lane] <= 0.0 {
+                control[lane] = random.uniform() - 0.5
+                hold[lane] = 0.5 + random.uniform()
+            }
+            hold -= sampleTime
+            controls.append(control)
+
+            recording.sticks.append(.init(time: time, value: QuadrotorControls(roll: -control.y, pitch: control.x,
+                                                                                 yaw: -control.w, thrust: control.z)))
+            recording.imu.append(.init(time: time, value: Imu(accel: .zero, gyro: simd_double3(0.0, 0.0, velocity.w),
+                                                               orientation: simd_quatd(angle: 0.0, axis: simd_double3(0.0, 0.0, 1.0)),
+                                                               temperature: 40.0)))
+            recording.mvo.append(.init(time: time, value: Mvo(velocity: simd_double3(velocity.x, velocity.y, velocity.z),
+                                                               velocityCov: simd_double3x3(diagonal: simd_double3(repeating: 0.01)),
+                                                               position: .zero, positionCov: simd_double3x3(diagonal: simd_double3(repeating: 0.01)),
+                                                               height: 0.0, heightVariance: 0.01, isValid: .allValid)))
+
+            var delayed = simd_double4.zero
+            for lane in 0..<4 where k >= lags[lane] {
+                delayed[lane] = controls[k - lags[lane]][lane]
+            }
+            velocity = a * velocity + b * delayed
+        }
+
+        return recording
+    }
+
+    func testIdentifiesFopdtModelsAcrossFlights() throws {
+        var configuration = SystemIdentification.Configuration()
+        configuration.sampleTime = sampleTime
+        let identification = SystemIdentification(configuration: configuration)
+
+        let result = identification.identify([flight(seed: 1), flight(seed: 2), flight(seed: 3)])
+
+        let models = [result.x, result.y, result.z, result.yaw]
+        for lane in 0..<4 {
+            let model = try XCTUnwrap(models[lane], "lane \(lane)")
+            XCTAssertEqual(model.gain, gain[lane], accuracy: 1e-6 * gain[lane], "lane \(lane)")
+            XCTAssertEqual(model.delay, delay[lane], accuracy: 1e-9, "lane \(lane)")
+            XCTAssertEqual(model.timeConstant, timeConstant[lane], accuracy: 1e-6 * timeConstant[lane], "lane \(lane)")
+            XCTAssertGreaterThan(model.fit, 0.999, "lane \(lane)")
+            // All three flights, less the delays and the last sample of each
+            XCTAssertGreaterThan(model.samples, 3 * 1150, "lane \(lane)")
+        }
+    }
+
+    func testTooShortFlightsHaveNoModel() {
+        let result = SystemIdentification().identify([flight(seed: 1, duration: 3.0)])
+
+        XCTAssertNil(result.x)
+        XCTAssertNil(result.yaw)
+    }
+
+    /// SIMC gives a series PID, `kc * (1 + 1 / (ti * s)) * (1 + td * s)`, which `Pid` runs in parallel form.
+    func testSuggestedPidsConvertSimcToParallelForm() throws {
+        var configuration = SystemIdentification.Configuration()
+        configuration.integralAction = true
+        let identification = SystemIdentification(configuration: configuration)
+
+        let model = SystemIdentification.AxisModel(gain: 2.0, delay: 0.2, timeConstant: 0.5, fit: 0.9, samples: 1000)
+        let reversed = SystemIdentification.AxisModel(gain: -1.0, delay: 0.2, timeConstant: 0.5, fit: 0.9, samples: 1000)
+        let result = SystemIdentification.Result(x: model, y: nil, z: reversed, yaw: nil)
+        let current = Pid(p: 0.1, i: 0.0, d: 0.0, deadband: 0.05, windowSize: 7)!
+
+        let suggested = identification.suggestedPids(for: result, current: (current, current, current, current))
+
+        XCTAssertEqual(Set(suggested.keys), ["x"])
+        let pid = try XCTUnwrap(Pid.from(try XCTUnwrap(suggested["x"])))
+
+        // tc = max(delay, 0.3) = 0.3, kc = 1 / (gain * (tc + delay)) = 1, ti = 4 * (tc + delay) = 2, td = 0.5
+        let kc = 1.0, ti = 2.0, td = 0.5
+        XCTAssertEqual(pid.p, kc * (1.0 + td / ti), accuracy: 1e-12)
+        XCTAssertEqual(pid.i, kc / ti, accuracy: 1e-12)
+        XCTAssertEqual(pid.d, kc * td, accuracy: 1e-12)
+        XCTAssertEqual(pid.deadband, 0.05)
+        XCTAssertEqual(pid.windowSize, 7)
+
+        // Both forms have the same frequency response
+        for omega in [0.1, 1.0, 10.0] {
+            let series = (re: kc, im: -kc / (ti * omega))
+            let lead = (re: 1.0, im: td * omega)
+            let product = (re: series.re * lead.re - series.im * lead.im, im: series.re * lead.im + series.im * lead.re)
+            XCTAssertEqual(product.re, pid.p, accuracy: 1e-12, "at \(omega) rad/s")
+            XCTAssertEqual(product.im, pid.d * omega - pid.i / omega, accuracy: 1e-12, "at \(omega) rad/s")
+        }
+
+        configuration.integralAction = false
+        let proportional = SystemIdentification(configuration: configuration).suggestedPids(for: result)
+        XCTAssertEqual(proportional["x"]?["i"] as? Double, 0.0)
+    }
+}
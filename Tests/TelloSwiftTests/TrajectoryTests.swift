@@ -0,0 +1,108 @@
+//
+//  TrajectoryTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class TrajectoryTests: XCTestCase {
+    private let waypoints = [QuadrotorPose(x: 0.0, y: 0.0, z: 1.0, yaw: 0.0),
+                             QuadrotorPose(x: 1.0, y: 0.0, z: 1.0, yaw: nil),
+                             QuadrotorPose(x: 1.0, y: 2.0, z: 1.5, yaw: .pi / 2.0),
+                             QuadrotorPose(x: 0.0, y: 2.0, z: nil, yaw: .pi)]
+
+    private func times(_ trajectory: Trajectory) -> [CFTimeInterval] {
+        return trajectory.durations.reduce(into: [0.0]) { $0.append($0.last! + $1) }
+    }
+
+    func testPassesThroughWaypointsAtSegmentTimes() throws {
+        var trajectory = try XCTUnwrap(Trajectory(waypoints: waypoints))
+
+        let expected = [simd_double4(0.0, 0.0, 1.0, 0.0),
+                        simd_double4(1.0, 0.0, 1.0, 0.0),
+                        simd_double4(1.0, 2.0, 1.5, .pi / 2.0),
+                        simd_double4(0.0, 2.0, 1.5, .pi)]
+        XCTAssertEqual(trajectory.waypoints, expected)
+        XCTAssertEqual(trajectory.duration, trajectory.durations.reduce(0.0, +), accuracy: 1e-12)
+
+        for (time, point) in zip(times(trajectory), expected) {
+            let sample = trajectory.sample(at: time)
+            XCTAssertLessThan(simd_length(sample.position - point), 1e-6, "at \(time): \(sample.position)")
+        }
+    }
+
+    func testStartsAndEndsAtRest() throws {
+        var trajectory = try XCTUnwrap(Trajectory(waypoints: waypoints))
+
+        for time in [0.0, trajectory.duration] {
+            let sample = trajectory.sample(at: time)
+            XCTAssertLessThan(simd_length(sample.velocity), 1e-6, "at \(time)")
+            XCTAssertLessThan(simd_length(sample.acceleration), 1e-6, "at \(time)")
+        }
+
+        XCTAssertFalse(trajectory.sample(at: trajectory.duration - 0.01).isFinished)
+        XCTAssertTrue(trajectory.sample(at: trajectory.duration).isFinished)
+        // Clamped past the end
+        XCTAssertEqual(trajectory.sample(at: trajectory.duration + 1.0).position, trajectory.sample(at: trajectory.duration).position)
+    }
+
+    func testRespectsLimits() throws {
+        var limits = Trajectory.Limits()
+        limits.velocity = 0.4
+        limits.acceleration = 0.3
+        limits.yawRate = 0.5
+        limits.yawAcceleration = 0.4
+
+        var trajectory = try XCTUnwrap(Trajectory(waypoints: waypoints, limits: limits))
+
+        // Much denser than the samples used to scale the durations
+        var peaks = simd_double4.zero
+        for k in 0...20_000 {
+            let sample = trajectory.sample(at: trajectory.duration * Double(k) / 20_000.0)
+            let v = sample.velocity
+            let a = sample.acceleration
+            peaks = simd_max(peaks, simd_double4(simd_length(simd_double3(v.x, v.y, v.z)), abs(v.w),
+                                                 simd_length(simd_double3(a.x, a.y, a.z)), abs(a.w)))
+        }
+
+        let bounds = simd_double4(limits.velocity, limits.yawRate, limits.acceleration, limits.yawAcceleration)
+        XCTAssertTrue(all(peaks .<= bounds * 1.02), "peaks \(peaks), limits \(bounds)")
+    }
+
+    /// Yaw turns the short way across ±π and stays continuous along the trajectory.
+    func testYawWindsAcrossPi() throws {
+        let turn = [QuadrotorPose(x: 0.0, y: 0.0, z: 1.0, yaw: 3.0),
+                    QuadrotorPose(x: nil, y: nil, z: nil, yaw: -3.0),
+                    QuadrotorPose(x: nil, y: nil, z: nil, yaw: 2.9)]
+        var trajectory = try XCTUnwrap(Trajectory(waypoints: turn))
+
+        let wrapped = 2.0 * .pi - 6.0
+        for (yaw, expected) in zip(trajectory.waypoints.map({ $0.w }), [3.0, 3.0 + wrapped, 2.9]) {
+            XCTAssertEqual(yaw, expected, accuracy: 1e-12)
+        }
+        XCTAssertEqual(trajectory.waypoints.count, 3)
+
+        var previous = trajectory.sample(at: 0.0).position.w
+        for k in 1...1000 {
+            let yaw = trajectory.sample(at: trajectory.duration * Double(k) / 1000.0).position.w
+            XCTAssertLessThan(abs(yaw - previous), 0.01, "step \(k)")
+            previous = yaw
+        }
+        XCTAssertEqual(previous, 2.9, accuracy: 1e-6)
+
+        // Short turns only, the whole trajectory stays within a small arc
+        let yaws = (0...100).map { trajectory.sample(at: trajectory.duration * Double($0) / 100.0).position.w }
+        XCTAssertGreaterThan(yaws.min()!, 2.8)
+        XCTAssertLessThan(yaws.max()!, 3.0 + wrapped + 0.1)
+    }
+
+    func testRejectsIncompleteStartAndSinglePoint() {
+        XCTAssertNil(Trajectory(waypoints: [QuadrotorPose(x: 0.0, y: 0.0, z: nil, yaw: 0.0),
+                                            QuadrotorPose(x: 1.0, y: 0.0, z: 1.0, yaw: 0.0)]))
+        XCTAssertNil(Trajectory(waypoints: [QuadrotorPose(x: 0.0, y: 0.0, z: 1.0, yaw: 0.0),
+                                            QuadrotorPose(x: 0.0, y: 0.0, z: 1.0, yaw: 2.0 * .pi)]))
+    }
+}
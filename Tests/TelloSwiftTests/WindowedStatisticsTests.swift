@@ -0,0 +1,71 @@
+//
+//  WindowedStatisticsTests.swift
+//  TelloSwift
+//
+//
+
+import XCTest
+import simd
+@testable import TelloSwift
+
+final class WindowedStatisticsTests: XCTestCase {
+    /// Compares every step of a sequence much longer than the window with the brute-force statistics of the window.
+    private func compareWithBruteForce<T: WindowedStatisticsElement>(_ type: T.Type, size: Int = 50, samples: Int = 5000,
+                                                                       accuracy: T.Scalar, sample: (inout SeededRandom) -> T) {
+        var random = SeededRandom(seed: 42)
+        var stats = WindowedStatistics<T>(size: size)
+        var values: [T] = []
+
+        for step in 0..<samples {
+            let value = sample(&random)
+            stats.add(value)
+            values.append(value)
+
+            let window = values.suffix(size)
+            XCTAssertEqual(stats.count, window.count)
+
+            for lane in 0..<T.laneCount {
+                let lanes = window.map { $0[lane: lane] }
+                let n = T.Scalar(lanes.count)
+                let mean = lanes.reduce(0, +) / n
+                let variance = lanes.count > 1 ? lanes.map { ($0 - mean) * ($0 - mean) }.reduce(0, +) / (n - 1) : 0
+
+                XCTAssertEqual(stats.mean[lane: lane], mean, accuracy: accuracy, "mean, step \(step), lane \(lane)")
+                XCTAssertEqual(stats.variance[lane: lane], variance, accuracy: accuracy, "variance, step \(step), lane \(lane)")
+                XCTAssertEqual(stats.min?[lane: lane], lanes.min(), "min, step \(step), lane \(lane)")
+                XCTAssertEqual(stats.max?[lane: lane], lanes.max(), "max, step \(step), lane \(lane)")
+            }
+        }
+    }
+
+    func testDoubleMatchesBruteForce() {
+        // Far from zero, as positions are, to stress the running sums
+        compareWithBruteForce(Double.self, accuracy: 1e-9) { random in
+            random.gaussian(mean: 100.0, standardDeviation: 2.0)
+        }
+    }
+
+    func testSimdMatchesBruteForce() {
+        compareWithBruteForce(simd_double3.self, accuracy: 1e-9) { random in
+            // Repeated values exercise the ties in the deques
+            simd_double3(random.gaussian(mean: 100.0, standardDeviation: 2.0),
+                         (random.uniform() * 4.0).rounded(),
+                         -random.uniform())
+        }
+    }
+
+    func testResetClearsTheWindow() {
+        var stats = WindowedStatistics<Double>(size: 3)
+        [5.0, 1.0, 9.0, 2.0].forEach { stats.add($0) }
+        stats.reset()
+
+        XCTAssertTrue(stats.isEmpty)
+        XCTAssertNil(stats.min)
+
+        [3.0, 4.0].forEach { stats.add($0) }
+        XCTAssertEqual(stats.mean, 3.5)
+        XCTAssertEqual(stats.variance, 0.5)
+        XCTAssertEqual(stats.min, 3.0)
+        XCTAssertEqual(stats.max, 4.0)
+    }
+}